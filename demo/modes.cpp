@@ -0,0 +1,880 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CauchyFEC.h"
+#include "CauchyFECPacker.h"
+#include "CauchyFECInterleaver.h"
+#include "FixedCauchyCodec.h"
+#include "FFTFEC.h"
+#include "FountainFEC.h"
+#include "SlidingWindowFEC.h"
+#include "XorFEC2D.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+#include <stdexcept>
+
+
+/*
+ * Randomized encode / lose / decode round trips for every mode and engine, with a case at
+ * the largest geometry each one accepts. Every test returns false on the first mismatch.
+ */
+
+void makeRandomVector(std::vector<uint8_t>& output, unsigned int length) {
+    output.resize(length);
+    for(unsigned int i=0; i<length; i++) {
+        output[i]=rand();
+    }
+}
+
+void makeRandomPackets(std::vector<std::vector<uint8_t>>& output, unsigned int count, unsigned int maxLength) {
+    output.resize(count);
+    for(auto& packet: output) {
+        makeRandomVector(packet, rand()%maxLength + 1);
+    }
+}
+
+/* Removes 'count' random packets */
+void losePackets(std::vector<std::vector<uint8_t>>& packets, unsigned int count) {
+    for(unsigned int i=0; i<count && packets.size(); i++) {
+        packets.erase(packets.begin() + rand()%packets.size());
+    }
+}
+
+void shufflePackets(std::vector<std::vector<uint8_t>>& packets) {
+    for(unsigned int i=packets.size(); i>1; i--) {
+        std::swap(packets[i - 1], packets[rand()%i]);
+    }
+}
+
+/* Encodes k source packets (k <= loaded when flushed), loses m of k + m and decodes */
+bool cauchyRoundTrip(CauchyFEC& encoder, CauchyFEC& decoder, const std::vector<std::vector<uint8_t>>& source,
+                     unsigned int blockSize, unsigned int parityPackets, bool useStep) {
+    encoder.reset(true, blockSize);
+    encoder << source;
+    if(source.size() < blockSize) {
+        encoder.flush();
+    }
+
+    std::vector<std::vector<uint8_t>> packets;
+    if(useStep) {
+        encoder.schedulePackets(parityPackets);
+        while(!encoder.step(rand()%65536 + 1));
+    }
+    if(encoder.requestPackets(packets, source.size() + parityPackets) != source.size() + parityPackets) {
+        return false;
+    }
+
+    losePackets(packets, parityPackets);
+    shufflePackets(packets);
+
+    decoder.reset(false);
+    decoder << packets;
+    if(useStep) {
+        while(!decoder.step(rand()%65536 + 1));
+    }
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, source.size());
+
+    return output == source;
+}
+
+bool testCauchy() {
+    unsigned int blockSize = rand()%255 + 1;
+    unsigned int parityPackets = rand()%(256 - blockSize) + 1;
+    bool flush = !(rand()%4);
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, flush? rand()%blockSize + 1 : blockSize, rand()%2? 1500 : 20000);
+
+    CauchyFEC encoder, decoder;
+    return cauchyRoundTrip(encoder, decoder, source, blockSize, parityPackets, rand()%2);
+}
+
+bool testCauchyBoundary() {
+    CauchyFEC encoder, decoder;
+    std::vector<std::vector<uint8_t>> source;
+
+    /* k + m = 256, both ways round */
+    makeRandomPackets(source, 255, 100);
+    if(!cauchyRoundTrip(encoder, decoder, source, 255, 1, false)) {
+        return false;
+    }
+
+    makeRandomPackets(source, 1, 100);
+    if(!cauchyRoundTrip(encoder, decoder, source, 1, 255, false)) {
+        return false;
+    }
+
+    /* The largest packet with 16 bit lengths */
+    source.assign(3, std::vector<uint8_t>());
+    makeRandomVector(source[0], 0xFFFF);
+    makeRandomVector(source[1], 1);
+    makeRandomVector(source[2], 0xFFFF);
+    return cauchyRoundTrip(encoder, decoder, source, 3, 3, true);
+}
+
+bool testCauchyStepResume() {
+    /* An unlimited request after step() resumes inside a packet */
+    unsigned int blockSize = rand()%16 + 2;
+    std::vector<std::vector<uint8_t>> source(blockSize);
+    for(auto& packet: source) {
+        makeRandomVector(packet, 1000);
+    }
+
+    CauchyFEC encoder, decoder;
+    encoder.reset(true, blockSize);
+    encoder << source;
+    encoder.schedulePackets(1);
+    encoder.step(600);
+
+    std::vector<std::vector<uint8_t>> packets;
+    if(encoder.requestPackets(packets, blockSize + 1) != blockSize + 1) {
+        return false;
+    }
+    packets.erase(packets.begin() + rand()%blockSize);
+
+    decoder.reset(false);
+    decoder << packets;
+    decoder.step(600);
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, blockSize);
+    return output == source;
+}
+
+bool testCauchyWide() {
+    unsigned int blockSize = rand()%1000 + 1;
+    unsigned int parityPackets = rand()%64 + 1;
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, blockSize, 200);
+
+    CauchyFEC encoder, decoder;
+    encoder.setField(CauchyFEC::FIELD_GF65536);
+    decoder.setField(CauchyFEC::FIELD_GF65536);
+    return cauchyRoundTrip(encoder, decoder, source, blockSize, parityPackets, rand()%2);
+}
+
+bool testCauchyWideBoundary() {
+    /* k + m = 65536 */
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, 65532, 4);
+
+    CauchyFEC encoder, decoder;
+    encoder.setField(CauchyFEC::FIELD_GF65536);
+    decoder.setField(CauchyFEC::FIELD_GF65536);
+    return cauchyRoundTrip(encoder, decoder, source, 65532, 4, false);
+}
+
+bool testCauchyLargeSymbols() {
+    unsigned int blockSize = rand()%8 + 1;
+    unsigned int parityPackets = rand()%4 + 1;
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, blockSize, 300000);
+    /* Just past the 16 bit length limit */
+    makeRandomVector(source[rand()%blockSize], 0x10000);
+
+    CauchyFEC encoder, decoder;
+    encoder.setLargeSymbols(true);
+    decoder.setLargeSymbols(true);
+    return cauchyRoundTrip(encoder, decoder, source, blockSize, parityPackets, rand()%2);
+}
+
+bool testCauchyLocalGroups() {
+    unsigned int groupSize = rand()%8 + 1;
+    unsigned int blockSize = rand()%64 + 1;
+    unsigned int groups = (blockSize + groupSize - 1) / groupSize;
+    unsigned int globalParity = rand()%4 + 1;
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, blockSize, 1500);
+
+    CauchyFEC encoder, decoder;
+    encoder.setLocalGroups(groupSize);
+    decoder.setLocalGroups(groupSize);
+    encoder.reset(true, blockSize);
+    encoder << source;
+
+    std::vector<std::vector<uint8_t>> packets;
+    encoder.requestPackets(packets, blockSize + groups + globalParity);
+
+    /* One loss per group is repaired locally, any globalParity + 1 losses with the global parity */
+    std::vector<std::vector<uint8_t>> received;
+    std::vector<unsigned int> lost;
+    if(rand()%2) {
+        for(unsigned int group = 0; group < groups; group++) {
+            lost.push_back(group * groupSize + rand()%std::min(groupSize, blockSize - group * groupSize));
+        }
+    } else {
+        for(unsigned int i = 0; i <= globalParity; i++) {
+            lost.push_back(rand()%packets.size());
+        }
+    }
+    for(unsigned int i = 0; i < packets.size(); i++) {
+        if(std::find(lost.begin(), lost.end(), i) == lost.end()) {
+            received.push_back(packets[i]);
+        }
+    }
+
+    decoder.reset(false);
+    decoder << received;
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, blockSize);
+    return output == source;
+}
+
+bool testCauchyLocalRepairStep() {
+    /* Local repair and copying the parity are budgeted like the other decoder stages */
+    unsigned int blockSize = rand()%32 + 2;
+    std::vector<std::vector<uint8_t>> source(blockSize);
+    for(auto& packet: source) {
+        makeRandomVector(packet, 4000);
+    }
+
+    CauchyFEC encoder, decoder;
+    encoder.setLocalGroups(blockSize);
+    decoder.setLocalGroups(blockSize);
+    decoder.enableStats(true);
+    encoder.reset(true, blockSize);
+    encoder << source;
+
+    std::vector<std::vector<uint8_t>> packets;
+    encoder.requestPackets(packets, blockSize + 1);
+    packets.erase(packets.begin() + rand()%blockSize);
+
+    decoder.reset(false);
+    decoder << packets;
+
+    /* A group of 4000 byte packets is not repaired by the first small step */
+    CauchyFEC::Stats stats;
+    decoder.step(64);
+    decoder.getStats(stats);
+    if(stats.parityConsumed) {
+        return false;
+    }
+
+    while(!decoder.step(rand()%4096 + 1));
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, blockSize);
+    return output == source;
+}
+
+bool testCauchyNormalized() {
+    unsigned int blockSize = rand()%200 + 1;
+    unsigned int parityPackets = rand()%(256 - blockSize) + 1;
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, blockSize, 1500);
+
+    CauchyFEC encoder, decoder;
+    encoder.setExtendedTrailer(true);
+    encoder.setGenerator(CauchyFEC::GENERATOR_NORMALIZED_CAUCHY);
+    decoder.setExtendedTrailer(true);
+    if(rand()%2) {
+        encoder.setField(CauchyFEC::FIELD_GF65536);
+        decoder.setField(CauchyFEC::FIELD_GF65536);
+    }
+    return cauchyRoundTrip(encoder, decoder, source, blockSize, parityPackets, rand()%2);
+}
+
+bool testCauchyUpdateParity() {
+    unsigned int blockSize = rand()%32 + 1;
+    unsigned int parityPackets = rand()%8 + 1;
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, blockSize, 1500);
+
+    CauchyFEC encoder;
+    encoder.reset(true, blockSize);
+    encoder << source;
+
+    std::vector<std::vector<uint8_t>> packets;
+    encoder.requestPackets(packets, blockSize + parityPackets);
+    std::vector<std::vector<uint8_t>> parity(packets.begin() + blockSize, packets.end());
+
+    /* The new packet may be shorter, but must fit in the parity */
+    size_t longest = 0;
+    for(auto& packet: source) {
+        longest = std::max(longest, packet.size());
+    }
+
+    unsigned int index = rand()%blockSize;
+    std::vector<uint8_t> newPacket;
+    makeRandomVector(newPacket, rand()%longest + 1);
+    encoder.updateParity(parity, index, source[index], newPacket);
+    source[index] = newPacket;
+
+    /* The updated parity must recover the new packet */
+    std::vector<std::vector<uint8_t>> received;
+    for(unsigned int i = 0; i < blockSize; i++) {
+        if(i != index) {
+            received.push_back(packets[i]);
+        }
+    }
+    losePackets(received, parityPackets - 1);
+    received.insert(received.end(), parity.begin(), parity.end());
+
+    CauchyFEC decoder;
+    decoder.reset(false);
+    decoder << received;
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, blockSize);
+    return output == source;
+}
+
+bool testCauchyDecodeRange() {
+    unsigned int blockSize = rand()%32 + 1;
+    unsigned int parityPackets = rand()%8 + 1;
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, blockSize, 5000);
+
+    CauchyFEC fec;
+    fec.reset(true, blockSize);
+    fec << source;
+
+    std::vector<std::vector<uint8_t>> packets;
+    fec.requestPackets(packets, blockSize + parityPackets);
+
+    /* Lose source packet 'index' and a few others, parity makes up for them */
+    unsigned int index = rand()%blockSize;
+    std::vector<std::vector<uint8_t>> received;
+    unsigned int lost = 1;
+    for(unsigned int i = 0; i < packets.size(); i++) {
+        if(i == index || (i < blockSize && lost < parityPackets && !(rand()%4) && ++lost)) {
+            continue;
+        }
+        received.push_back(packets[i]);
+    }
+
+    fec.reset(false);
+    fec << received;
+
+    size_t length;
+    if(!fec.packetLength(index, length) || length != source[index].size()) {
+        return false;
+    }
+
+    size_t offset = rand()%length;
+    size_t rangeLength = rand()%(length - offset) + 1;
+    std::vector<uint8_t> output;
+    if(!fec.decodeRange(index, offset, rangeLength, output)) {
+        return false;
+    }
+
+    return std::equal(output.begin(), output.end(), source[index].begin() + offset) && output.size() == rangeLength;
+}
+
+bool testCauchyVerify() {
+    unsigned int blockSize = rand()%64 + 1;
+    unsigned int parityPackets = rand()%8 + 1;
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, blockSize, 1500);
+
+    CauchyFEC fec;
+    fec.reset(true, blockSize);
+    fec << source;
+
+    std::vector<std::vector<uint8_t>> packets;
+    fec.requestPackets(packets, blockSize + parityPackets);
+
+    std::vector<unsigned int> inconsistentParity;
+    int corruptSource;
+    if(!fec.verify(packets, inconsistentParity, corruptSource) || inconsistentParity.size()) {
+        return false;
+    }
+
+    /* Flip a byte of a source packet, every parity packet covers it */
+    unsigned int index = rand()%blockSize;
+    packets[index][rand()%source[index].size()] ^= rand()%255 + 1;
+    if(fec.verify(packets, inconsistentParity, corruptSource) || inconsistentParity.size() != parityPackets) {
+        return false;
+    }
+
+    return corruptSource == -1 || corruptSource == (int)index;
+}
+
+bool testCauchyRawBlock() {
+    unsigned int blockSize = rand()%64 + 1;
+    unsigned int parityPackets = rand()%16 + 1;
+
+    std::vector<std::vector<uint8_t>> source;
+    makeRandomPackets(source, blockSize, 70000);
+
+    CauchyFEC fec;
+    fec.setLargeSymbols(true);
+    fec.reset(true, blockSize);
+
+    std::vector<const uint8_t*> sources;
+    std::vector<size_t> lengths;
+    size_t longest = 0;
+    for(auto& packet: source) {
+        sources.push_back(packet.data());
+        lengths.push_back(packet.size());
+        longest = std::max(longest, packet.size());
+    }
+
+    size_t parityLength = fec.parityLength(longest);
+    std::vector<std::vector<uint8_t>> parity(parityPackets, std::vector<uint8_t>(parityLength));
+    std::vector<std::vector<uint8_t>> recovered(blockSize, std::vector<uint8_t>(parityLength));
+    std::vector<uint8_t*> parityPointers, recoveredPointers;
+    std::vector<unsigned int> rows;
+    for(unsigned int i = 0; i < parityPackets; i++) {
+        parityPointers.push_back(parity[i].data());
+        rows.push_back(blockSize + i);
+    }
+    for(auto& packet: recovered) {
+        recoveredPointers.push_back(packet.data());
+    }
+
+    fec.encodeBlock(blockSize, sources.data(), lengths.data(), parityPackets, rows.data(), parityPointers.data(), parityLength);
+
+    for(unsigned int i = 0; i < std::min(parityPackets, blockSize); i++) {
+        sources[rand()%blockSize] = nullptr;
+    }
+
+    std::vector<const uint8_t*> constParity(parityPointers.begin(), parityPointers.end());
+    std::vector<size_t> decodedLengths = lengths;
+    if(!fec.decodeBlock(blockSize, sources.data(), decodedLengths.data(), parityPackets, rows.data(),
+                        constParity.data(), parityLength, recoveredPointers.data())) {
+        return false;
+    }
+
+    for(unsigned int i = 0; i < blockSize; i++) {
+        if(!sources[i] && (decodedLengths[i] != source[i].size() ||
+                           !std::equal(source[i].begin(), source[i].end(), recovered[i].begin()))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool testPacker() {
+    unsigned int symbols = rand()%32 + 1;
+    unsigned int symbolSize = rand()%1500 + 4;
+    unsigned int parityPackets = rand()%8 + 1;
+
+    CauchyFECPacker encoder, decoder;
+    encoder.reset(true, symbols, symbolSize);
+
+    /* Datagrams until the block is full, some span symbol boundaries */
+    std::vector<std::vector<uint8_t>> datagrams;
+    while(true) {
+        std::vector<uint8_t> datagram;
+        makeRandomVector(datagram, rand()%std::min(2 * symbolSize, symbols * symbolSize - 2) + 1);
+        if(!(encoder << datagram)) {
+            break;
+        }
+        datagrams.push_back(datagram);
+    }
+    encoder.flush();
+
+    std::vector<std::vector<uint8_t>> packets;
+    encoder.requestPackets(packets, symbols + parityPackets);
+    losePackets(packets, parityPackets);
+    shufflePackets(packets);
+
+    decoder.reset(false);
+    for(auto& packet: packets) {
+        decoder << packet;
+    }
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, datagrams.size() + 1);
+    return output == datagrams;
+}
+
+bool testPackerCorruptLength() {
+    /* A valid datagram, followed by a length of 2^63 that does not fit in the block */
+    std::vector<std::vector<uint8_t>> symbols = {{3, 'a', 'b', 'c'}, {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01}};
+
+    CauchyFEC fec;
+    fec.reset(true, symbols.size());
+    fec << symbols;
+
+    std::vector<std::vector<uint8_t>> packets;
+    fec.requestPackets(packets, symbols.size());
+
+    CauchyFECPacker decoder;
+    decoder.reset(false);
+    for(auto& packet: packets) {
+        decoder << packet;
+    }
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, 2);
+    return output.size() == 1 && output[0] == std::vector<uint8_t>({'a', 'b', 'c'});
+}
+
+template <unsigned int K, unsigned int M> bool fixedRoundTrip() {
+    std::vector<std::vector<uint8_t>> source, parity, packets;
+    makeRandomPackets(source, K, 3000);
+
+    FixedCauchyCodec<K, M>::encode(source, parity);
+    for(unsigned int i = 0; i < K; i++) {
+        std::vector<uint8_t> packet;
+        FixedCauchyCodec<K, M>::sourcePacket(source[i], i, packet);
+        packets.push_back(packet);
+    }
+    packets.insert(packets.end(), parity.begin(), parity.end());
+
+    /* The runtime decoder reads the fixed encoder output */
+    losePackets(packets, M);
+    CauchyFEC decoder;
+    decoder.reset(false);
+    decoder << packets;
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, K);
+    return output == source;
+}
+
+bool testFixed() {
+    return fixedRoundTrip<1, 1>() && fixedRoundTrip<4, 2>() && fixedRoundTrip<10, 4>() && fixedRoundTrip<20, 10>();
+}
+
+bool testFixedBoundary() {
+    std::vector<std::vector<uint8_t>> source(2, std::vector<uint8_t>(0xFFFF)), parity;
+    FixedCauchyCodec<2, 1>::encode(source, parity);
+
+    /* Too long, empty, or not exactly K packets */
+    std::vector<std::vector<std::vector<uint8_t>>> invalid(3, source);
+    invalid[0][1].push_back(0);
+    invalid[1][1].clear();
+    invalid[2].push_back(source[0]);
+    for(auto& sources: invalid) {
+        try {
+            FixedCauchyCodec<2, 1>::encode(sources, parity);
+            return false;
+        } catch(std::runtime_error&) {
+        }
+    }
+
+    return fixedRoundTrip<250, 6>() && fixedRoundTrip<1, 255>();
+}
+
+bool fftRoundTrip(CauchyFEC::Field field, unsigned int blockSize, unsigned int parityPackets, unsigned int loaded, unsigned int maxLength) {
+    std::vector<std::vector<uint8_t>> source, packets;
+    makeRandomPackets(source, loaded, maxLength);
+
+    FFTFEC encoder, decoder;
+    encoder.setField(field);
+    decoder.setField(field);
+    encoder.reset(true, blockSize, parityPackets);
+    encoder << source;
+    if(loaded < blockSize) {
+        encoder.flush();
+    }
+
+    encoder.requestPackets(packets, loaded + parityPackets);
+    losePackets(packets, parityPackets);
+    shufflePackets(packets);
+
+    decoder.reset(false);
+    decoder << packets;
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, loaded);
+    return output == source;
+}
+
+bool testFFT() {
+    unsigned int parityPackets = rand()%64 + 1;
+    unsigned int rounded = 1;
+    while(rounded < parityPackets) {
+        rounded <<= 1;
+    }
+    unsigned int blockSize = rand()%(256 - rounded) + 1;
+    unsigned int loaded = rand()%4? blockSize : rand()%blockSize + 1;
+
+    if(!fftRoundTrip(CauchyFEC::FIELD_GF256, blockSize, parityPackets, loaded, 1500)) {
+        return false;
+    }
+
+    blockSize = rand()%2000 + 1;
+    parityPackets = rand()%500 + 1;
+    return fftRoundTrip(CauchyFEC::FIELD_GF65536, blockSize, parityPackets, blockSize, 100);
+}
+
+bool testFFTBoundary() {
+    /* k + m fills the field */
+    return fftRoundTrip(CauchyFEC::FIELD_GF256, 128, 128, 128, 100) &&
+           fftRoundTrip(CauchyFEC::FIELD_GF256, 255, 1, 255, 100) &&
+           fftRoundTrip(CauchyFEC::FIELD_GF65536, 65536 - 4096, 4096, 65536 - 4096, 4);
+}
+
+bool fountainRoundTrip(unsigned int blockSize, unsigned int maxLength) {
+    std::vector<std::vector<uint8_t>> source, packets;
+    makeRandomPackets(source, blockSize, maxLength);
+
+    FountainFEC encoder, decoder;
+    encoder.reset(true, blockSize);
+    encoder << source;
+
+    /* Lose a fraction, then send repair packets with a small overhead */
+    unsigned int lost = rand()%(blockSize / 4 + 1);
+    encoder.requestPackets(packets, blockSize + lost + 10);
+    losePackets(packets, lost);
+    shufflePackets(packets);
+
+    decoder.reset(false);
+    decoder << packets;
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, blockSize);
+    return output == source;
+}
+
+bool testFountain() {
+    return fountainRoundTrip(rand()%2000 + 1, 500);
+}
+
+bool testFountainBoundary() {
+    /* Blocks of up to 65536 packets are accepted, the largest ones take minutes to solve */
+    try {
+        FountainFEC encoder;
+        encoder.reset(true, 65537);
+        return false;
+    } catch(std::runtime_error&) {
+    }
+
+    return fountainRoundTrip(1, 500) && fountainRoundTrip(16384, 4);
+}
+
+bool slidingWindowStream(unsigned int windowSize, unsigned int numPackets, unsigned int lossPercent) {
+    SlidingWindowFEC encoder, decoder;
+    encoder.reset(true, windowSize);
+    decoder.reset(false);
+
+    std::vector<std::vector<uint8_t>> source;
+    unsigned int delivered = 0;
+
+    for(unsigned int i = 0; i < numPackets; i++) {
+        std::vector<uint8_t> packet;
+        makeRandomVector(packet, rand()%1000 + 1);
+        source.push_back(packet);
+        encoder << packet;
+
+        std::vector<std::vector<uint8_t>> packets;
+        encoder.requestPackets(packets, (i % 4 == 3)? 2 : 1);
+
+        for(auto& packet: packets) {
+            if((unsigned int)rand()%100 >= lossPercent) {
+                decoder << packet;
+            }
+
+            /* Released packets come in order, skipped ones are missing */
+            std::vector<uint8_t> output;
+            while(decoder >> output) {
+                while(delivered < source.size() && source[delivered] != output) {
+                    delivered++;
+                }
+                if(delivered == source.size()) {
+                    return false;
+                }
+                delivered++;
+            }
+        }
+    }
+
+    return lossPercent || !decoder.lostPackets();
+}
+
+bool testSlidingWindow() {
+    return slidingWindowStream(rand()%64 + 1, 500, rand()%10);
+}
+
+bool testSlidingWindowBoundary() {
+    return slidingWindowStream(1, 200, 0) && slidingWindowStream(256, 2000, 5);
+}
+
+bool xorRoundTrip(unsigned int columns, unsigned int rows, unsigned int loaded, unsigned int maxLength) {
+    std::vector<std::vector<uint8_t>> source, packets;
+    makeRandomPackets(source, loaded, maxLength);
+
+    XorFEC2D encoder, decoder;
+    encoder.reset(true, columns, rows);
+    encoder << source;
+    if(loaded < columns * rows) {
+        encoder.flush();
+    }
+    encoder.requestPackets(packets, 2 * loaded + columns + rows);
+
+    /* A single loss is always repaired */
+    losePackets(packets, 1);
+    shufflePackets(packets);
+
+    decoder.reset(false);
+    decoder << packets;
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, loaded);
+    return output == source;
+}
+
+bool testXor2D() {
+    unsigned int columns = rand()%16 + 1;
+    unsigned int rows = rand()%16 + 1;
+    unsigned int loaded = rand()%4? columns * rows : rand()%(columns * rows) + 1;
+    return xorRoundTrip(columns, rows, loaded, 1500);
+}
+
+bool testXor2DBoundary() {
+    /* Every index must fit in 16 bits: columns * rows + columns + rows <= 65536 */
+    const unsigned int tooLarge[][2] = {{256, 255}, {16, 4000}, {1, 32768}, {257, 1}};
+    for(auto& geometry: tooLarge) {
+        try {
+            XorFEC2D encoder;
+            encoder.reset(true, geometry[0], geometry[1]);
+            return false;
+        } catch(std::runtime_error&) {
+        }
+    }
+
+    return xorRoundTrip(256, 254, 256 * 254, 8) && xorRoundTrip(1, 32767, 32767, 8) &&
+           xorRoundTrip(256, 254, 256 * 200 + 3, 8) && xorRoundTrip(1, 1, 1, 100);
+}
+
+bool testInterleaver() {
+    unsigned int depth = rand()%16 + 1;
+    unsigned int blockSize = rand()%32 + 1;
+    unsigned int parityPackets = rand()%4 + 1;
+    unsigned int loaded = rand()%4? depth * blockSize : rand()%(depth * blockSize) + 1;
+    unsigned int lanes = std::min(depth, loaded);
+
+    std::vector<std::vector<uint8_t>> source, packets;
+    makeRandomPackets(source, loaded, 1000);
+
+    CauchyFECInterleaver encoder, decoder;
+    unsigned int threads = rand()%4 + 1;
+    encoder.setThreads(threads);
+    decoder.setThreads(threads);
+    encoder.reset(true, depth, blockSize);
+    encoder << source;
+    if(loaded < depth * blockSize) {
+        encoder.flush();
+    }
+    encoder.requestPackets(packets, loaded + lanes * parityPackets);
+
+    /* A burst of lanes * m packets costs every block at most m */
+    unsigned int burst = lanes * parityPackets;
+    unsigned int start = rand()%(packets.size() - burst + 1);
+    packets.erase(packets.begin() + start, packets.begin() + start + burst);
+
+    decoder.reset(false);
+    decoder << packets;
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, loaded + 1);
+    return output == source;
+}
+
+bool testInterleaverBoundary() {
+    std::vector<std::vector<uint8_t>> source, packets;
+    makeRandomPackets(source, 256 * 2, 100);
+
+    CauchyFECInterleaver encoder, decoder;
+    encoder.reset(true, 256, 2);
+    encoder << source;
+    encoder.requestPackets(packets, 256 * 3);
+    unsigned int start = rand()%(packets.size() - 256 + 1);
+    packets.erase(packets.begin() + start, packets.begin() + start + 256);
+
+    decoder.reset(false);
+    decoder << packets;
+
+    std::vector<std::vector<uint8_t>> output;
+    decoder.requestPackets(output, 256 * 2);
+    return output == source;
+}
+
+struct Mode {
+    const char* name;
+    bool (*test)();
+    unsigned int iterations;
+};
+
+int main() {
+    srand(time(NULL));
+    CauchyFEC::init();
+    FFTFEC::init();
+    FountainFEC::init();
+    SlidingWindowFEC::init();
+
+    const Mode modes[] = {
+        {"Cauchy GF(2^8), step and flush", testCauchy, 300},
+        {"Cauchy GF(2^8) boundary", testCauchyBoundary, 1},
+        {"Cauchy step resumed by a request", testCauchyStepResume, 100},
+        {"Cauchy GF(2^16)", testCauchyWide, 30},
+        {"Cauchy GF(2^16) boundary", testCauchyWideBoundary, 1},
+        {"Cauchy large symbols", testCauchyLargeSymbols, 20},
+        {"Cauchy local groups", testCauchyLocalGroups, 200},
+        {"Cauchy local repair in steps", testCauchyLocalRepairStep, 100},
+        {"Cauchy normalized generator", testCauchyNormalized, 200},
+        {"Cauchy updateParity", testCauchyUpdateParity, 200},
+        {"Cauchy decodeRange", testCauchyDecodeRange, 200},
+        {"Cauchy verify", testCauchyVerify, 200},
+        {"Cauchy raw block", testCauchyRawBlock, 50},
+        {"Packer", testPacker, 200},
+        {"Packer corrupt length", testPackerCorruptLength, 1},
+        {"FixedCauchyCodec", testFixed, 50},
+        {"FixedCauchyCodec boundary", testFixedBoundary, 1},
+        {"FFTFEC", testFFT, 50},
+        {"FFTFEC boundary", testFFTBoundary, 1},
+        {"FountainFEC", testFountain, 30},
+        {"FountainFEC boundary", testFountainBoundary, 1},
+        {"SlidingWindowFEC", testSlidingWindow, 30},
+        {"SlidingWindowFEC boundary", testSlidingWindowBoundary, 1},
+        {"XorFEC2D", testXor2D, 300},
+        {"XorFEC2D boundary", testXor2DBoundary, 1},
+        {"Interleaver", testInterleaver, 100},
+        {"Interleaver boundary", testInterleaverBoundary, 1},
+    };
+
+    for(auto& mode: modes) {
+        for(unsigned int i=0; i<mode.iterations; i++) {
+            if(!mode.test()) {
+                std::cout<<mode.name<<": Test Failed\n";
+                return 1;
+            }
+        }
+        std::cout<<mode.name<<": OK\n";
+    }
+
+    std::cout<<"Test passed\n";
+    return 0;
+}
@@ -0,0 +1,10 @@
+#!/bin/sh
+
+# A lossless channel must not report residual loss, also when blocks complete before their parity is sent
+for channel in "--delay 100" "--delay 100 --reorder 0.5:3000"; do
+    LD_LIBRARY_PATH=.. ../fecsim --blocks 1000 $channel --json | grep -q '"residual_loss":0,' || {
+        echo "fecsim $channel: Test Failed"
+        exit 1
+    }
+done
+echo "Test passed"
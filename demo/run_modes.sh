@@ -0,0 +1,4 @@
+#!/bin/sh
+
+g++ -std=c++1y -O3 -Wall -Werror -pthread modes.cpp -o modes -L .. -lerasure -I ../src &&
+LD_LIBRARY_PATH=.. ./modes
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ADDITIVEFFT_H_
+#define ADDITIVEFFT_H_
+
+#include <stdexcept>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include "GFRegion.h"
+
+/*
+ * Additive FFT over GF(2^Bits) in the novel polynomial basis of Lin, Chung and Han. Field
+ * elements are stored in Cantor basis coordinates, so evaluation point i is simply the
+ * element i and the formal derivative only needs XORs. Buffers are regions of field
+ * elements, 16 bit elements are stored big endian.
+ */
+template <unsigned int Bits, uint32_t P> class AdditiveFFT {
+public:
+    using Element = typename std::conditional<Bits == 8, uint8_t, uint16_t>::type;
+
+    static const unsigned int Order = 1U << Bits;
+    static const unsigned int Modulus = Order - 1;
+
+    static void init() {
+        buildTables();
+    }
+
+    /* Log of the multiplier that undoes a multiplication by exp(log) */
+    static inline unsigned int inverseLog(unsigned int log) {
+        return Modulus - log;
+    }
+
+    /* dst[i] += exp(log) * src[i], dst and src may be the same region */
+    static void mulAddRegionLog(uint8_t* dst, const uint8_t* src, unsigned int log, size_t len) {
+        mulAddRegion(dst, src, expTable_[log], len);
+    }
+
+    /* dst[i] *= exp(log) */
+    static void mulRegionLog(uint8_t* dst, unsigned int log, size_t len) {
+        /* x * c == x + x * (c + 1) */
+        mulAddRegion(dst, dst, expTable_[log] ^ 1, len);
+    }
+
+    /*
+     * Transform m buffers (a power of two) from evaluations at points offset .. offset + m - 1
+     * to coefficients.
+     */
+    static void ifft(uint8_t* const* work, size_t bytes, unsigned int m, unsigned int offset) {
+        const Element* skew = skewTable_ + offset - 1;
+
+        for(unsigned int dist = 1; dist < m; dist <<= 1) {
+            for(unsigned int r = 0; r < m; r += 2 * dist) {
+                const Element log = skew[r + dist];
+
+                for(unsigned int i = r; i < r + dist; i++) {
+                    GFRegion::xorRegion(work[i + dist], work[i], bytes);
+                    if(log != Modulus) {
+                        mulAddRegionLog(work[i], work[i + dist], log, bytes);
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+     * The inverse of ifft(), only the first outputs buffers are calculated. The others are
+     * left in an undefined state.
+     */
+    static void fft(uint8_t* const* work, size_t bytes, unsigned int outputs, unsigned int m, unsigned int offset) {
+        const Element* skew = skewTable_ + offset - 1;
+
+        for(unsigned int dist = m >> 1; dist > 0; dist >>= 1) {
+            for(unsigned int r = 0; r < outputs; r += 2 * dist) {
+                const Element log = skew[r + dist];
+
+                for(unsigned int i = r; i < r + dist; i++) {
+                    if(log != Modulus) {
+                        mulAddRegionLog(work[i], work[i + dist], log, bytes);
+                    }
+                    GFRegion::xorRegion(work[i + dist], work[i], bytes);
+                }
+            }
+        }
+    }
+
+    static void formalDerivative(uint8_t* const* work, size_t bytes, unsigned int n) {
+        for(unsigned int i = 1; i < n; i++) {
+            const unsigned int width = ((i ^ (i - 1)) + 1) >> 1;
+
+            for(unsigned int j = 0; j < width; j++) {
+                GFRegion::xorRegion(work[i - width + j], work[i + j], bytes);
+            }
+        }
+    }
+
+    /*
+     * For every point i the log of the product of (i + j) over all erased points j != i,
+     * calculated as a convolution of logarithms with the Walsh-Hadamard transform.
+     */
+    static void errorLocator(const std::vector<bool>& erased, std::vector<uint32_t>& logs) {
+        logs.assign(Order, 0);
+        for(unsigned int i = 0; i < erased.size() && i < Order; i++) {
+            logs[i] = erased[i];
+        }
+
+        fwht(logs.data());
+        for(unsigned int i = 0; i < Order; i++) {
+            logs[i] = (uint64_t)logs[i] * logWalsh_[i] % Modulus;
+        }
+        /* The missing division by Order is free: Order == 1 mod Modulus */
+        fwht(logs.data());
+    }
+
+private:
+    static inline uint32_t addMod(uint32_t a, uint32_t b) {
+        uint32_t sum = a + b;
+        return (sum + (sum >> Bits)) & Modulus;
+    }
+
+    static inline uint32_t subMod(uint32_t a, uint32_t b) {
+        uint32_t dif = a - b;
+        return (dif + (dif >> Bits)) & Modulus;
+    }
+
+    static inline Element mulLog(Element a, uint32_t log) {
+        if(a == 0) {
+            return 0;
+        }
+        return expTable_[addMod(logTable_[a], log)];
+    }
+
+    static void mulAddRegion(uint8_t* dst, const uint8_t* src, Element c, size_t len) {
+        if(c == 0) {
+            return;
+        }
+
+        if(Bits == 8) {
+            uint8_t tables[2][16];
+            for(unsigned int i = 0; i < 16; i++) {
+                tables[0][i] = mulLog(i, logTable_[c]);
+                tables[1][i] = mulLog(i << 4, logTable_[c]);
+            }
+            GFRegion::mulAdd8(dst, src, tables, len);
+        } else {
+            uint8_t tables[8][16];
+            for(unsigned int nibble = 0; nibble < 4; nibble++) {
+                for(unsigned int i = 0; i < 16; i++) {
+                    Element product = mulLog(i << (4 * nibble), logTable_[c]);
+                    tables[2 * nibble][i] = product & 0xFF;
+                    tables[2 * nibble + 1][i] = product >> 8;
+                }
+            }
+            GFRegion::mulAdd16(dst, src, tables, len);
+        }
+    }
+
+    static void fwht(uint32_t* data) {
+        for(unsigned int width = 1; width < Order; width <<= 1) {
+            for(unsigned int r = 0; r < Order; r += 2 * width) {
+                for(unsigned int i = r; i < r + width; i++) {
+                    uint32_t a = data[i];
+                    uint32_t b = data[i + width];
+                    data[i] = addMod(a, b);
+                    data[i + width] = subMod(a, b);
+                }
+            }
+        }
+    }
+
+    static void buildTables() {
+        if(tableBuilt_) return;
+
+        /* Logarithms in the polynomial basis, x generates the group */
+        std::vector<uint32_t> polyLog(Order), polyExp(Order);
+        uint32_t state = 1;
+        for(unsigned int i = 0; i < Modulus; i++) {
+            polyExp[i] = state;
+            polyLog[state] = i;
+            state <<= 1;
+            if(state >= Order) {
+                state ^= P;
+            }
+        }
+        if(state != 1) {
+            throw std::logic_error("Polynomial is not primitive");
+        }
+
+        auto polyMul = [&](uint32_t a, uint32_t b) -> uint32_t {
+            if(!a || !b) {
+                return 0;
+            }
+            return polyExp[(polyLog[a] + polyLog[b]) % Modulus];
+        };
+
+        /* Cantor basis: v0 = 1, v[i]^2 + v[i] = v[i-1] */
+        uint32_t basis[Bits];
+        basis[0] = 1;
+        for(unsigned int i = 1; i < Bits; i++) {
+            basis[i] = 0;
+            for(uint32_t v = 2; v < Order; v++) {
+                if((polyMul(v, v) ^ v) == basis[i - 1]) {
+                    basis[i] = v;
+                    break;
+                }
+            }
+            if(!basis[i]) {
+                throw std::logic_error("Field has no Cantor basis");
+            }
+        }
+
+        /* Element i is the sum of the basis vectors selected by its bits */
+        std::vector<uint32_t> cantorToPoly(Order);
+        cantorToPoly[0] = 0;
+        for(unsigned int i = 0; i < Bits; i++) {
+            const unsigned int width = 1U << i;
+            for(unsigned int j = 0; j < width; j++) {
+                cantorToPoly[j + width] = cantorToPoly[j] ^ basis[i];
+            }
+        }
+
+        /* Log(0) is stored as Modulus, exp(Modulus) wraps around */
+        logTable_[0] = Modulus;
+        for(unsigned int i = 1; i < Order; i++) {
+            logTable_[i] = polyLog[cantorToPoly[i]];
+        }
+        for(unsigned int i = 1; i < Order; i++) {
+            expTable_[logTable_[i]] = i;
+        }
+        expTable_[Modulus] = expTable_[0];
+
+        /* Skew factors of every butterfly, as logarithms */
+        Element temp[Bits - 1];
+        for(unsigned int i = 1; i < Bits; i++) {
+            temp[i - 1] = 1U << i;
+        }
+
+        for(unsigned int m = 0; m < Bits - 1; m++) {
+            const unsigned int step = 1U << (m + 1);
+
+            skewTable_[(1U << m) - 1] = 0;
+
+            for(unsigned int i = m; i < Bits - 1; i++) {
+                const unsigned int s = 1U << (i + 1);
+
+                for(unsigned int j = (1U << m) - 1; j < s; j += step) {
+                    skewTable_[j + s] = skewTable_[j] ^ temp[i];
+                }
+            }
+
+            temp[m] = Modulus - logTable_[mulLog(temp[m], logTable_[temp[m] ^ 1])];
+
+            for(unsigned int i = m + 1; i < Bits - 1; i++) {
+                const uint32_t sum = addMod(logTable_[temp[i] ^ 1], temp[m]);
+                temp[i] = mulLog(temp[i], sum);
+            }
+        }
+
+        for(unsigned int i = 0; i < Modulus; i++) {
+            skewTable_[i] = logTable_[skewTable_[i]];
+        }
+
+        /* Walsh-Hadamard transform of the logarithms, used by errorLocator() */
+        std::vector<uint32_t> logWalsh(Order);
+        for(unsigned int i = 0; i < Order; i++) {
+            logWalsh[i] = logTable_[i];
+        }
+        logWalsh[0] = 0;
+        fwht(logWalsh.data());
+        for(unsigned int i = 0; i < Order; i++) {
+            logWalsh_[i] = logWalsh[i];
+        }
+
+        tableBuilt_ = true;
+    }
+
+    static Element expTable_[Order];
+    static Element logTable_[Order];
+    static Element skewTable_[Order];
+    static Element logWalsh_[Order];
+    static bool tableBuilt_;
+};
+
+template <unsigned int Bits, uint32_t P> typename AdditiveFFT<Bits, P>::Element AdditiveFFT<Bits, P>::expTable_[Order];
+template <unsigned int Bits, uint32_t P> typename AdditiveFFT<Bits, P>::Element AdditiveFFT<Bits, P>::logTable_[Order];
+template <unsigned int Bits, uint32_t P> typename AdditiveFFT<Bits, P>::Element AdditiveFFT<Bits, P>::skewTable_[Order];
+template <unsigned int Bits, uint32_t P> typename AdditiveFFT<Bits, P>::Element AdditiveFFT<Bits, P>::logWalsh_[Order];
+template <unsigned int Bits, uint32_t P> bool AdditiveFFT<Bits, P>::tableBuilt_ = false;
+
+#endif /* ADDITIVEFFT_H_ */
@@ -35,6 +35,26 @@ CauchyFEC::CauchyFEC():
     impl_(new impl()) {
 }
 
+void CauchyFEC::setField(Field field) {
+    impl_->setField(field);
+}
+
+void CauchyFEC::setLargeSymbols(bool enable) {
+    impl_->setLargeSymbols(enable);
+}
+
+void CauchyFEC::setLocalGroups(unsigned int groupSize) {
+    impl_->setLocalGroups(groupSize);
+}
+
+void CauchyFEC::setExtendedTrailer(bool enable) {
+    impl_->setExtendedTrailer(enable);
+}
+
+void CauchyFEC::setGenerator(Generator generator) {
+    impl_->setGenerator(generator);
+}
+
 void CauchyFEC::reset(bool encode, unsigned int numberOfSourcePackets) {
     impl_->reset(encode, numberOfSourcePackets);
 }
@@ -43,6 +63,10 @@ void CauchyFEC::operator<<(const std::vector<uint8_t>& sourcePacket) {
     impl_->operator<<(sourcePacket);
 }
 
+void CauchyFEC::operator<<(std::vector<uint8_t>&& sourcePacket) {
+    impl_->operator<<(std::move(sourcePacket));
+}
+
 void CauchyFEC::operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets) {
     impl_->operator<<(sourcePackets);
 }
@@ -59,4 +83,74 @@ bool CauchyFEC::operator>>(std::vector<std::vector<uint8_t>>& outputPackets) {
     return impl_->operator>>(outputPackets);
 }
 
+void CauchyFEC::flush() {
+    impl_->flush();
+}
+
+void CauchyFEC::updateParity(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index,
+                             const std::vector<uint8_t>& oldPacket, const std::vector<uint8_t>& newPacket) {
+    impl_->updateParity(parityPackets, index, oldPacket, newPacket);
+}
+
+void CauchyFEC::updateParity(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index,
+                             size_t offset, const std::vector<uint8_t>& delta) {
+    impl_->updateParity(parityPackets, index, offset, delta);
+}
+
+bool CauchyFEC::packetLength(unsigned int index, size_t& length) {
+    return impl_->packetLength(index, length);
+}
+
+bool CauchyFEC::decodeRange(unsigned int index, size_t offset, size_t length, std::vector<uint8_t>& output) {
+    return impl_->decodeRange(index, offset, length, output);
+}
+
+bool CauchyFEC::verify(const std::vector<std::vector<uint8_t>>& packets,
+                       std::vector<unsigned int>& inconsistentParity, int& corruptSource) {
+    return impl_->verify(packets, inconsistentParity, corruptSource);
+}
+
+size_t CauchyFEC::parityLength(size_t longestSourcePacket) {
+    return impl_->parityLength(longestSourcePacket);
+}
+
+void CauchyFEC::encodeBlock(unsigned int numberOfSourcePackets, const uint8_t* const* sources, const size_t* lengths,
+                            unsigned int numParity, const unsigned int* parityRows, uint8_t* const* parity, size_t parityLength) {
+    impl_->encodeBlock(numberOfSourcePackets, sources, lengths, numParity, parityRows, parity, parityLength);
+}
+
+bool CauchyFEC::decodeBlock(unsigned int numberOfSourcePackets, const uint8_t* const* sources, size_t* lengths,
+                            unsigned int numParity, const unsigned int* parityRows, const uint8_t* const* parity,
+                            size_t parityLength, uint8_t* const* recovered) {
+    return impl_->decodeBlock(numberOfSourcePackets, sources, lengths, numParity, parityRows, parity, parityLength, recovered);
+}
+
+void CauchyFEC::schedulePackets(unsigned int numPackets) {
+    impl_->schedulePackets(numPackets);
+}
+
+bool CauchyFEC::step(unsigned int maxWork) {
+    return impl_->step(maxWork);
+}
+
+void CauchyFEC::enableStats(bool enable) {
+    impl_->enableStats(enable);
+}
+
+void CauchyFEC::getStats(Stats& stats) {
+    impl_->getStats(stats);
+}
+
+void CauchyFEC::clearStats() {
+    impl_->clearStats();
+}
+
+void CauchyFEC::enableGlobalStats(bool enable) {
+    CauchyFEC::impl::enableGlobalStats(enable);
+}
+
+void CauchyFEC::getGlobalStats(Stats& stats) {
+    CauchyFEC::impl::getGlobalStats(stats);
+}
+
 CauchyFEC::~CauchyFEC() = default;
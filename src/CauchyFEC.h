@@ -27,6 +27,7 @@
 
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 #ifndef CAUCHYFEC_H_
 #define CAUCHYFEC_H_
@@ -35,17 +36,171 @@
 
 class CauchyFEC {
 public:
+    /*
+     * GF(2^8) allows 256 packets per block. GF(2^16) allows 65536 packets per block, it uses
+     * a four byte trailer and symbols of two bytes. Both sides must use the same field.
+     */
+    enum Field {
+        FIELD_GF256,
+        FIELD_GF65536,
+    };
+
     static CAUCHYFEC_H_EXPORT_FUNCTION void init();
     CAUCHYFEC_H_EXPORT_FUNCTION CauchyFEC();
     CAUCHYFEC_H_EXPORT_FUNCTION ~CauchyFEC();
 
+    /* Takes effect at the next reset() */
+    void CAUCHYFEC_H_EXPORT_FUNCTION setField(Field field);
+
+    /*
+     * Store packet lengths in 32 instead of 16 bits, for packets larger than 64KiB. Both sides
+     * must use the same setting. Takes effect at the next reset().
+     */
+    void CAUCHYFEC_H_EXPORT_FUNCTION setLargeSymbols(bool enable);
+
+    /*
+     * Locally repairable code: the source packets are split in groups of groupSize packets.
+     * The first parity packets are the XOR of one group each, the following ones are Cauchy
+     * parity over the whole block. A single loss in a group is repaired from that group only.
+     * 0 disables this. Both sides must use the same setting. Takes effect at the next reset().
+     */
+    void CAUCHYFEC_H_EXPORT_FUNCTION setLocalGroups(unsigned int groupSize);
+
+    /*
+     * Generator matrix constructions. GENERATOR_NORMALIZED_CAUCHY scales the Cauchy matrix so
+     * that the first parity row and the first column are all ones (XOR instead of a multiply),
+     * it stays MDS. The decoder takes the construction from the extended trailer.
+     */
+    enum Generator {
+        GENERATOR_CAUCHY,
+        GENERATOR_NORMALIZED_CAUCHY,
+    };
+
+    /*
+     * Adds a byte with the generator construction to the trailer. Both sides must use the same
+     * setting. Takes effect at the next reset().
+     */
+    void CAUCHYFEC_H_EXPORT_FUNCTION setExtendedTrailer(bool enable);
+
+    /*
+     * Encoder: the generator construction, anything but GENERATOR_CAUCHY needs the extended
+     * trailer. The decoder uses it for the raw block interface only. Takes effect at the next
+     * reset().
+     */
+    void CAUCHYFEC_H_EXPORT_FUNCTION setGenerator(Generator generator);
+
     void CAUCHYFEC_H_EXPORT_FUNCTION reset(bool encode, unsigned int numberOfSourcePackets = 0);
     void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<uint8_t>& sourcePacket);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(std::vector<uint8_t>&& sourcePacket);
     void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets);
     unsigned int CAUCHYFEC_H_EXPORT_FUNCTION requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets = 1);
     bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<uint8_t>& outputPackets);
     bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<std::vector<uint8_t>>& outputPackets);
 
+    /*
+     * Encoder: close the block with the source packets loaded so far. Parity is generated for
+     * the shortened code, which the decoder detects from the trailer.
+     */
+    void CAUCHYFEC_H_EXPORT_FUNCTION flush();
+
+    /*
+     * Storage: bring parity packets up to date after source packet 'index' was overwritten,
+     * without reading the rest of the block. parityPackets are encoder output (with trailer)
+     * and are changed in place, only the bytes that differ are processed. The new packet must
+     * fit in the parity. Uses the settings of the last reset().
+     */
+    void CAUCHYFEC_H_EXPORT_FUNCTION updateParity(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index,
+                                                  const std::vector<uint8_t>& oldPacket, const std::vector<uint8_t>& newPacket);
+
+    /* Same for a precomputed delta (old XOR new) of bytes [offset, offset + delta.size()), the length does not change */
+    void CAUCHYFEC_H_EXPORT_FUNCTION updateParity(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index,
+                                                  size_t offset, const std::vector<uint8_t>& delta);
+
+    /*
+     * Decoder: degraded reads. packetLength() returns the length of source packet 'index',
+     * decodeRange() bytes [offset, offset + length) of it, clipped to the packet. A missing
+     * packet is only reconstructed over the requested range, from the packets received so
+     * far. Both return false if this is not possible (yet).
+     */
+    bool CAUCHYFEC_H_EXPORT_FUNCTION packetLength(unsigned int index, size_t& length);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION decodeRange(unsigned int index, size_t offset, size_t length, std::vector<uint8_t>& output);
+
+    /*
+     * Scrubbing: checks a complete block of encoder output (all source packets and any number
+     * of parity packets, with trailer) in one pass, without decoding. Returns false if parity
+     * packets do not match the source packets, their indices are stored in inconsistentParity.
+     * If the mismatch points at a single source packet its index is stored in corruptSource,
+     * otherwise it is -1. Uses the settings of the last reset().
+     */
+    bool CAUCHYFEC_H_EXPORT_FUNCTION verify(const std::vector<std::vector<uint8_t>>& packets,
+                                            std::vector<unsigned int>& inconsistentParity, int& corruptSource);
+
+    /*
+     * Raw block interface for storage, on caller buffers without trailers or copies. Every
+     * parity buffer holds parityLength(longest source packet) bytes. encodeBlock() writes the
+     * parity packets with the given generator rows (numberOfSourcePackets and up). decodeBlock()
+     * recovers the source packets that are nullptr into 'recovered' (parityLength bytes each)
+     * and stores their lengths, it returns false if the parity does not suffice. Both use the
+     * settings of the last reset().
+     */
+    size_t CAUCHYFEC_H_EXPORT_FUNCTION parityLength(size_t longestSourcePacket);
+    void CAUCHYFEC_H_EXPORT_FUNCTION encodeBlock(unsigned int numberOfSourcePackets, const uint8_t* const* sources, const size_t* lengths,
+                                                 unsigned int numParity, const unsigned int* parityRows, uint8_t* const* parity, size_t parityLength);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION decodeBlock(unsigned int numberOfSourcePackets, const uint8_t* const* sources, size_t* lengths,
+                                                 unsigned int numParity, const unsigned int* parityRows, const uint8_t* const* parity,
+                                                 size_t parityLength, uint8_t* const* recovered);
+
+    /*
+     * Cooperative processing: step() performs roughly maxWork bytes worth of GF operations
+     * and returns true once no more work can be done with the packets available. The encoder
+     * works on parity packets announced with schedulePackets(), the decoder starts recovering
+     * as soon as enough packets are received. Packets that are not finished when requested
+     * are completed synchronously. Only choosing the parity and building the generator is
+     * done in one go, that costs coefficients and does not depend on the packet size.
+     */
+    void CAUCHYFEC_H_EXPORT_FUNCTION schedulePackets(unsigned int numPackets);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION step(unsigned int maxWork);
+
+    /* Why a decoder gave up on a block, the packets it received contradict each other */
+    enum StuckReason {
+        STUCK_NONE,
+        STUCK_PARITY_LENGTH_MISMATCH,
+        STUCK_INVALID_PARITY_LENGTH,
+        STUCK_SOURCE_TOO_LONG,
+        STUCK_SINGULAR_MATRIX,
+        STUCK_INVALID_DECODED_LENGTH,
+    };
+
+    struct Stats {
+        uint64_t packetsIn;
+        uint64_t packetsOut;
+        uint64_t parityGenerated;
+        uint64_t parityConsumed;
+        uint64_t duplicatesDropped;
+        uint64_t foreignPacketsIgnored;
+        uint64_t decodeAttempts;
+        uint64_t decodeSuccesses;
+        uint64_t decodeFailures;
+        uint64_t stuckBlocks;
+        StuckReason lastStuckReason;
+        uint64_t nsMessageMatrix;
+        uint64_t nsGenerator;
+        uint64_t nsInversion;
+        uint64_t nsMultiply;
+        uint64_t bytesAllocated;
+    };
+
+    /*
+     * Counters of this instance, off by default. They accumulate over blocks until cleared.
+     * When the process wide aggregate is enabled every instance counts, and adds its counters
+     * to the aggregate at reset() and on destruction. Both take effect at the next reset().
+     */
+    void CAUCHYFEC_H_EXPORT_FUNCTION enableStats(bool enable);
+    void CAUCHYFEC_H_EXPORT_FUNCTION getStats(Stats& stats);
+    void CAUCHYFEC_H_EXPORT_FUNCTION clearStats();
+    static CAUCHYFEC_H_EXPORT_FUNCTION void enableGlobalStats(bool enable);
+    static CAUCHYFEC_H_EXPORT_FUNCTION void getGlobalStats(Stats& stats);
+
 private:
     class impl;
     std::unique_ptr<impl> impl_;
@@ -26,61 +26,145 @@
  */
 
 #include "CauchyFECImpl.h"
+#include <limits>
+#include <algorithm>
 
-bool CauchyFEC::impl::decoderMatrixInverse(Matrix<RSGF256Number>& matrix) {
-    if(matrix.rows() != matrix.columns()) {
-        throw std::runtime_error("Matrix not square");
-    }
+/* Inverses change with the loss pattern, so a routine is only compiled for a lot of work */
+static const size_t DECODER_JIT_MIN_WORK = 1024 * 1024;
 
-    Matrix<RSGF256Number> inverse(matrix.rows(), matrix.columns());
-    inverse.identity(1);
-
-    for(unsigned int pIndex = 0; pIndex < matrix.columns(); pIndex++) {
-        /*
-         * Since we perform integer calculations, selecting any non-zero pivot is fine.
-         */
-        RSGF256Number pivot = matrix(pIndex, pIndex);
+template <typename GF> static bool matrixInversePivot(Matrix<uint16_t>& matrix, Matrix<uint16_t>& inverse, unsigned int pIndex) {
+    /*
+     * Since we perform integer calculations, selecting any non-zero pivot is fine.
+     */
+    GF pivot = matrix(pIndex, pIndex);
 
-        if(!pivot) {
-            for(unsigned int pRow = pIndex + 1; pRow < matrix.rows(); pRow++) {
-                if(matrix(pRow, pIndex)) {
-                    /* Swap rows */
-                    matrix.swapRows(pRow, pIndex);
-                    inverse.swapRows(pRow, pIndex);
-                    pivot = matrix(pIndex, pIndex);
-                    break;
-                }
+    if(!pivot) {
+        for(unsigned int pRow = pIndex + 1; pRow < matrix.rows(); pRow++) {
+            if(matrix(pRow, pIndex)) {
+                /* Swap rows */
+                matrix.swapRows(pRow, pIndex);
+                inverse.swapRows(pRow, pIndex);
+                pivot = matrix(pIndex, pIndex);
+                break;
             }
+        }
 
-            if(!pivot) {
-                /* This matrix is singular? */
-                return false;
-            }
+        if(!pivot) {
+            /* This matrix is singular? */
+            return false;
         }
+    }
+
+    /* Divide the line of the pivot */
+    for(unsigned int col = pIndex; col < matrix.columns(); col++) {
+        matrix(pIndex, col) = GF(matrix(pIndex, col)) / pivot;
+    }
+    for(unsigned int col = 0; col < matrix.columns(); col++) {
+        inverse(pIndex, col) = GF(inverse(pIndex, col)) / pivot;
+    }
+
+    for(unsigned int row = 0; row < matrix.rows(); row++) {
+        if(row == pIndex)
+            continue;
+
+        /* Make zeros by subtracting sub (pivot is 1 now) */
+        GF factor = matrix(row, pIndex);
+        if(!factor)
+            continue;
 
-        /* Divide the line of the pivot */
         for(unsigned int col = pIndex; col < matrix.columns(); col++) {
-            matrix(pIndex, col) /= pivot;
+            matrix(row, col) = GF(matrix(row, col)) - factor * GF(matrix(pIndex, col));
         }
         for(unsigned int col = 0; col < matrix.columns(); col++) {
-            inverse(pIndex, col) /= pivot;
+            inverse(row, col) = GF(inverse(row, col)) - factor * GF(inverse(pIndex, col));
         }
+    }
 
-        for(unsigned int row = 0; row < matrix.rows(); row++) {
-            if(row == pIndex)
-                continue;
+    return true;
+}
 
-            /* Make zeros by subtracting sub (pivot is 1 now) */
-            RSGF256Number factor = matrix(row, pIndex);
+template <typename GF> static bool independentRow(std::vector<std::vector<uint16_t>>& basis, std::vector<uint16_t> row) {
+    /* Every basis row starts with a 1 in a column where all rows added after it are zero */
+    for(auto& basisRow: basis) {
+        unsigned int pivotCol = 0;
+        while(!basisRow[pivotCol]) {
+            pivotCol++;
+        }
 
-            for(unsigned int col = pIndex; col < matrix.columns(); col++) {
-                matrix(row, col) -= factor * matrix(pIndex, col);
-            }
-            for(unsigned int col = 0; col < matrix.columns(); col++) {
-                inverse(row, col) -= factor * inverse(pIndex, col);
+        GF factor = row[pivotCol];
+        if(!factor)
+            continue;
+
+        for(unsigned int col = pivotCol; col < row.size(); col++) {
+            row[col] = (GF(row[col]) - factor * GF(basisRow[col])).value();
+        }
+    }
+
+    unsigned int pivotCol = 0;
+    while(pivotCol < row.size() && !row[pivotCol]) {
+        pivotCol++;
+    }
+
+    if(pivotCol == row.size()) {
+        return false;
+    }
+
+    GF pivot = row[pivotCol];
+    for(unsigned int col = pivotCol; col < row.size(); col++) {
+        row[col] = (GF(row[col]) / pivot).value();
+    }
+    basis.push_back(std::move(row));
+
+    return true;
+}
+
+template <typename GF> static void rangeCoefficients(const Matrix<uint16_t>& inverse, const Matrix<uint16_t>& generator,
+                                                    const std::vector<unsigned int>& known, Matrix<uint16_t>& target) {
+    /*
+     * missing = inverse * (parity - generator * known), so every missing packet is a linear
+     * combination of the parity packets and the known packets.
+     */
+    unsigned int parityCount = inverse.rows();
+
+    for(unsigned int row = 0; row < parityCount; row++) {
+        for(unsigned int col = 0; col < parityCount; col++) {
+            target(row, col) = inverse(row, col);
+        }
+
+        for(unsigned int i = 0; i < known.size(); i++) {
+            GF sum = 0;
+            for(unsigned int j = 0; j < parityCount; j++) {
+                sum += GF(inverse(row, j)) * GF(generator(j, known[i]));
             }
+            target(row, parityCount + i) = sum.value();
         }
     }
+}
+
+bool CauchyFEC::impl::decoderMatrixInversePivot(Matrix<Coefficient>& matrix, Matrix<Coefficient>& inverse, unsigned int pIndex) {
+    if(field_ == FIELD_GF65536) {
+        return matrixInversePivot<RSGF65536Number>(matrix, inverse, pIndex);
+    } else {
+        return matrixInversePivot<RSGF256Number>(matrix, inverse, pIndex);
+    }
+}
+
+bool CauchyFEC::impl::decoderMatrixInverse(Matrix<Coefficient>& matrix) {
+    if(matrix.rows() != matrix.columns()) {
+        throw std::runtime_error("Matrix not square");
+    }
+
+    Matrix<Coefficient> inverse(matrix.rows(), matrix.columns());
+    inverse.identity(1);
+
+    CAUCHYFEC_PROBE1(inverse_start, matrix.rows());
+    for(unsigned int pIndex = 0; pIndex < matrix.columns(); pIndex++) {
+        if(!decoderMatrixInversePivot(matrix, inverse, pIndex)) {
+            CAUCHYFEC_PROBE2(inverse_end, matrix.rows(), false);
+            return false;
+        }
+    }
+    CAUCHYFEC_PROBE2(inverse_end, matrix.rows(), true);
 
     matrix = std::move(inverse);
 
@@ -89,25 +173,41 @@ bool CauchyFEC::impl::decoderMatrixInverse(Matrix<RSGF256Number>& matrix) {
 
 void CauchyFEC::impl::decoderReset() {
     decoderWaitingFirstPacket_ = true;
+    numSourcePackets_ = 0;
+    decoderRangeReady_ = false;
     decoderOriginalPacketsReceived_ = 0;
     decoderPacketsReturned_ = 0;
     decoderStuck_ = false;
+    decoderStage_ = DECODER_IDLE;
+    decoderLocalActive_ = false;
 }
 
-void CauchyFEC::impl::decoderOperatorLL(const std::vector<uint8_t>& inputPacket) {
+bool CauchyFEC::impl::decoderPacketWanted(const std::vector<uint8_t>& inputPacket, unsigned int& packetIndex) {
+    statsCount(&Stats::packetsIn);
+
     /* No point in reading more packets if we won't be able to produce output */
     if(decoderStuck_) {
-        return;
+        return false;
     }
 
     /* We don't allow 0 byte application level packets */
-    if(inputPacket.size() <= 2) {
-        return;
+    if(inputPacket.size() <= trailerSize()) {
+        return false;
+    }
+
+    unsigned int announcedSourcePackets;
+    readTrailer(inputPacket, packetIndex, announcedSourcePackets);
+
+    Generator generator;
+    if(!readGenerator(inputPacket, generator)) {
+        statsCount(&Stats::foreignPacketsIgnored);
+        return false;
     }
 
     if(decoderWaitingFirstPacket_) {
         decoderWaitingFirstPacket_ = false;
-        numSourcePackets_ = inputPacket[inputPacket.size() - 1] + 1;
+        numSourcePackets_ = announcedSourcePackets;
+        generator_ = generator;
 
         decoderPacketBuffer_.resize(numSourcePackets_);
 
@@ -116,169 +216,594 @@ void CauchyFEC::impl::decoderOperatorLL(const std::vector<uint8_t>& inputPacket)
         }
     } else {
         /* Same series? */
-        if(numSourcePackets_ != (inputPacket[inputPacket.size() - 1] + 1U)) {
-            return;
+        if(generator_ != generator) {
+            statsCount(&Stats::foreignPacketsIgnored);
+            return false;
+        }
+
+        if(numSourcePackets_ != announcedSourcePackets) {
+            if(!decoderShortenBlock(announcedSourcePackets, packetIndex)) {
+                statsCount(&Stats::foreignPacketsIgnored);
+                return false;
+            }
         }
     }
 
-    uint8_t packetIndex = inputPacket[inputPacket.size() - 2];
+    /* Duplicate source packet? */
+    if(packetIndex < numSourcePackets_ && decoderPacketBuffer_[packetIndex].size()) {
+        statsCount(&Stats::duplicatesDropped);
+        return false;
+    }
+
+    return true;
+}
+
+void CauchyFEC::impl::decoderStorePacket(std::vector<uint8_t>&& inputPacket, unsigned int packetIndex) {
+    decoderRangeReady_ = false;
+    CAUCHYFEC_PROBE3(decoder_packet, numSourcePackets_, packetIndex, inputPacket.size());
 
     if(packetIndex < numSourcePackets_) {
-        if(!decoderPacketBuffer_[packetIndex].size()) {
-            decoderPacketBuffer_[packetIndex] = inputPacket;
-            decoderPacketBuffer_[packetIndex].resize(inputPacket.size() - 2);
-            decoderOriginalPacketsReceived_++;
-        }
+        decoderPacketBuffer_[packetIndex] = std::move(inputPacket);
+        decoderPacketBuffer_[packetIndex].resize(decoderPacketBuffer_[packetIndex].size() - trailerSize());
+        decoderOriginalPacketsReceived_++;
     } else {
-        decoderPacketBuffer_.push_back(inputPacket);
+        decoderPacketBuffer_.push_back(std::move(inputPacket));
     }
 }
 
+void CauchyFEC::impl::decoderOperatorLL(const std::vector<uint8_t>& inputPacket) {
+    unsigned int packetIndex;
+    if(decoderPacketWanted(inputPacket, packetIndex)) {
+        statsCount(&Stats::bytesAllocated, inputPacket.size());
+        decoderStorePacket(std::vector<uint8_t>(inputPacket), packetIndex);
+    }
+}
+
+void CauchyFEC::impl::decoderOperatorLL(std::vector<uint8_t>&& inputPacket) {
+    unsigned int packetIndex;
+    if(decoderPacketWanted(inputPacket, packetIndex)) {
+        decoderStorePacket(std::move(inputPacket), packetIndex);
+    }
+}
+
+bool CauchyFEC::impl::decoderShortenBlock(unsigned int announcedSourcePackets, unsigned int packetIndex) {
+    /*
+     * An encoder that is flushed announces fewer source packets than the packets it sent
+     * before. Source packets are identical in both codes, so they are accepted from either.
+     */
+    if(announcedSourcePackets > numSourcePackets_) {
+        return packetIndex < numSourcePackets_;
+    }
+
+    /* Shrink the block, this is only possible if no packet contradicts the shorter code */
+    if(decoderPacketBuffer_.size() > numSourcePackets_) {
+        return false;
+    }
+
+    for(unsigned int i = announcedSourcePackets; i < numSourcePackets_; i++) {
+        if(decoderPacketBuffer_[i].size()) {
+            return false;
+        }
+    }
+
+    numSourcePackets_ = announcedSourcePackets;
+    decoderPacketBuffer_.resize(numSourcePackets_);
+
+    return true;
+}
+
 void CauchyFEC::impl::decoderOperatorLL(const std::vector<std::vector<uint8_t>>& inputPackets) {
     for(auto& inputPacket: inputPackets) {
         decoderOperatorLL(inputPacket);
     }
 }
 
-bool CauchyFEC::impl::decoderRun() {
-    /* How many parity packets will we use */
-    unsigned int parityPacketsNeeded = numSourcePackets_ - decoderOriginalPacketsReceived_;
-    if(!parityPacketsNeeded) {
-        return true;
+void CauchyFEC::impl::decoderLocalRepairStep(size_t& budget) {
+    /*
+     * A group with a single missing packet is repaired with XOR from its local parity. Only
+     * the packets of the group are read, the rest of the block is not needed. The parity at
+     * decoderProgress_ is copied and the group is added to it one budgeted chunk at a time.
+     */
+    auto& parity = decoderPacketBuffer_[decoderProgress_];
+    size_t parityLength = parity.size() - trailerSize();
+    size_t dataLength = parityLength - lengthSize();
+
+    if(!decoderLocalActive_) {
+        unsigned int packetIndex, announcedSourcePackets;
+        readTrailer(parity, packetIndex, announcedSourcePackets);
+
+        if(packetIndex >= numSourcePackets_ + numLocalGroups(numSourcePackets_) ||
+           parityLength < lengthSize() || alignLength(parityLength) != parityLength) {
+            decoderProgress_++;
+            return;
+        }
+
+        unsigned int groupStart = (packetIndex - numSourcePackets_) * localGroupSize_;
+        unsigned int groupEnd = std::min(groupStart + localGroupSize_, numSourcePackets_);
+        unsigned int missing = 0, missingCount = 0;
+        bool valid = true;
+        for(unsigned int source = groupStart; source < groupEnd; source++) {
+            if(!decoderPacketBuffer_[source].size()) {
+                missing = source;
+                missingCount++;
+            } else {
+                valid = valid && decoderPacketBuffer_[source].size() <= dataLength;
+            }
+        }
+
+        if(missingCount != 1 || !valid) {
+            decoderProgress_++;
+            return;
+        }
+
+        statsCount(&Stats::bytesAllocated, parityLength);
+        decoderLocalActive_ = true;
+        decoderLocalMissing_ = missing;
+        decoderProgressSource_ = groupStart;
+        decoderProgressOffset_ = 0;
+        decoderLocalRecovered_.clear();
+        decoderLocalRecovered_.reserve(parityLength);
     }
 
-    if(parityPacketsNeeded > decoderPacketBuffer_.size() - numSourcePackets_) {
-        /* This is doomed to fail from the start */
+    StatsTimer timer(*this, &Stats::nsMultiply);
+
+    if(decoderLocalRecovered_.size() < parityLength) {
+        size_t start = decoderLocalRecovered_.size();
+        size_t end = start + std::min<size_t>(parityLength - start, budget);
+        decoderLocalRecovered_.insert(decoderLocalRecovered_.end(), parity.begin() + start, parity.begin() + end);
+        budget -= std::min<size_t>(budget, end - start);
+        return;
+    }
+
+    unsigned int groupEnd = std::min((decoderLocalMissing_ / localGroupSize_ + 1) * localGroupSize_, numSourcePackets_);
+    if(decoderProgressSource_ < groupEnd) {
+        unsigned int source = decoderProgressSource_;
+        auto& goodPacket = decoderPacketBuffer_[source];
+
+        if(source != decoderLocalMissing_ && decoderProgressOffset_ < goodPacket.size()) {
+            size_t end = decoderProgressOffset_ + std::min<size_t>(goodPacket.size() - decoderProgressOffset_, alignChunk(budget));
+            mulAddRegion(&decoderLocalRecovered_[decoderProgressOffset_], &goodPacket[decoderProgressOffset_], 1, end - decoderProgressOffset_);
+            budget -= std::min<size_t>(budget, end - decoderProgressOffset_);
+            decoderProgressOffset_ = end;
+
+            if(decoderProgressOffset_ < goodPacket.size()) {
+                return;
+            }
+            mulAddLength(&decoderLocalRecovered_[dataLength], goodPacket.size(), 1);
+        }
+
+        decoderProgressSource_++;
+        decoderProgressOffset_ = 0;
+        return;
+    }
+
+    /* The packet may have arrived while we were repairing */
+    size_t packetSize = readLength(&decoderLocalRecovered_[dataLength]);
+    if(packetSize && packetSize <= dataLength && !decoderPacketBuffer_[decoderLocalMissing_].size()) {
+        decoderLocalRecovered_.resize(packetSize);
+        decoderPacketBuffer_[decoderLocalMissing_] = std::move(decoderLocalRecovered_);
+        statsCount(&Stats::parityConsumed);
+    }
+
+    decoderLocalRecovered_.clear();
+    decoderLocalActive_ = false;
+    decoderProgress_++;
+}
+
+bool CauchyFEC::impl::decoderSelectParity(unsigned int parityPacketsNeeded, std::vector<unsigned int>& usedParityPacketIndex) {
+    decoderUsedParity_.clear();
+    decoderUsedParityRows_.assign(fieldSize(), false);
+
+    /* Find N unique parity packets, the MDS code can use any of them */
+    if(!localGroupSize_) {
+        for(unsigned int i=numSourcePackets_; i<decoderPacketBuffer_.size(); i++) {
+            unsigned int packetIndex, announcedSourcePackets;
+            readTrailer(decoderPacketBuffer_[i], packetIndex, announcedSourcePackets);
+
+            /* Did we already use this parity packet? */
+            if(!decoderUsedParityRows_[packetIndex]) {
+                usedParityPacketIndex.push_back(packetIndex);
+                decoderUsedParity_.push_back(i);
+                decoderUsedParityRows_[packetIndex] = true;
+
+                if(decoderUsedParity_.size() >= parityPacketsNeeded) {
+                    return true;
+                }
+            }
+        }
+
         return false;
     }
 
-    /* Find N unique parity packets */
-    uint8_t usedParityIndex = 0;
-    uint8_t usedParity[parityPacketsNeeded];
-    uint8_t usedParityPacketIndex[parityPacketsNeeded];
-    uint64_t usedParityBitfield[4] = {0, 0, 0, 0};
+    /*
+     * The locally repairable code is not MDS: local parity only covers its own group. Local
+     * parity is cheaper and is tried first, a packet is only used if it is independent of the
+     * ones selected so far when restricted to the missing packets.
+     */
+    unsigned int localGroups = numLocalGroups(numSourcePackets_);
+    Matrix<Coefficient> generatorRow(1, numSourcePackets_);
+    std::vector<std::vector<Coefficient>> basis;
 
-    for(unsigned int i=numSourcePackets_; i<decoderPacketBuffer_.size(); i++) {
-        auto& parity = decoderPacketBuffer_[i];
-        uint8_t packetIndex = parity[parity.size() - 2];
+    for(unsigned int pass = 0; pass < 2; pass++) {
+        for(unsigned int i=numSourcePackets_; i<decoderPacketBuffer_.size(); i++) {
+            unsigned int packetIndex, announcedSourcePackets;
+            readTrailer(decoderPacketBuffer_[i], packetIndex, announcedSourcePackets);
 
-        /* Did we already use this parity packet? */
-        uint64_t mask = (uint64_t)1<<(packetIndex & 0x3F);
-        if(!(usedParityBitfield[packetIndex >> 6] & mask)) {
-            usedParityPacketIndex[usedParityIndex] = packetIndex;
-            usedParity[usedParityIndex] = i;
-            usedParityBitfield[packetIndex >> 6] |= mask;
-            usedParityIndex++;
+            bool local = packetIndex < numSourcePackets_ + localGroups;
+            if(local != (pass == 0) || decoderUsedParityRows_[packetIndex]) {
+                continue;
+            }
 
-            if(usedParityIndex >= parityPacketsNeeded) {
-                break;
+            getGeneratorRow(generatorRow, packetIndex, numSourcePackets_);
+
+            std::vector<Coefficient> row(parityPacketsNeeded);
+            for(unsigned int j=0; j<parityPacketsNeeded; j++) {
+                row[j] = generatorRow(0, decoderMissing_[j]);
             }
+
+            bool independent = (field_ == FIELD_GF65536)? independentRow<RSGF65536Number>(basis, std::move(row)) :
+                                                          independentRow<RSGF256Number>(basis, std::move(row));
+            if(!independent) {
+                continue;
+            }
+
+            usedParityPacketIndex.push_back(packetIndex);
+            decoderUsedParity_.push_back(i);
+            decoderUsedParityRows_[packetIndex] = true;
+
+            if(decoderUsedParity_.size() >= parityPacketsNeeded) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool CauchyFEC::impl::decoderStart() {
+    if(decoderWaitingFirstPacket_) {
+        return false;
+    }
+
+    decoderRangeReady_ = false;
+
+    /* Local repair runs first, as budgeted steps over the received parity */
+    if(localGroupSize_) {
+        decoderStage_ = DECODER_LOCAL_REPAIR;
+        decoderProgress_ = numSourcePackets_;
+        decoderLocalActive_ = false;
+        return true;
+    }
+
+    return decoderSetup();
+}
+
+bool CauchyFEC::impl::decoderSetup() {
+    decoderMissing_.clear();
+    decoderKnown_.clear();
+    for(unsigned int i=0; i<numSourcePackets_; i++) {
+        if(!decoderPacketBuffer_[i].size()) {
+            decoderMissing_.push_back(i);
+        } else {
+            decoderKnown_.push_back(i);
         }
     }
 
-    if(usedParityIndex < parityPacketsNeeded) {
+    /* How many parity packets will we use */
+    unsigned int parityPacketsNeeded = decoderMissing_.size();
+    if(!parityPacketsNeeded) {
+        return false;
+    }
+
+    if(parityPacketsNeeded > decoderPacketBuffer_.size() - numSourcePackets_) {
+        /* This is doomed to fail from the start */
+        return false;
+    }
+
+    std::vector<unsigned int> usedParityPacketIndex;
+    if(!decoderSelectParity(parityPacketsNeeded, usedParityPacketIndex)) {
         return false;
     }
 
     /* Do they all have the same length? */
-    unsigned int parityLength = decoderPacketBuffer_[usedParity[0]].size();
+    size_t parityLength = decoderPacketBuffer_[decoderUsedParity_[0]].size();
 
     for(unsigned int i=1; i<parityPacketsNeeded; i++) {
-        if(decoderPacketBuffer_[usedParity[i]].size() != parityLength) {
-            decoderStuck_ = true;
+        if(decoderPacketBuffer_[decoderUsedParity_[i]].size() != parityLength) {
+            decoderSetStuck(STUCK_PARITY_LENGTH_MISMATCH);
             return false;
         }
     }
 
     /* Strip metadata */
-    parityLength -= 2;
+    decoderParityLength_ = parityLength - trailerSize();
+
+    if(decoderParityLength_ < lengthSize() || alignLength(decoderParityLength_) != decoderParityLength_) {
+        decoderSetStuck(STUCK_INVALID_PARITY_LENGTH);
+        return false;
+    }
+
+    /* Known packets can't be longer than the parity describing them */
+    for(auto i: decoderKnown_) {
+        if(decoderPacketBuffer_[i].size() > decoderParityLength_ - lengthSize()) {
+            decoderSetStuck(STUCK_SOURCE_TOO_LONG);
+            return false;
+        }
+    }
 
     /* Build generator matrix for the desired packets */
-    Matrix<RSGF256Number> generatorRectangularMatrix(parityPacketsNeeded, numSourcePackets_);
-    Matrix<RSGF256Number> generatorSubMatrix(parityPacketsNeeded, parityPacketsNeeded);
+    decoderGenerator_ = Matrix<Coefficient>(parityPacketsNeeded, numSourcePackets_);
+    decoderGeneratorSub_ = Matrix<Coefficient>(parityPacketsNeeded, parityPacketsNeeded);
+    decoderInverse_ = Matrix<Coefficient>(parityPacketsNeeded, parityPacketsNeeded);
+    decoderInverse_.identity(1);
 
     for(unsigned int i=0; i<parityPacketsNeeded; i++) {
-        Matrix<RSGF256Number> generatorRow = generatorRectangularMatrix[i];
+        Matrix<Coefficient> generatorRow = decoderGenerator_[i];
         getGeneratorRow(generatorRow, usedParityPacketIndex[i], numSourcePackets_);
     }
 
-    /* Build parity message matrix */
-    Matrix<RSGF256Number> parityMessage(parityPacketsNeeded, parityLength);
+    /* The columns of the missing packets form a square generator */
     for(unsigned int i=0; i<parityPacketsNeeded; i++) {
-        auto& parity = decoderPacketBuffer_[usedParity[i]];
-        for(unsigned int j=0; j<parityLength; j++) {
-            parityMessage(i,j) = parity[j];
+        for(unsigned int j=0; j<parityPacketsNeeded; j++) {
+            decoderGeneratorSub_(j, i) = decoderGenerator_(j, decoderMissing_[i]);
         }
     }
 
-    /* Process known packets: if source packets are known we subtract them from the RHS
-     * and remove the columns from the generator matrix. We should get a square generator
-     * this way.
-     */
+    StatsTimer timer(*this, &Stats::nsMessageMatrix);
+    statsCount(&Stats::bytesAllocated, 2 * parityPacketsNeeded * decoderParityLength_);
+    statsCount(&Stats::parityConsumed, parityPacketsNeeded);
 
-    unsigned int generatorSubColumnIndex = 0;
-    for(unsigned int i=0; i<numSourcePackets_; i++) {
-        auto& goodPacket = decoderPacketBuffer_[i];
+    /* The parity is copied in by the DECODER_LOAD stage */
+    decoderParityMessage_.resize(parityPacketsNeeded);
+    decoderDecodedMessage_.resize(parityPacketsNeeded);
+    for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+        decoderParityMessage_[i].clear();
+        decoderParityMessage_[i].reserve(decoderParityLength_);
+        decoderDecodedMessage_[i].clear();
+        decoderDecodedMessage_[i].reserve(decoderParityLength_);
+    }
 
-        if(goodPacket.size()) {
-            /* Found, update parityMessage */
-            for(unsigned int j=0; j<parityPacketsNeeded; j++) {
-                for(unsigned int k=0; k<parityLength; k++) {
-                    RSGF256Number c = 0;
-                    if(k < goodPacket.size()) {
-                        c = goodPacket[k];
-                    } else if(k == parityLength - 2) {
-                        c = goodPacket.size() >> 8;
-                    } else if(k == parityLength - 1) {
-                        c = goodPacket.size() & 0xFF;
+    decoderStage_ = DECODER_LOAD;
+    decoderProgress_ = 0;
+    decoderProgressSource_ = 0;
+    decoderProgressOffset_ = 0;
+
+    return true;
+}
+
+void CauchyFEC::impl::decoderSetStuck(StuckReason reason) {
+    decoderStuck_ = true;
+    CAUCHYFEC_PROBE3(decoder_stuck, numSourcePackets_, reason, numSourcePackets_ - decoderOriginalPacketsReceived_);
+    statsCount(&Stats::stuckBlocks);
+    if(statsActive_) {
+        stats_.lastStuckReason = reason;
+    }
+}
+
+bool CauchyFEC::impl::decoderStep(size_t budget) {
+    if(decoderStuck_) {
+        return true;
+    }
+
+    if(decoderStage_ == DECODER_IDLE) {
+        if(!decoderStart()) {
+            return true;
+        }
+    }
+
+    while(budget) {
+        unsigned int parityPacketsNeeded = decoderMissing_.size();
+        size_t parityLength = decoderParityLength_;
+
+        switch(decoderStage_) {
+        case DECODER_LOCAL_REPAIR:
+            if(decoderProgress_ < decoderPacketBuffer_.size()) {
+                decoderLocalRepairStep(budget);
+                break;
+            }
+
+            if(!decoderSetup()) {
+                decoderStage_ = DECODER_IDLE;
+                return true;
+            }
+            break;
+
+        case DECODER_LOAD: {
+            /* Copy the used parity into the right hand side, one chunk of columns at a time */
+            StatsTimer timer(*this, &Stats::nsMessageMatrix);
+            if(decoderProgress_ == parityLength) {
+                /* The lengths of the known packets are subtracted right away */
+                for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+                    for(auto source: decoderKnown_) {
+                        mulAddLength(&decoderParityMessage_[i][parityLength - lengthSize()],
+                                     decoderPacketBuffer_[source].size(), decoderGenerator_(i, source));
                     }
+                }
 
-                    parityMessage(j, k) -= generatorRectangularMatrix(j, i) * c;
+                decoderStage_ = DECODER_INVERT;
+                decoderProgress_ = 0;
+                break;
+            }
+
+            size_t end = decoderProgress_ + std::min<size_t>(parityLength - decoderProgress_,
+                                                             std::min<size_t>(chunkSize(), std::max<size_t>(1, budget / parityPacketsNeeded)));
+            for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+                auto& parity = decoderPacketBuffer_[decoderUsedParity_[i]];
+                decoderParityMessage_[i].insert(decoderParityMessage_[i].end(), parity.begin() + decoderProgress_, parity.begin() + end);
+                decoderDecodedMessage_[i].resize(end);
+            }
+
+            budget -= std::min<size_t>(budget, (end - decoderProgress_) * parityPacketsNeeded);
+            decoderProgress_ = end;
+            break;
+        }
+
+        case DECODER_INVERT: {
+            /* Invert generator, one pivot at a time */
+            StatsTimer timer(*this, &Stats::nsInversion);
+            if(!decoderProgress_) {
+                CAUCHYFEC_PROBE1(inverse_start, parityPacketsNeeded);
+            }
+            if(!decoderMatrixInversePivot(decoderGeneratorSub_, decoderInverse_, decoderProgress_)) {
+                /* This should not happen, as the matrix is MDS */
+                CAUCHYFEC_PROBE2(inverse_end, parityPacketsNeeded, false);
+                decoderSetStuck(STUCK_SINGULAR_MATRIX);
+                decoderStage_ = DECODER_IDLE;
+                return true;
+            }
+
+            budget -= std::min<size_t>(budget, 2 * parityPacketsNeeded * parityPacketsNeeded);
+
+            if(++decoderProgress_ == parityPacketsNeeded) {
+                CAUCHYFEC_PROBE2(inverse_end, parityPacketsNeeded, true);
+                decoderStage_ = DECODER_SUBTRACT;
+                decoderProgress_ = 0;
+            }
+            break;
+        }
+
+        case DECODER_SUBTRACT: {
+            /* Process known packets: if source packets are known we subtract them from the RHS
+             * and remove the columns from the generator matrix. We should get a square generator
+             * this way. Only the real extent of each packet is processed, one chunk of columns
+             * at a time.
+             */
+            StatsTimer timer(*this, &Stats::nsMessageMatrix);
+            size_t dataLength = parityLength - lengthSize();
+            if(decoderProgress_ >= dataLength) {
+                decoderStage_ = DECODER_MULTIPLY;
+                decoderProgress_ = 0;
+
+                std::vector<Coefficient> coefficients;
+                for(unsigned int row=0; row<parityPacketsNeeded; row++) {
+                    for(unsigned int mIndex=0; mIndex<parityPacketsNeeded; mIndex++) {
+                        coefficients.push_back(decoderInverse_(row, mIndex));
+                    }
                 }
+                decoderJit_ = jitRoutine(coefficients, parityPacketsNeeded, parityPacketsNeeded, parityLength, DECODER_JIT_MIN_WORK);
+                break;
             }
-        } else {
-            /* Not found, calcluate it */
+
+            size_t chunkEnd = decoderProgress_ + std::min<size_t>(dataLength - decoderProgress_, chunkSize());
+
+            if(decoderProgressSource_ == decoderKnown_.size()) {
+                decoderProgress_ = chunkEnd;
+                decoderProgressSource_ = 0;
+                decoderProgressOffset_ = chunkEnd;
+                break;
+            }
+
+            unsigned int source = decoderKnown_[decoderProgressSource_];
+            auto& goodPacket = decoderPacketBuffer_[source];
+            size_t sourceEnd = std::min<size_t>(goodPacket.size(), chunkEnd);
+
+            if(decoderProgressOffset_ >= sourceEnd) {
+                decoderProgressSource_++;
+                decoderProgressOffset_ = decoderProgress_;
+                break;
+            }
+
+            size_t end = decoderProgressOffset_ + std::min<size_t>(sourceEnd - decoderProgressOffset_, alignChunk(budget / parityPacketsNeeded));
+
             for(unsigned int j=0; j<parityPacketsNeeded; j++) {
-                generatorSubMatrix(j, generatorSubColumnIndex) =
-                    generatorRectangularMatrix(j, i);
+                mulAddRegion(&decoderParityMessage_[j][decoderProgressOffset_], &goodPacket[decoderProgressOffset_],
+                             decoderGenerator_(j, source), end - decoderProgressOffset_);
             }
-            generatorSubColumnIndex++;
+
+            budget -= std::min<size_t>(budget, (end - decoderProgressOffset_) * parityPacketsNeeded);
+            decoderProgressOffset_ = end;
+            break;
         }
-    }
 
-    /* Invert generator and decode */
-    if(!decoderMatrixInverse(generatorSubMatrix)) {
-        /* This should not happen, as the matrix is MDS */
-        decoderStuck_ = true;
-        return false;
-    }
+        case DECODER_MULTIPLY: {
+            StatsTimer timer(*this, &Stats::nsMultiply);
+            size_t columnCost = parityPacketsNeeded * parityPacketsNeeded;
+            size_t end = decoderProgress_ + std::min<size_t>(parityLength - decoderProgress_,
+                                                             std::min<size_t>(chunkSize(), alignChunk(budget / columnCost)));
 
-    auto decodedMessage = generatorSubMatrix * parityMessage;
+            size_t start = decoderProgress_;
+            if(decoderJit_) {
+                size_t length = (end - start) & ~(GFJit::BLOCK_SIZE - 1);
+                std::vector<uint8_t*> dst(parityPacketsNeeded);
+                std::vector<const uint8_t*> src(parityPacketsNeeded);
+                for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+                    dst[i] = &decoderDecodedMessage_[i][start];
+                    src[i] = &decoderParityMessage_[i][start];
+                }
+                (*decoderJit_)(dst.data(), src.data(), length);
+                start += length;
+            }
 
-    unsigned int decodedIndex = 0;
-    for(unsigned int i=0; i<numSourcePackets_; i++) {
-        if(!decoderPacketBuffer_[i].size()) {
-            unsigned int packetSize = (decodedMessage(decodedIndex, parityLength-2) << 8) |
-                                      (decodedMessage(decodedIndex, parityLength-1));
+            for(unsigned int row=0; row<parityPacketsNeeded; row++) {
+                for(unsigned int mIndex=0; mIndex<parityPacketsNeeded; mIndex++) {
+                    mulAddRegion(&decoderDecodedMessage_[row][start], &decoderParityMessage_[mIndex][start],
+                                 decoderInverse_(row, mIndex), end - start);
+                }
+            }
 
+            budget -= std::min<size_t>(budget, (end - decoderProgress_) * columnCost);
+            decoderProgress_ = end;
 
-            if(packetSize > parityLength - 2) {
-                /* What? This can't be decoded... */
-                decoderStuck_ = true;
-                return false;
+            if(decoderProgress_ == parityLength) {
+                decoderStage_ = DECODER_WRITEBACK;
             }
+            break;
+        }
 
-            auto& decodedPacket = decoderPacketBuffer_[i];
-            decodedPacket.resize(packetSize);
-            for(unsigned int j=0; j<packetSize; j++) {
-                decodedPacket[j] = decodedMessage(decodedIndex, j);
+        case DECODER_WRITEBACK:
+            decoderStage_ = DECODER_IDLE;
+            decoderJit_.reset();
+
+            for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+                size_t packetSize = readLength(&decoderDecodedMessage_[i][parityLength - lengthSize()]);
+
+                if(packetSize > parityLength - lengthSize()) {
+                    /* What? This can't be decoded... */
+                    decoderSetStuck(STUCK_INVALID_DECODED_LENGTH);
+                    return true;
+                }
             }
 
-            decodedIndex++;
+            for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+                auto& decodedPacket = decoderPacketBuffer_[decoderMissing_[i]];
+
+                /* The packet may have arrived while we were decoding */
+                if(decodedPacket.size()) {
+                    continue;
+                }
+
+                size_t packetSize = readLength(&decoderDecodedMessage_[i][parityLength - lengthSize()]);
+
+                decodedPacket = std::move(decoderDecodedMessage_[i]);
+                decodedPacket.resize(packetSize);
+            }
+
+            return true;
+
+        case DECODER_IDLE:
+            return true;
         }
     }
 
-    return true;
+    return false;
+}
+
+bool CauchyFEC::impl::decoderRun() {
+    CAUCHYFEC_PROBE3(decode_start, numSourcePackets_, numSourcePackets_ - decoderOriginalPacketsReceived_,
+                     decoderPacketBuffer_.size() - numSourcePackets_);
+
+    /*
+     * With an unlimited budget decoderStep() only returns once it can't do more, also when it
+     * could not start. Decoding worked if no source packet is missing afterwards.
+     */
+    bool done = decoderStep(std::numeric_limits<size_t>::max()) && !decoderStuck_ && !decoderWaitingFirstPacket_;
+    for(unsigned int i = 0; done && i < numSourcePackets_; i++) {
+        done = decoderPacketBuffer_[i].size() != 0;
+    }
+
+    CAUCHYFEC_PROBE3(decode_end, numSourcePackets_, decoderMissing_.size(), done);
+
+    return done;
 }
 
 unsigned int CauchyFEC::impl::decoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
@@ -295,9 +820,11 @@ unsigned int CauchyFEC::impl::decoderRequestPackets(std::vector<std::vector<uint
                 packetValid = true;
             } else {
                 /* This source packet is missing. We need to attempt decoding... */
-                if(decoderRun()) {
+                if(decoderRun() && decoderPacketBuffer_[decoderPacketsReturned_].size()) {
                     packetValid = true;
                 }
+                statsCount(packetValid? &Stats::decodeSuccesses : &Stats::decodeFailures);
+                statsCount(&Stats::decodeAttempts);
             }
         }
 
@@ -314,3 +841,334 @@ unsigned int CauchyFEC::impl::decoderRequestPackets(std::vector<std::vector<uint
 
 
 
+
+bool CauchyFEC::impl::decoderRangePrepare() {
+    if(decoderWaitingFirstPacket_ || decoderStuck_) {
+        return false;
+    }
+
+    /* A cooperative decode that is in progress is finished first */
+    if(decoderStage_ != DECODER_IDLE && !decoderRun()) {
+        return false;
+    }
+
+    if(decoderRangeReady_) {
+        return true;
+    }
+
+    decoderMissing_.clear();
+    decoderKnown_.clear();
+    for(unsigned int i=0; i<numSourcePackets_; i++) {
+        if(!decoderPacketBuffer_[i].size()) {
+            decoderMissing_.push_back(i);
+        } else {
+            decoderKnown_.push_back(i);
+        }
+    }
+
+    unsigned int parityPacketsNeeded = decoderMissing_.size();
+    if(!parityPacketsNeeded) {
+        decoderRangeReady_ = true;
+        return true;
+    }
+
+    std::vector<unsigned int> usedParityPacketIndex;
+    if(parityPacketsNeeded > decoderPacketBuffer_.size() - numSourcePackets_ ||
+       !decoderSelectParity(parityPacketsNeeded, usedParityPacketIndex)) {
+        return false;
+    }
+
+    size_t parityLength = decoderPacketBuffer_[decoderUsedParity_[0]].size();
+    for(unsigned int i=1; i<parityPacketsNeeded; i++) {
+        if(decoderPacketBuffer_[decoderUsedParity_[i]].size() != parityLength) {
+            decoderSetStuck(STUCK_PARITY_LENGTH_MISMATCH);
+            return false;
+        }
+    }
+
+    decoderParityLength_ = parityLength - trailerSize();
+    if(decoderParityLength_ < lengthSize() || alignLength(decoderParityLength_) != decoderParityLength_) {
+        decoderSetStuck(STUCK_INVALID_PARITY_LENGTH);
+        return false;
+    }
+
+    for(auto i: decoderKnown_) {
+        if(decoderPacketBuffer_[i].size() > decoderParityLength_ - lengthSize()) {
+            decoderSetStuck(STUCK_SOURCE_TOO_LONG);
+            return false;
+        }
+    }
+
+    /* Only the coefficients are calculated here, nothing depends on the packet size */
+    Matrix<Coefficient> generator(parityPacketsNeeded, numSourcePackets_);
+    Matrix<Coefficient> generatorSub(parityPacketsNeeded, parityPacketsNeeded);
+
+    for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+        Matrix<Coefficient> generatorRow = generator[i];
+        getGeneratorRow(generatorRow, usedParityPacketIndex[i], numSourcePackets_);
+    }
+
+    for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+        for(unsigned int j=0; j<parityPacketsNeeded; j++) {
+            generatorSub(j, i) = generator(j, decoderMissing_[i]);
+        }
+    }
+
+    bool inverted;
+    {
+        StatsTimer timer(*this, &Stats::nsInversion);
+        inverted = decoderMatrixInverse(generatorSub);
+    }
+    if(!inverted) {
+        decoderSetStuck(STUCK_SINGULAR_MATRIX);
+        return false;
+    }
+
+    decoderRangeCoefficients_ = Matrix<Coefficient>(parityPacketsNeeded, parityPacketsNeeded + decoderKnown_.size());
+    if(field_ == FIELD_GF65536) {
+        rangeCoefficients<RSGF65536Number>(generatorSub, generator, decoderKnown_, decoderRangeCoefficients_);
+    } else {
+        rangeCoefficients<RSGF256Number>(generatorSub, generator, decoderKnown_, decoderRangeCoefficients_);
+    }
+
+    decoderRangeReady_ = true;
+
+    return true;
+}
+
+void CauchyFEC::impl::decoderRangeRow(unsigned int missing, size_t offset, size_t length, std::vector<uint8_t>& output) {
+    /* Bytes [offset, offset + length) of the padded message, offset is element aligned */
+    StatsTimer timer(*this, &Stats::nsMultiply);
+    statsCount(&Stats::bytesAllocated, length);
+
+    unsigned int parityPacketsNeeded = decoderMissing_.size();
+    output.assign(length, 0);
+
+    for(unsigned int i=0; i<parityPacketsNeeded; i++) {
+        mulAddRegion(output.data(), &decoderPacketBuffer_[decoderUsedParity_[i]][offset],
+                     decoderRangeCoefficients_(missing, i), length);
+    }
+
+    /* Known packets only contribute over their real length, local parity only reads its group */
+    for(unsigned int i=0; i<decoderKnown_.size(); i++) {
+        auto& goodPacket = decoderPacketBuffer_[decoderKnown_[i]];
+        Coefficient c = decoderRangeCoefficients_(missing, parityPacketsNeeded + i);
+
+        if(c && goodPacket.size() > offset) {
+            mulAddRegion(output.data(), &goodPacket[offset], c, std::min(goodPacket.size() - offset, length));
+        }
+    }
+}
+
+bool CauchyFEC::impl::decoderPacketLength(unsigned int index, size_t& length) {
+    if(decoderWaitingFirstPacket_ || index >= numSourcePackets_) {
+        return false;
+    }
+
+    if(decoderPacketBuffer_[index].size()) {
+        length = decoderPacketBuffer_[index].size();
+        return true;
+    }
+
+    if(!decoderRangePrepare()) {
+        return false;
+    }
+
+    /* The length is stored behind the padded data */
+    unsigned int missing = std::find(decoderMissing_.begin(), decoderMissing_.end(), index) - decoderMissing_.begin();
+    size_t dataLength = decoderParityLength_ - lengthSize();
+
+    std::vector<uint8_t> lengthBytes;
+    decoderRangeRow(missing, dataLength, lengthSize(), lengthBytes);
+
+    for(unsigned int i=0; i<decoderKnown_.size(); i++) {
+        mulAddLength(lengthBytes.data(), decoderPacketBuffer_[decoderKnown_[i]].size(),
+                     decoderRangeCoefficients_(missing, decoderMissing_.size() + i));
+    }
+
+    length = readLength(lengthBytes.data());
+
+    return length && length <= dataLength;
+}
+
+bool CauchyFEC::impl::decoderDecodeRange(unsigned int index, size_t offset, size_t length, std::vector<uint8_t>& output) {
+    size_t packetSize;
+    if(!decoderPacketLength(index, packetSize)) {
+        return false;
+    }
+
+    output.clear();
+    if(offset >= packetSize) {
+        return true;
+    }
+
+    size_t end = offset + std::min(length, packetSize - offset);
+    auto& packet = decoderPacketBuffer_[index];
+
+    if(packet.size()) {
+        output.assign(packet.begin() + offset, packet.begin() + end);
+        return true;
+    }
+
+    /* Regions start on an element boundary, the padding up to the length is zero */
+    size_t alignedOffset = (field_ == FIELD_GF65536)? (offset & ~(size_t)1) : offset;
+    size_t alignedEnd = alignLength(end);
+    unsigned int missing = std::find(decoderMissing_.begin(), decoderMissing_.end(), index) - decoderMissing_.begin();
+
+    decoderRangeRow(missing, alignedOffset, alignedEnd - alignedOffset, output);
+
+    output.erase(output.begin(), output.begin() + (offset - alignedOffset));
+    output.resize(end - offset);
+
+    return true;
+}
+
+bool CauchyFEC::impl::decodeBlock(unsigned int numberOfSourcePackets, const uint8_t* const* sources, size_t* lengths,
+                                  unsigned int numParity, const unsigned int* parityRows, const uint8_t* const* parity,
+                                  size_t parityLength, uint8_t* const* recovered) {
+    if(!numberOfSourcePackets || numberOfSourcePackets > fieldSize()) {
+        throw std::runtime_error("Invalid number of source packets");
+    }
+
+    if(parityLength < lengthSize() || alignLength(parityLength) != parityLength) {
+        throw std::runtime_error("Invalid parity length");
+    }
+
+    size_t dataLength = parityLength - lengthSize();
+    std::vector<unsigned int> missing, known;
+    for(unsigned int i = 0; i < numberOfSourcePackets; i++) {
+        if(sources[i]) {
+            if(lengths[i] > dataLength) {
+                return false;
+            }
+            known.push_back(i);
+        } else {
+            missing.push_back(i);
+        }
+    }
+
+    if(missing.empty()) {
+        return true;
+    }
+
+    /* Parity rows that add nothing for the missing packets are skipped, as in decoderSelectParity() */
+    Matrix<Coefficient> generatorRow(1, numberOfSourcePackets);
+    Matrix<Coefficient> generator(missing.size(), numberOfSourcePackets);
+    std::vector<std::vector<Coefficient>> basis;
+    std::vector<unsigned int> used;
+
+    for(unsigned int j = 0; j < numParity && used.size() < missing.size(); j++) {
+        if(parityRows[j] < numberOfSourcePackets || parityRows[j] >= fieldSize()) {
+            continue;
+        }
+
+        getGeneratorRow(generatorRow, parityRows[j], numberOfSourcePackets);
+
+        std::vector<Coefficient> row(missing.size());
+        for(unsigned int i = 0; i < missing.size(); i++) {
+            row[i] = generatorRow(0, missing[i]);
+        }
+
+        bool independent = (field_ == FIELD_GF65536)? independentRow<RSGF65536Number>(basis, std::move(row)) :
+                                                      independentRow<RSGF256Number>(basis, std::move(row));
+        if(independent) {
+            for(unsigned int col = 0; col < numberOfSourcePackets; col++) {
+                generator(used.size(), col) = generatorRow(0, col);
+            }
+            used.push_back(j);
+        }
+    }
+
+    if(used.size() < missing.size()) {
+        return false;
+    }
+
+    Matrix<Coefficient> inverse(missing.size(), missing.size());
+    for(unsigned int i = 0; i < missing.size(); i++) {
+        for(unsigned int j = 0; j < missing.size(); j++) {
+            inverse(j, i) = generator(j, missing[i]);
+        }
+    }
+
+    if(!decoderMatrixInverse(inverse)) {
+        return false;
+    }
+
+    Matrix<Coefficient> coefficients(missing.size(), missing.size() + known.size());
+    if(field_ == FIELD_GF65536) {
+        rangeCoefficients<RSGF65536Number>(inverse, generator, known, coefficients);
+    } else {
+        rangeCoefficients<RSGF256Number>(inverse, generator, known, coefficients);
+    }
+
+    /* Every missing packet is a combination of parity and known packets, applied chunk by chunk */
+    for(unsigned int i = 0; i < missing.size(); i++) {
+        std::fill(recovered[missing[i]], recovered[missing[i]] + parityLength, 0);
+
+        for(unsigned int k = 0; k < known.size(); k++) {
+            mulAddLength(&recovered[missing[i]][dataLength], lengths[known[k]], coefficients(i, missing.size() + k));
+        }
+    }
+
+    /* Columns covered by the parity and every known packet are done by one compiled routine */
+    size_t shortest = parityLength;
+    std::vector<Coefficient> dense;
+    for(unsigned int i = 0; i < missing.size(); i++) {
+        for(unsigned int j = 0; j < missing.size() + known.size(); j++) {
+            dense.push_back(coefficients(i, j));
+        }
+    }
+    for(auto k: known) {
+        shortest = std::min(shortest, lengths[k]);
+    }
+    auto routine = jitRoutine(dense, missing.size(), missing.size() + known.size(), shortest, DECODER_JIT_MIN_WORK);
+
+    for(size_t offset = 0; offset < parityLength; offset += chunkSize()) {
+        size_t end = std::min<size_t>(parityLength, offset + chunkSize());
+        size_t start = offset;
+
+        if(routine && offset < shortest) {
+            size_t length = (std::min(end, shortest) - offset) & ~(GFJit::BLOCK_SIZE - 1);
+            std::vector<uint8_t*> dst;
+            std::vector<const uint8_t*> src;
+            for(auto i: missing) {
+                dst.push_back(recovered[i] + offset);
+            }
+            for(auto j: used) {
+                src.push_back(parity[j] + offset);
+            }
+            for(auto k: known) {
+                src.push_back(sources[k] + offset);
+            }
+            (*routine)(dst.data(), src.data(), length);
+            start += length;
+        }
+
+        for(unsigned int j = 0; j < used.size(); j++) {
+            for(unsigned int i = 0; i < missing.size(); i++) {
+                mulAddRegion(&recovered[missing[i]][start], &parity[used[j]][start], coefficients(i, j), end - start);
+            }
+        }
+
+        for(unsigned int k = 0; k < known.size(); k++) {
+            size_t sourceEnd = std::min<size_t>(lengths[known[k]], end);
+            if(sourceEnd <= start) {
+                continue;
+            }
+
+            for(unsigned int i = 0; i < missing.size(); i++) {
+                mulAddRegion(&recovered[missing[i]][start], &sources[known[k]][start],
+                             coefficients(i, missing.size() + k), sourceEnd - start);
+            }
+        }
+    }
+
+    for(unsigned int i = 0; i < missing.size(); i++) {
+        lengths[missing[i]] = readLength(&recovered[missing[i]][dataLength]);
+        if(lengths[missing[i]] > dataLength) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -28,21 +28,33 @@
 #include "CauchyFECImpl.h"
 #include "Matrix.h"
 #include "GF256Number.h"
+#include "GF65536Number.h"
 #include <stdexcept>
+#include <limits>
+#include <algorithm>
+
+/* The generator repeats from block to block, so its routine is compiled once and reused */
+static const size_t ENCODER_JIT_MIN_WORK = 32 * 1024;
 
 void CauchyFEC::impl::encoderReset(unsigned int numSourcePackets) {
     encoderSourcePackets_.clear();
+    encoderParityJobs_.clear();
     encoderGeneratorRowIndex_ = 0;
     encoderReadingSourcePackets_ = true;
+    encoderPassActive_ = false;
     numSourcePackets_ = numSourcePackets;
     encoderLongestSourcePacket_ = 0;
 
     if(!numSourcePackets_) {
         throw std::runtime_error("At least one source packet is needed");
     }
+
+    if(numSourcePackets_ > fieldSize()) {
+        throw std::runtime_error("Too many source packets for this field");
+    }
 }
 
-void CauchyFEC::impl::encoderOperatorLL(const std::vector<uint8_t>& sourcePacket) {
+void CauchyFEC::impl::encoderCheckPacket(const std::vector<uint8_t>& sourcePacket) {
     if(!sourcePacket.size()) {
         throw std::runtime_error("size() == 0 packets are not supported");
     }
@@ -55,11 +67,28 @@ void CauchyFEC::impl::encoderOperatorLL(const std::vector<uint8_t>& sourcePacket
         throw std::runtime_error("Encoder is full");
     }
 
+    if(sourcePacket.size() > maxPacketSize()) {
+        throw std::runtime_error("Packet too large, large symbols are needed");
+    }
+
     if(sourcePacket.size() > encoderLongestSourcePacket_) {
         encoderLongestSourcePacket_ = sourcePacket.size();
     }
 
+    CAUCHYFEC_PROBE3(encoder_packet, numSourcePackets_, encoderSourcePackets_.size(), sourcePacket.size());
+}
+
+void CauchyFEC::impl::encoderOperatorLL(const std::vector<uint8_t>& sourcePacket) {
+    encoderCheckPacket(sourcePacket);
     encoderSourcePackets_.push_back(sourcePacket);
+    statsCount(&Stats::packetsIn);
+    statsCount(&Stats::bytesAllocated, sourcePacket.size());
+}
+
+void CauchyFEC::impl::encoderOperatorLL(std::vector<uint8_t>&& sourcePacket) {
+    encoderCheckPacket(sourcePacket);
+    encoderSourcePackets_.push_back(std::move(sourcePacket));
+    statsCount(&Stats::packetsIn);
 }
 
 void CauchyFEC::impl::encoderOperatorLL(const std::vector<std::vector<uint8_t>>& sourcePackets) {
@@ -69,30 +98,211 @@ void CauchyFEC::impl::encoderOperatorLL(const std::vector<std::vector<uint8_t>>&
     }
 }
 
-void CauchyFEC::impl::encoderBuildMessageMatrix() {
-    unsigned int index = 0;
-    encoderMessageMatrix_ = Matrix<RSGF256Number>(numSourcePackets_, encoderLongestSourcePacket_ + 2);
+void CauchyFEC::impl::encoderFlush() {
+    if(encoderSourcePackets_.size() == numSourcePackets_) {
+        return;
+    }
 
-    for(auto& sourcePacket: encoderSourcePackets_) {
-        for(unsigned int i=0; i<sourcePacket.size(); i++) {
-            encoderMessageMatrix_(index, i) = sourcePacket[i];
-        }
+    if(!encoderSourcePackets_.size()) {
+        throw std::runtime_error("At least one source packet is needed");
+    }
 
-        /* Append with original length */
-        encoderMessageMatrix_(index, encoderLongestSourcePacket_) = sourcePacket.size() >> 8;
-        encoderMessageMatrix_(index, encoderLongestSourcePacket_ + 1) = sourcePacket.size() & 0xFF;
+    /* Close the block: the code is shortened to the packets loaded so far */
+    unsigned int scheduledPackets = encoderParityJobs_.size();
+    encoderParityJobs_.clear();
 
-        index ++;
-    }
+    numSourcePackets_ = encoderSourcePackets_.size();
+    encoderSchedulePackets(scheduledPackets);
 }
 
 void CauchyFEC::impl::encoderIncrementGenerator() {
     encoderGeneratorRowIndex_++;
-    if(encoderGeneratorRowIndex_ > 256) {
+    if(encoderGeneratorRowIndex_ > fieldSize()) {
         throw std::runtime_error("Can't generate more packets");
     }
 }
 
+void CauchyFEC::impl::encoderSchedulePackets(unsigned int numPackets) {
+    /* Parity jobs always continue where the previous one stopped */
+    unsigned int row = std::max(encoderGeneratorRowIndex_, numSourcePackets_);
+    row += encoderParityJobs_.size();
+
+    for(unsigned int i=0; i<numPackets; i++) {
+        if(row + i >= fieldSize()) {
+            throw std::runtime_error("Can't generate more packets");
+        }
+
+        EncoderParityJob job;
+        job.row = row + i;
+        job.inPass = false;
+        job.done = false;
+        encoderParityJobs_.push_back(std::move(job));
+    }
+}
+
+bool CauchyFEC::impl::encoderStartPass() {
+    /* Once we calculate parity no more source packets can be read */
+    encoderReadingSourcePackets_ = false;
+
+    size_t paddedLength = alignLength(encoderLongestSourcePacket_);
+    encoderPassJobs_ = 0;
+
+    for(auto& job: encoderParityJobs_) {
+        if(job.done) {
+            continue;
+        }
+
+        job.generatorRow = Matrix<Coefficient>(1, numSourcePackets_);
+        getGeneratorRow(job.generatorRow, job.row, numSourcePackets_);
+
+        StatsTimer timer(*this, &Stats::nsMessageMatrix);
+        statsCount(&Stats::bytesAllocated, paddedLength + lengthSize() + trailerSize());
+        job.packet.assign(paddedLength + lengthSize() + trailerSize(), 0);
+        writeTrailer(&job.packet[paddedLength + lengthSize()], job.row, numSourcePackets_);
+
+        /* The lengths are stored after the padded data */
+        for(unsigned int source = 0; source < numSourcePackets_; source++) {
+            mulAddLength(&job.packet[paddedLength], encoderSourcePackets_[source].size(), job.generatorRow(0, source));
+        }
+
+        job.inPass = true;
+        encoderPassJobs_++;
+    }
+
+    if(!encoderPassJobs_) {
+        return false;
+    }
+
+    CAUCHYFEC_PROBE3(encode_pass_start, numSourcePackets_, encoderPassJobs_, paddedLength);
+    encoderPassActive_ = true;
+    encoderPassOffset_ = 0;
+    encoderPassSource_ = 0;
+    encoderPassSourceOffset_ = 0;
+
+    /* The columns that every source covers can be done by a routine compiled for this pass */
+    encoderPassShortest_ = encoderLongestSourcePacket_;
+    for(auto& sourcePacket: encoderSourcePackets_) {
+        encoderPassShortest_ = std::min(encoderPassShortest_, sourcePacket.size());
+    }
+
+    std::vector<Coefficient> coefficients;
+    for(auto& job: encoderParityJobs_) {
+        if(job.inPass) {
+            for(unsigned int source = 0; source < numSourcePackets_; source++) {
+                coefficients.push_back(job.generatorRow(0, source));
+            }
+        }
+    }
+    encoderPassJit_ = jitRoutine(coefficients, encoderPassJobs_, numSourcePackets_, encoderPassShortest_, ENCODER_JIT_MIN_WORK);
+
+    return true;
+}
+
+bool CauchyFEC::impl::encoderRunPass(size_t& budget) {
+    /*
+     * All parity packets of a pass are calculated together, one chunk of columns at a time.
+     * Every source is read once per pass and the working set stays bounded by the chunk size.
+     * Sources only contribute over their real length, the implicit zero padding is skipped.
+     */
+    StatsTimer timer(*this, &Stats::nsMultiply);
+
+    while(encoderPassOffset_ < encoderLongestSourcePacket_) {
+        size_t chunkEnd = encoderPassOffset_ + std::min<size_t>(encoderLongestSourcePacket_ - encoderPassOffset_, chunkSize());
+
+        /* At the start of a chunk, columns covered by every source are done in one go */
+        if(encoderPassJit_ && !encoderPassSource_ && encoderPassSourceOffset_ == encoderPassOffset_ &&
+           encoderPassOffset_ < encoderPassShortest_) {
+            size_t cost = (size_t)numSourcePackets_ * encoderPassJobs_;
+            size_t length = std::min<size_t>(std::min(chunkEnd, encoderPassShortest_) - encoderPassOffset_, budget / cost);
+            length &= ~(GFJit::BLOCK_SIZE - 1);
+
+            if(length) {
+                std::vector<uint8_t*> dst;
+                std::vector<const uint8_t*> src;
+                for(auto& job: encoderParityJobs_) {
+                    if(job.inPass) {
+                        dst.push_back(&job.packet[encoderPassOffset_]);
+                    }
+                }
+                for(auto& sourcePacket: encoderSourcePackets_) {
+                    src.push_back(&sourcePacket[encoderPassOffset_]);
+                }
+                (*encoderPassJit_)(dst.data(), src.data(), length);
+
+                budget -= length * cost;
+                encoderPassOffset_ += length;
+                encoderPassSourceOffset_ = encoderPassOffset_;
+                continue;
+            }
+        }
+
+        while(encoderPassSource_ < numSourcePackets_) {
+            auto& sourcePacket = encoderSourcePackets_[encoderPassSource_];
+            size_t sourceEnd = std::min<size_t>(sourcePacket.size(), chunkEnd);
+
+            if(encoderPassSourceOffset_ >= sourceEnd) {
+                encoderPassSource_++;
+                encoderPassSourceOffset_ = encoderPassOffset_;
+                continue;
+            }
+
+            if(!budget) {
+                return false;
+            }
+
+            size_t end = encoderPassSourceOffset_ + std::min<size_t>(sourceEnd - encoderPassSourceOffset_,
+                                                                      alignChunk(budget / encoderPassJobs_));
+
+            for(auto& job: encoderParityJobs_) {
+                if(job.inPass) {
+                    mulAddRegion(&job.packet[encoderPassSourceOffset_], &sourcePacket[encoderPassSourceOffset_],
+                                 job.generatorRow(0, encoderPassSource_), end - encoderPassSourceOffset_);
+                }
+            }
+
+            budget -= std::min<size_t>(budget, (end - encoderPassSourceOffset_) * encoderPassJobs_);
+            encoderPassSourceOffset_ = end;
+        }
+
+        encoderPassOffset_ = chunkEnd;
+        encoderPassSource_ = 0;
+        encoderPassSourceOffset_ = chunkEnd;
+    }
+
+    for(auto& job: encoderParityJobs_) {
+        if(job.inPass) {
+            job.inPass = false;
+            job.done = true;
+        }
+    }
+    encoderPassActive_ = false;
+    encoderPassJit_.reset();
+    CAUCHYFEC_PROBE3(encode_pass_end, numSourcePackets_, encoderPassJobs_, encoderLongestSourcePacket_);
+
+    return true;
+}
+
+bool CauchyFEC::impl::encoderStep(size_t budget) {
+    if(encoderParityJobs_.empty()) {
+        return true;
+    }
+
+    /* Parity needs the complete block */
+    if(encoderSourcePackets_.size() < numSourcePackets_) {
+        return true;
+    }
+
+    while(true) {
+        if(!encoderPassActive_ && !encoderStartPass()) {
+            return true;
+        }
+
+        if(!encoderRunPass(budget)) {
+            return false;
+        }
+    }
+}
+
 unsigned int CauchyFEC::impl::encoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
     /* First packets are not encoded */
     unsigned int count = 0;
@@ -106,13 +316,11 @@ unsigned int CauchyFEC::impl::encoderRequestPackets(std::vector<std::vector<uint
 
             std::vector<uint8_t>& sourcePacket = encoderSourcePackets_[encoderGeneratorRowIndex_];
             std::vector<uint8_t> outputPacket;
-            outputPacket.reserve(2 + sourcePacket.size());
-
-            outputPacket.insert (outputPacket.begin(),
-                                 sourcePacket.begin(),sourcePacket.end());
+            outputPacket.resize(sourcePacket.size() + trailerSize());
+            statsCount(&Stats::bytesAllocated, outputPacket.size());
 
-            outputPacket.push_back(encoderGeneratorRowIndex_);
-            outputPacket.push_back(numSourcePackets_ - 1);
+            std::copy(sourcePacket.begin(), sourcePacket.end(), outputPacket.begin());
+            writeTrailer(&outputPacket[sourcePacket.size()], encoderGeneratorRowIndex_, numSourcePackets_);
 
             packets.push_back(std::move(outputPacket));
             encoderIncrementGenerator();
@@ -126,38 +334,196 @@ unsigned int CauchyFEC::impl::encoderRequestPackets(std::vector<std::vector<uint
     }
 
     unsigned int numToGenerate = numPackets - count;
+    statsCount(&Stats::parityGenerated, numToGenerate);
 
-    /* Once we build the message matrix no more source packets can be read */
-    if(encoderReadingSourcePackets_) {
-        encoderBuildMessageMatrix();
-        encoderReadingSourcePackets_ = false;
+    /* Parity packets that were not scheduled (or not finished) are calculated now */
+    if(encoderParityJobs_.size() < numToGenerate) {
+        encoderSchedulePackets(numToGenerate - encoderParityJobs_.size());
     }
 
-    unsigned int generatorRowIndexAtStart = encoderGeneratorRowIndex_;
+    size_t budget = std::numeric_limits<size_t>::max();
+
+    while(!encoderParityJobs_[numToGenerate - 1].done) {
+        if(!encoderPassActive_) {
+            encoderStartPass();
+        }
+        encoderRunPass(budget);
+    }
 
-    Matrix<RSGF256Number> generatorSubMatrix(numToGenerate, numSourcePackets_);
     for(unsigned int i=0; i<numToGenerate; i++) {
-        Matrix<RSGF256Number> generatorRow = generatorSubMatrix[i];
-        getGeneratorRow(generatorRow, encoderGeneratorRowIndex_, numSourcePackets_);
+        EncoderParityJob& job = encoderParityJobs_.front();
+
+        CAUCHYFEC_PROBE3(parity_emit, numSourcePackets_, job.row, job.packet.size());
+        packets.push_back(std::move(job.packet));
+        encoderParityJobs_.pop_front();
         encoderIncrementGenerator();
     }
 
-    auto encodedMessage = generatorSubMatrix * encoderMessageMatrix_;
+    return numPackets;
+}
+
+void CauchyFEC::impl::encoderApplyDelta(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index, size_t offset,
+                                        const uint8_t* delta, size_t length, size_t oldLength, size_t newLength) {
+    /* Regions start and end on element boundaries, the padding of the parity is zero */
+    size_t alignedOffset = (field_ == FIELD_GF65536)? (offset & ~(size_t)1) : offset;
+    size_t alignedEnd = alignLength(offset + length);
+
+    std::vector<uint8_t> alignedDelta;
+    if(alignedOffset != offset || alignedEnd != offset + length) {
+        alignedDelta.assign(alignedEnd - alignedOffset, 0);
+        std::copy(delta, delta + length, alignedDelta.begin() + (offset - alignedOffset));
+        delta = alignedDelta.data();
+    }
+
+    Matrix<Coefficient> generatorRow;
+
+    for(auto& parity: parityPackets) {
+        if(parity.size() <= trailerSize()) {
+            throw std::runtime_error("Not a parity packet");
+        }
+
+        unsigned int row, sourcePackets;
+        readTrailer(parity, row, sourcePackets);
 
-    for(unsigned int i=0; i<encodedMessage.rows(); i++) {
-        std::vector<uint8_t> parityPacket;
-        parityPacket.resize(2 + encodedMessage.columns());
+        Generator generator;
+        if(!readGenerator(parity, generator)) {
+            throw std::runtime_error("Unknown generator");
+        }
+
+        if(row < sourcePackets) {
+            throw std::runtime_error("Not a parity packet");
+        }
 
-        for(unsigned int j=0; j<encodedMessage.columns(); j++) {
-            parityPacket[j] = encodedMessage(i, j);
+        if(index >= sourcePackets) {
+            throw std::runtime_error("Source packet index out of range");
         }
 
-        parityPacket[encodedMessage.columns()] = generatorRowIndexAtStart + i;
-        parityPacket[encodedMessage.columns() + 1] = numSourcePackets_ - 1;
+        size_t parityLength = parity.size() - trailerSize();
+        if(parityLength < lengthSize() || alignedEnd > parityLength - lengthSize() ||
+           std::max(oldLength, newLength) > parityLength - lengthSize()) {
+            throw std::runtime_error("Packet does not fit in the parity");
+        }
+
+        generatorRow = Matrix<Coefficient>(1, sourcePackets);
+        getGeneratorRow(generatorRow, row, sourcePackets, generator);
+
+        Coefficient c = generatorRow(0, index);
+        if(!c) {
+            continue;
+        }
 
-        packets.push_back(std::move(parityPacket));
+        if(alignedEnd > alignedOffset) {
+            mulAddRegion(&parity[alignedOffset], delta, c, alignedEnd - alignedOffset);
+        }
+
+        if(oldLength != newLength) {
+            mulAddLength(&parity[parityLength - lengthSize()], oldLength, c);
+            mulAddLength(&parity[parityLength - lengthSize()], newLength, c);
+        }
+    }
+}
+
+void CauchyFEC::impl::updateParity(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index,
+                                   const std::vector<uint8_t>& oldPacket, const std::vector<uint8_t>& newPacket) {
+    if(!oldPacket.size() || !newPacket.size()) {
+        throw std::runtime_error("size() == 0 packets are not supported");
     }
 
-    return numPackets;
+    /* Only the range that changed is worth processing, beyond the shorter packet the other one is zero */
+    size_t commonLength = std::min(oldPacket.size(), newPacket.size());
+    size_t longest = std::max(oldPacket.size(), newPacket.size());
 
+    size_t first = 0;
+    while(first < commonLength && oldPacket[first] == newPacket[first]) {
+        first++;
+    }
+
+    size_t last = longest;
+    if(oldPacket.size() == newPacket.size()) {
+        while(last > first && oldPacket[last - 1] == newPacket[last - 1]) {
+            last--;
+        }
+    }
+
+    std::vector<uint8_t> delta(last - first, 0);
+    for(size_t i = first; i < last; i++) {
+        delta[i - first] = ((i < oldPacket.size())? oldPacket[i] : 0) ^ ((i < newPacket.size())? newPacket[i] : 0);
+    }
+
+    encoderApplyDelta(parityPackets, index, first, delta.data(), delta.size(), oldPacket.size(), newPacket.size());
+}
+
+void CauchyFEC::impl::updateParity(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index,
+                                   size_t offset, const std::vector<uint8_t>& delta) {
+    encoderApplyDelta(parityPackets, index, offset, delta.data(), delta.size(), 0, 0);
+}
+
+void CauchyFEC::impl::encodeBlock(unsigned int numberOfSourcePackets, const uint8_t* const* sources, const size_t* lengths,
+                                  unsigned int numParity, const unsigned int* parityRows, uint8_t* const* parity, size_t parityLength) {
+    if(!numberOfSourcePackets || numberOfSourcePackets > fieldSize()) {
+        throw std::runtime_error("Invalid number of source packets");
+    }
+
+    if(parityLength < lengthSize() || alignLength(parityLength) != parityLength) {
+        throw std::runtime_error("Invalid parity length");
+    }
+
+    size_t dataLength = parityLength - lengthSize();
+    Matrix<Coefficient> generator(numParity, numberOfSourcePackets);
+
+    for(unsigned int j = 0; j < numParity; j++) {
+        if(parityRows[j] < numberOfSourcePackets || parityRows[j] >= fieldSize()) {
+            throw std::runtime_error("Invalid parity row");
+        }
+
+        Matrix<Coefficient> generatorRow = generator[j];
+        getGeneratorRow(generatorRow, parityRows[j], numberOfSourcePackets);
+
+        std::fill(parity[j], parity[j] + parityLength, 0);
+        for(unsigned int source = 0; source < numberOfSourcePackets; source++) {
+            if(lengths[source] > dataLength || lengths[source] > maxPacketSize()) {
+                throw std::runtime_error("Packet does not fit in the parity");
+            }
+            mulAddLength(&parity[j][dataLength], lengths[source], generator(j, source));
+        }
+    }
+
+    size_t shortest = *std::min_element(lengths, lengths + numberOfSourcePackets);
+    std::vector<Coefficient> coefficients;
+    for(unsigned int j = 0; j < numParity; j++) {
+        for(unsigned int source = 0; source < numberOfSourcePackets; source++) {
+            coefficients.push_back(generator(j, source));
+        }
+    }
+    auto routine = jitRoutine(coefficients, numParity, numberOfSourcePackets, shortest, ENCODER_JIT_MIN_WORK);
+
+    /* Same order as the encoder passes: one chunk of columns of all packets at a time */
+    for(size_t offset = 0; offset < dataLength; offset += chunkSize()) {
+        size_t start = offset;
+
+        if(routine && offset < shortest) {
+            size_t length = (std::min<size_t>(offset + chunkSize(), shortest) - offset) & ~(GFJit::BLOCK_SIZE - 1);
+            std::vector<uint8_t*> dst(numParity);
+            std::vector<const uint8_t*> src(numberOfSourcePackets);
+            for(unsigned int j = 0; j < numParity; j++) {
+                dst[j] = parity[j] + offset;
+            }
+            for(unsigned int source = 0; source < numberOfSourcePackets; source++) {
+                src[source] = sources[source] + offset;
+            }
+            (*routine)(dst.data(), src.data(), length);
+            start += length;
+        }
+
+        for(unsigned int source = 0; source < numberOfSourcePackets; source++) {
+            if(lengths[source] <= start) {
+                continue;
+            }
+
+            size_t end = std::min<size_t>(lengths[source], offset + chunkSize());
+            for(unsigned int j = 0; j < numParity; j++) {
+                mulAddRegion(&parity[j][start], &sources[source][start], generator(j, source), end - start);
+            }
+        }
+    }
 }
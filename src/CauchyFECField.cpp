@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CauchyFECImpl.h"
+#include <algorithm>
+
+void CauchyFEC::impl::mulAddRegion(uint8_t* dst, const uint8_t* src, Coefficient c, size_t len) {
+    if(field_ == FIELD_GF65536) {
+        RSGF65536Number::mulAddRegion(dst, src, c, len);
+    } else {
+        RSGF256Number::mulAddRegion(dst, src, c, len);
+    }
+}
+
+void CauchyFEC::impl::mulAddLength(uint8_t* dst, size_t length, Coefficient c) {
+    /* Big endian, a whole number of elements in both fields */
+    uint8_t lengthBytes[4];
+    for(unsigned int i = 0; i < lengthSize(); i++) {
+        lengthBytes[i] = length >> (8 * (lengthSize() - 1 - i));
+    }
+    mulAddRegion(dst, lengthBytes, c, lengthSize());
+}
+
+size_t CauchyFEC::impl::readLength(const uint8_t* src) {
+    size_t length = 0;
+    for(unsigned int i = 0; i < lengthSize(); i++) {
+        length = (length << 8) | src[i];
+    }
+    return length;
+}
+
+size_t CauchyFEC::impl::lengthSize() {
+    return largeSymbols_? 4 : 2;
+}
+
+size_t CauchyFEC::impl::maxPacketSize() {
+    return largeSymbols_? 0xFFFFFFFF : 0xFFFF;
+}
+
+size_t CauchyFEC::impl::chunkSize() {
+    /* Columns processed across all packets before moving on, keeps the working set in cache */
+    return 64 * 1024;
+}
+
+size_t CauchyFEC::impl::alignChunk(size_t chunk) {
+    /* Regions may only be split between elements */
+    if(field_ == FIELD_GF65536) {
+        return std::max<size_t>(2, chunk & ~(size_t)1);
+    }
+    return std::max<size_t>(1, chunk);
+}
+
+size_t CauchyFEC::impl::alignLength(size_t length) {
+    /* Packets are padded to a whole number of elements */
+    if(field_ == FIELD_GF65536) {
+        return (length + 1) & ~(size_t)1;
+    }
+    return length;
+}
+
+std::shared_ptr<const GFJit::Routine> CauchyFEC::impl::jitRoutine(const std::vector<Coefficient>& coefficients, unsigned int rows,
+                                                                  unsigned int columns, size_t length, size_t minWork) {
+    /* Compiling costs tens of microseconds, it only pays off for enough work (or a cached matrix) */
+    if(field_ != FIELD_GF256 || length < GFJit::BLOCK_SIZE || (size_t)rows * columns * length < minWork) {
+        return nullptr;
+    }
+    return GFJit::compile(coefficients.data(), rows, columns);
+}
+
+unsigned int CauchyFEC::impl::fieldSize() {
+    return (field_ == FIELD_GF65536)? 65536 : 256;
+}
+
+unsigned int CauchyFEC::impl::trailerSize() {
+    return ((field_ == FIELD_GF65536)? 4 : 2) + (extendedTrailer_? 1 : 0);
+}
+
+void CauchyFEC::impl::writeTrailer(uint8_t* dst, unsigned int index, unsigned int sourcePackets) {
+    if(field_ == FIELD_GF65536) {
+        dst[0] = index >> 8;
+        dst[1] = index & 0xFF;
+        dst[2] = (sourcePackets - 1) >> 8;
+        dst[3] = (sourcePackets - 1) & 0xFF;
+    } else {
+        dst[0] = index;
+        dst[1] = sourcePackets - 1;
+    }
+
+    if(extendedTrailer_) {
+        dst[trailerSize() - 1] = generator_;
+    }
+}
+
+void CauchyFEC::impl::readTrailer(const std::vector<uint8_t>& packet, unsigned int& index, unsigned int& sourcePackets) {
+    const uint8_t* trailer = &packet[packet.size() - trailerSize()];
+
+    if(field_ == FIELD_GF65536) {
+        index = (trailer[0] << 8) | trailer[1];
+        sourcePackets = ((trailer[2] << 8) | trailer[3]) + 1;
+    } else {
+        index = trailer[0];
+        sourcePackets = trailer[1] + 1;
+    }
+}
+
+bool CauchyFEC::impl::readGenerator(const std::vector<uint8_t>& packet, Generator& generator) {
+    if(!extendedTrailer_) {
+        generator = GENERATOR_CAUCHY;
+        return true;
+    }
+
+    /* Unknown constructions can not be decoded */
+    uint8_t id = packet.back();
+    if(id > GENERATOR_NORMALIZED_CAUCHY) {
+        return false;
+    }
+
+    generator = (Generator)id;
+    return true;
+}
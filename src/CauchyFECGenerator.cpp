@@ -25,12 +25,15 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <mutex>
+#include <algorithm>
 #include "CauchyFECImpl.h"
 #include "Matrix.h"
 #include "GF256Number.h"
+#include "GF65536Number.h"
 
 
-void CauchyFEC::impl::getGeneratorRow(Matrix<RSGF256Number>& target, unsigned int row, unsigned int sourcePackets) {
+template <typename GF> static void cauchyGeneratorRow(Matrix<uint16_t>& target, unsigned int row, unsigned int sourcePackets, unsigned int fieldMax) {
     /* Identity part */
     if(row < sourcePackets) {
         for(unsigned int col = 0; col < sourcePackets; col++) {
@@ -50,10 +53,130 @@ void CauchyFEC::impl::getGeneratorRow(Matrix<RSGF256Number>& target, unsigned in
     /* Cauchy elements */
     for(unsigned int col = 0; col < sourcePackets; col++) {
         /* row starts at sourcePackets + 1 */
-        RSGF256Number x = 255 - row;
-        /* 255 - sourcePackets is not used, as this 'slot' was used by the row of ones */
-        RSGF256Number y = 255 - sourcePackets + col + 1;
+        GF x = fieldMax - row;
+        /* fieldMax - sourcePackets is not used, as this 'slot' was used by the row of ones */
+        GF y = fieldMax - sourcePackets + col + 1;
 
-        target(0, col) = RSGF256Number(1)/(x+y);
+        target(0, col) = (GF(1)/(x+y)).value();
+    }
+}
+
+/*
+ * Normalised Cauchy: row x and column y of 1/(x+y) are scaled so that the row of ones
+ * (x = fieldMax - sourcePackets) and column 0 are all ones. Scaling keeps every square
+ * submatrix nonsingular, so the code stays MDS. It also rules out any other ones.
+ */
+template <typename GF> static uint16_t normalizedCauchyElement(unsigned int x, unsigned int col, unsigned int sourcePackets, unsigned int fieldMax) {
+    GF x0 = fieldMax - sourcePackets;
+    GF y0 = fieldMax - sourcePackets + 1;
+    GF y = fieldMax - sourcePackets + col + 1;
+
+    return ((GF(x) + y0) * (x0 + y) / ((GF(x) + y) * (x0 + y0))).value();
+}
+
+/* Number of ones in the 8x8 bit matrix of a multiplication by c, the cost of an XOR schedule */
+static unsigned int bitMatrixWeight(uint8_t c) {
+    unsigned int weight = 0;
+    for(unsigned int bit = 0; bit < 8; bit++) {
+        weight += __builtin_popcount((RSGF256Number(c) * RSGF256Number(1 << bit)).value());
+    }
+    return weight;
+}
+
+/*
+ * GF(2^8): the x points of the parity rows, sorted by the total bit matrix weight of their
+ * row so the first parity packets are the cheapest. Ties keep the plain Cauchy order. This
+ * only depends on the number of source packets, decoders find the same order.
+ */
+static const std::vector<uint8_t>& normalizedPointOrder(unsigned int sourcePackets) {
+    static std::once_flag once[255];
+    static std::vector<uint8_t> order[255];
+
+    std::call_once(once[sourcePackets - 1], [sourcePackets]() {
+        unsigned int points = 255 - sourcePackets;
+        std::vector<std::pair<unsigned int, uint8_t>> weights;
+
+        for(unsigned int i = 0; i < points; i++) {
+            uint8_t x = 255 - sourcePackets - 1 - i;
+            unsigned int weight = 0;
+            for(unsigned int col = 0; col < sourcePackets; col++) {
+                weight += bitMatrixWeight(normalizedCauchyElement<RSGF256Number>(x, col, sourcePackets, 255));
+            }
+            weights.push_back(std::make_pair(weight, x));
+        }
+
+        std::stable_sort(weights.begin(), weights.end(), [](const std::pair<unsigned int, uint8_t>& a,
+                                                            const std::pair<unsigned int, uint8_t>& b) {
+            return a.first < b.first;
+        });
+
+        for(auto& weight: weights) {
+            order[sourcePackets - 1].push_back(weight.second);
+        }
+    });
+
+    return order[sourcePackets - 1];
+}
+
+template <typename GF> static void normalizedCauchyGeneratorRow(Matrix<uint16_t>& target, unsigned int row, unsigned int sourcePackets, unsigned int fieldMax) {
+    /* Identity part and row of ones are shared with the plain construction */
+    if(row <= sourcePackets) {
+        cauchyGeneratorRow<GF>(target, row, sourcePackets, fieldMax);
+        return;
+    }
+
+    unsigned int x = fieldMax - row;
+    if(fieldMax == 255) {
+        x = normalizedPointOrder(sourcePackets)[row - sourcePackets - 1];
+    }
+
+    for(unsigned int col = 0; col < sourcePackets; col++) {
+        target(0, col) = normalizedCauchyElement<GF>(x, col, sourcePackets, fieldMax);
+    }
+}
+
+unsigned int CauchyFEC::impl::numLocalGroups(unsigned int sourcePackets) {
+    if(!localGroupSize_) {
+        return 0;
+    }
+    return (sourcePackets + localGroupSize_ - 1) / localGroupSize_;
+}
+
+void CauchyFEC::impl::getGeneratorRow(Matrix<Coefficient>& target, unsigned int row, unsigned int sourcePackets) {
+    getGeneratorRow(target, row, sourcePackets, generator_);
+}
+
+void CauchyFEC::impl::getGeneratorRow(Matrix<Coefficient>& target, unsigned int row, unsigned int sourcePackets, Generator generator) {
+    StatsTimer timer(*this, &Stats::nsGenerator);
+
+    /*
+     * Locally repairable code: the row of ones is split in one row per group. Together they
+     * add up to the row of ones, so the global parity continues with the Cauchy elements.
+     */
+    unsigned int localGroups = numLocalGroups(sourcePackets);
+    if(localGroups && row >= sourcePackets) {
+        if(row < sourcePackets + localGroups) {
+            unsigned int groupStart = (row - sourcePackets) * localGroupSize_;
+            for(unsigned int col = 0; col < sourcePackets; col++) {
+                target(0, col) = (col >= groupStart && col < groupStart + localGroupSize_)? 1 : 0;
+            }
+            return;
+        }
+        row -= localGroups - 1;
+    }
+
+    if(generator == GENERATOR_NORMALIZED_CAUCHY) {
+        if(field_ == FIELD_GF65536) {
+            normalizedCauchyGeneratorRow<RSGF65536Number>(target, row, sourcePackets, 65535);
+        } else {
+            normalizedCauchyGeneratorRow<RSGF256Number>(target, row, sourcePackets, 255);
+        }
+        return;
+    }
+
+    if(field_ == FIELD_GF65536) {
+        cauchyGeneratorRow<RSGF65536Number>(target, row, sourcePackets, 65535);
+    } else {
+        cauchyGeneratorRow<RSGF256Number>(target, row, sourcePackets, 255);
     }
 }
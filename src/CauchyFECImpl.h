@@ -26,29 +26,83 @@
  */
 
 #include <vector>
+#include <deque>
 #include <cstdint>
+#include <cstddef>
+#include <stdexcept>
 #include "Matrix.h"
 #include "GF256Number.h"
+#include "GF65536Number.h"
 #include "CauchyFEC.h"
+#include "CauchyFECProbes.h"
+#include "GFJit.h"
 
 #ifndef CAUCHYFECIMPL_H_
 #define CAUCHYFECIMPL_H_
 
 using RSGF256Number = GF256Number<>;
+using RSGF65536Number = GF65536Number<>;
 
 
 class CauchyFEC::impl {
 public:
     static void init() {
         RSGF256Number::init();
+        RSGF65536Number::init();
     }
 
     impl() {
+        configuredField_ = FIELD_GF256;
+        configuredLargeSymbols_ = false;
+        configuredLocalGroupSize_ = 0;
+        configuredExtendedTrailer_ = false;
+        configuredGenerator_ = GENERATOR_CAUCHY;
+        statsEnabled_ = false;
+        statsActive_ = false;
+        statsGlobal_ = false;
+        clearStats();
         reset(false, 0);
     }
 
+    ~impl() {
+        statsFold();
+    }
+
+    inline void setField(Field field) {
+        configuredField_ = field;
+    }
+
+    inline void setLargeSymbols(bool enable) {
+        configuredLargeSymbols_ = enable;
+    }
+
+    inline void setLocalGroups(unsigned int groupSize) {
+        configuredLocalGroupSize_ = groupSize;
+    }
+
+    inline void setExtendedTrailer(bool enable) {
+        configuredExtendedTrailer_ = enable;
+    }
+
+    inline void setGenerator(Generator generator) {
+        configuredGenerator_ = generator;
+    }
+
     inline void reset(bool encode, unsigned int numberOfSourcePackets = 0) {
+        if(encode && configuredGenerator_ != GENERATOR_CAUCHY && !configuredExtendedTrailer_) {
+            throw std::runtime_error("This generator needs the extended trailer");
+        }
+
         isEncoder_ = encode;
+        field_ = configuredField_;
+        largeSymbols_ = configuredLargeSymbols_;
+        localGroupSize_ = configuredLocalGroupSize_;
+        extendedTrailer_ = configuredExtendedTrailer_;
+        generator_ = configuredGenerator_;
+        statsFold();
+        statsGlobal_ = globalStatsEnabled();
+        statsActive_ = statsEnabled_ || statsGlobal_;
+        CAUCHYFEC_PROBE2(reset, encode, numberOfSourcePackets);
         if(isEncoder_) {
             encoderReset(numberOfSourcePackets);
         } else {
@@ -64,6 +118,14 @@ public:
         }
     }
 
+    inline void operator<<(std::vector<uint8_t>&& sourcePacket) {
+        if(isEncoder_) {
+            encoderOperatorLL(std::move(sourcePacket));
+        } else {
+            decoderOperatorLL(std::move(sourcePacket));
+        }
+    }
+
     inline void operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets) {
         if(isEncoder_) {
             encoderOperatorLL(sourcePackets);
@@ -73,11 +135,14 @@ public:
     }
 
     inline unsigned int requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets = 1) {
+        unsigned int count;
         if(isEncoder_) {
-            return encoderRequestPackets(outputPackets, numPackets);
+            count = encoderRequestPackets(outputPackets, numPackets);
         } else {
-            return decoderRequestPackets(outputPackets, numPackets);
+            count = decoderRequestPackets(outputPackets, numPackets);
         }
+        statsCount(&Stats::packetsOut, count);
+        return count;
     }
 
     inline bool operator>>(std::vector<uint8_t>& outputPackets) {
@@ -95,42 +160,252 @@ public:
         return requestPackets(outputPackets, 1) > 0;
     }
 
+    inline void flush() {
+        if(isEncoder_) {
+            encoderFlush();
+        }
+    }
+
+    void updateParity(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index,
+                      const std::vector<uint8_t>& oldPacket, const std::vector<uint8_t>& newPacket);
+    void updateParity(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index,
+                      size_t offset, const std::vector<uint8_t>& delta);
+
+    inline bool packetLength(unsigned int index, size_t& length) {
+        if(isEncoder_) {
+            return false;
+        }
+        return decoderPacketLength(index, length);
+    }
+
+    inline bool decodeRange(unsigned int index, size_t offset, size_t length, std::vector<uint8_t>& output) {
+        if(isEncoder_) {
+            return false;
+        }
+        return decoderDecodeRange(index, offset, length, output);
+    }
+
+    bool verify(const std::vector<std::vector<uint8_t>>& packets,
+                std::vector<unsigned int>& inconsistentParity, int& corruptSource);
+
+    inline size_t parityLength(size_t longestSourcePacket) {
+        return alignLength(longestSourcePacket) + lengthSize();
+    }
+
+    void encodeBlock(unsigned int numberOfSourcePackets, const uint8_t* const* sources, const size_t* lengths,
+                     unsigned int numParity, const unsigned int* parityRows, uint8_t* const* parity, size_t parityLength);
+    bool decodeBlock(unsigned int numberOfSourcePackets, const uint8_t* const* sources, size_t* lengths,
+                     unsigned int numParity, const unsigned int* parityRows, const uint8_t* const* parity,
+                     size_t parityLength, uint8_t* const* recovered);
+
+    inline void schedulePackets(unsigned int numPackets) {
+        if(isEncoder_) {
+            encoderSchedulePackets(numPackets);
+        }
+    }
+
+    inline bool step(size_t maxWork) {
+        if(isEncoder_) {
+            return encoderStep(maxWork);
+        } else {
+            return decoderStep(maxWork);
+        }
+    }
+
+    inline void enableStats(bool enable) {
+        statsEnabled_ = enable;
+    }
+
+    inline void getStats(Stats& stats) {
+        stats = stats_;
+    }
+
+    void clearStats();
+    static void enableGlobalStats(bool enable);
+    static void getGlobalStats(Stats& stats);
+
 private:
 
-    /* Shared */
-    void getGeneratorRow(Matrix<RSGF256Number>& target, unsigned int row, unsigned int sourcePackets);
+    /* Shared, coefficients are stored as raw elements of the selected field */
+    using Coefficient = uint16_t;
+
+    void getGeneratorRow(Matrix<Coefficient>& target, unsigned int row, unsigned int sourcePackets);
+    void getGeneratorRow(Matrix<Coefficient>& target, unsigned int row, unsigned int sourcePackets, Generator generator);
+    unsigned int numLocalGroups(unsigned int sourcePackets);
+
+    /* Field dependent parts (CauchyFECField.cpp) */
+    void mulAddRegion(uint8_t* dst, const uint8_t* src, Coefficient c, size_t len);
+    void mulAddLength(uint8_t* dst, size_t length, Coefficient c);
+    size_t readLength(const uint8_t* src);
+    size_t lengthSize();
+    size_t maxPacketSize();
+    size_t chunkSize();
+    size_t alignChunk(size_t chunk);
+    size_t alignLength(size_t length);
+    std::shared_ptr<const GFJit::Routine> jitRoutine(const std::vector<Coefficient>& coefficients, unsigned int rows,
+                                                     unsigned int columns, size_t length, size_t minWork);
+    unsigned int fieldSize();
+    unsigned int trailerSize();
+    void writeTrailer(uint8_t* dst, unsigned int index, unsigned int sourcePackets);
+    void readTrailer(const std::vector<uint8_t>& packet, unsigned int& index, unsigned int& sourcePackets);
+    bool readGenerator(const std::vector<uint8_t>& packet, Generator& generator);
+
+    /*
+     * Statistics (CauchyFECStats.cpp). Counting is a predictable branch, phases are timed
+     * once per stage or chunk of work. statsFolded_ is the part already in the aggregate,
+     * statsGlobal_ tells whether the aggregate was on when counting since then started.
+     */
+    static bool globalStatsEnabled();
+    static uint64_t statsNow();
+    void statsFold();
+
+    inline void statsCount(uint64_t Stats::* counter, uint64_t n = 1) {
+        if(statsActive_) {
+            stats_.*counter += n;
+        }
+    }
+
+    class StatsTimer {
+    public:
+        StatsTimer(impl& owner, uint64_t Stats::* counter):
+            owner_(owner),
+            counter_(counter),
+            start_(owner.statsActive_? statsNow() : 0) {
+        }
+
+        ~StatsTimer() {
+            if(owner_.statsActive_) {
+                owner_.stats_.*counter_ += statsNow() - start_;
+            }
+        }
+
+    private:
+        impl& owner_;
+        uint64_t Stats::* counter_;
+        uint64_t start_;
+    };
+
+    bool statsEnabled_;
+    bool statsActive_;
+    bool statsGlobal_;
+    Stats stats_;
+    Stats statsFolded_;
 
     unsigned int numSourcePackets_;
     bool isEncoder_;
+    Field field_;
+    Field configuredField_;
+    bool largeSymbols_;
+    bool configuredLargeSymbols_;
+    unsigned int localGroupSize_;
+    unsigned int configuredLocalGroupSize_;
+    bool extendedTrailer_;
+    bool configuredExtendedTrailer_;
+    Generator generator_;
+    Generator configuredGenerator_;
 
     /* Encoder part */
     void encoderReset(unsigned int numSourcePackets);
+    void encoderCheckPacket(const std::vector<uint8_t>& sourcePacket);
     void encoderOperatorLL(const std::vector<uint8_t>& sourcePacket);
+    void encoderOperatorLL(std::vector<uint8_t>&& sourcePacket);
     void encoderOperatorLL(const std::vector<std::vector<uint8_t>>& sourcePackets);
-    void encoderBuildMessageMatrix();
+    void encoderFlush();
     void encoderIncrementGenerator();
+    void encoderSchedulePackets(unsigned int numPackets);
+    bool encoderStep(size_t budget);
     unsigned int encoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets);
 
+    /* A parity packet, all packets that are not done are calculated together in one pass */
+    struct EncoderParityJob {
+        unsigned int row;
+        bool inPass;
+        bool done;
+        Matrix<Coefficient> generatorRow;
+        std::vector<uint8_t> packet;
+    };
+    bool encoderStartPass();
+    bool encoderRunPass(size_t& budget);
+    void encoderApplyDelta(std::vector<std::vector<uint8_t>>& parityPackets, unsigned int index, size_t offset,
+                           const uint8_t* delta, size_t length, size_t oldLength, size_t newLength);
+
     std::vector<std::vector<uint8_t>> encoderSourcePackets_;
     unsigned int encoderLongestSourcePacket_;
     bool encoderReadingSourcePackets_;
     unsigned int encoderGeneratorRowIndex_;
-    Matrix<RSGF256Number> encoderMessageMatrix_;
+    std::deque<EncoderParityJob> encoderParityJobs_;
+    bool encoderPassActive_;
+    unsigned int encoderPassJobs_;
+    size_t encoderPassOffset_;
+    unsigned int encoderPassSource_;
+    size_t encoderPassSourceOffset_;
+    size_t encoderPassShortest_;
+    std::shared_ptr<const GFJit::Routine> encoderPassJit_;
 
     /* Decoder part */
     void decoderReset();
+    bool decoderPacketWanted(const std::vector<uint8_t>& inputPacket, unsigned int& packetIndex);
+    void decoderStorePacket(std::vector<uint8_t>&& inputPacket, unsigned int packetIndex);
     void decoderOperatorLL(const std::vector<uint8_t>& inputPacket);
+    void decoderOperatorLL(std::vector<uint8_t>&& inputPacket);
     void decoderOperatorLL(const std::vector<std::vector<uint8_t>>& inputPacket);
-    bool decoderMatrixInverse(Matrix<RSGF256Number>& matrix);
+    bool decoderMatrixInverse(Matrix<Coefficient>& matrix);
+    bool decoderMatrixInversePivot(Matrix<Coefficient>& matrix, Matrix<Coefficient>& inverse, unsigned int pIndex);
     unsigned int decoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets);
+    bool decoderShortenBlock(unsigned int announcedSourcePackets, unsigned int packetIndex);
+    void decoderLocalRepairStep(size_t& budget);
+    bool decoderSelectParity(unsigned int parityPacketsNeeded, std::vector<unsigned int>& usedParityPacketIndex);
+    bool decoderStart();
+    bool decoderSetup();
+    void decoderSetStuck(StuckReason reason);
+    bool decoderStep(size_t budget);
     bool decoderRun();
 
+    /* Range decoding, the inverse is kept until the received packets change */
+    bool decoderRangePrepare();
+    void decoderRangeRow(unsigned int missing, size_t offset, size_t length, std::vector<uint8_t>& output);
+    bool decoderPacketLength(unsigned int index, size_t& length);
+    bool decoderDecodeRange(unsigned int index, size_t offset, size_t length, std::vector<uint8_t>& output);
+
+    /* Decoding is split in stages so it can be interrupted after every piece of work */
+    enum DecoderStage {
+        DECODER_IDLE,
+        DECODER_LOCAL_REPAIR,
+        DECODER_LOAD,
+        DECODER_INVERT,
+        DECODER_SUBTRACT,
+        DECODER_MULTIPLY,
+        DECODER_WRITEBACK,
+    };
+
     bool decoderWaitingFirstPacket_;
     bool decoderStuck_;
     unsigned int decoderOriginalPacketsReceived_;
     unsigned int decoderPacketsReturned_;
     std::vector<std::vector<uint8_t>> decoderPacketBuffer_;
 
+    DecoderStage decoderStage_;
+    size_t decoderProgress_;
+    unsigned int decoderProgressSource_;
+    size_t decoderProgressOffset_;
+    size_t decoderParityLength_;
+    std::vector<unsigned int> decoderUsedParity_;
+    std::vector<bool> decoderUsedParityRows_;
+    std::vector<unsigned int> decoderMissing_;
+    std::vector<unsigned int> decoderKnown_;
+    Matrix<Coefficient> decoderGenerator_;
+    Matrix<Coefficient> decoderGeneratorSub_;
+    Matrix<Coefficient> decoderInverse_;
+    std::vector<std::vector<uint8_t>> decoderParityMessage_;
+    std::vector<std::vector<uint8_t>> decoderDecodedMessage_;
+    bool decoderLocalActive_;
+    unsigned int decoderLocalMissing_;
+    std::vector<uint8_t> decoderLocalRecovered_;
+    std::shared_ptr<const GFJit::Routine> decoderJit_;
+
+    bool decoderRangeReady_;
+    Matrix<Coefficient> decoderRangeCoefficients_;
+
 };
 
 #endif /* CAUCHYFEC_H_ */
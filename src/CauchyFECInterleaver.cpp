@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CauchyFECInterleaver.h"
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+class CauchyFECInterleaver::impl {
+public:
+    impl() {
+        configuredField_ = CauchyFEC::FIELD_GF256;
+        configuredThreads_ = 1;
+        workGeneration_ = 0;
+        workersBusy_ = 0;
+        stopping_ = false;
+        reset(false, 0, 0);
+    }
+
+    ~impl() {
+        stopWorkers();
+    }
+
+    void setField(CauchyFEC::Field field) {
+        configuredField_ = field;
+    }
+
+    void setThreads(unsigned int threads) {
+        configuredThreads_ = std::max(1u, threads);
+    }
+
+    void reset(bool encode, unsigned int depth, unsigned int numberOfSourcePackets) {
+        isEncoder_ = encode;
+        threads_ = configuredThreads_;
+        numSourcePackets_ = numberOfSourcePackets;
+        packetsLoaded_ = 0;
+        packetsReturned_ = 0;
+        parityCursor_ = 0;
+        encoderReadingSourcePackets_ = true;
+        decoderWaitingFirstPacket_ = true;
+        pending_.clear();
+
+        if(!isEncoder_) {
+            return;
+        }
+
+        if(!depth || depth > MAX_DEPTH) {
+            throw std::runtime_error("Depth must be between 1 and 256");
+        }
+
+        setDepth(depth);
+        for(auto& lane: lanes_) {
+            lane->reset(true, numSourcePackets_);
+        }
+    }
+
+    void operator<<(const std::vector<uint8_t>& packet) {
+        operator<<(std::vector<uint8_t>(packet));
+    }
+
+    void operator<<(std::vector<uint8_t>&& packet) {
+        if(isEncoder_) {
+            encoderLoad(std::move(packet));
+        } else {
+            decoderLoad(std::move(packet));
+        }
+    }
+
+    void operator<<(const std::vector<std::vector<uint8_t>>& packets) {
+        for(auto& packet: packets) {
+            operator<<(packet);
+        }
+    }
+
+    unsigned int requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+        if(isEncoder_) {
+            return encoderRequestPackets(outputPackets, numPackets);
+        } else {
+            return decoderRequestPackets(outputPackets, numPackets);
+        }
+    }
+
+    bool operator>>(std::vector<uint8_t>& outputPacket) {
+        std::vector<std::vector<uint8_t>> tmp;
+
+        if(requestPackets(tmp, 1)) {
+            outputPacket = std::move(tmp[0]);
+            return true;
+        }
+
+        return false;
+    }
+
+    void flush() {
+        if(!isEncoder_ || !encoderReadingSourcePackets_) {
+            return;
+        }
+
+        if(!packetsLoaded_) {
+            throw std::runtime_error("At least one source packet is needed");
+        }
+
+        /* Blocks that did not get a packet are left out */
+        for(unsigned int lane = 0; lane < std::min(depth_, packetsLoaded_); lane++) {
+            lanes_[lane]->flush();
+        }
+        encoderReadingSourcePackets_ = false;
+    }
+
+private:
+    static const size_t TRAILER_SIZE = 2;
+    static const unsigned int MAX_DEPTH = 256;
+
+    bool isEncoder_;
+    CauchyFEC::Field configuredField_;
+    unsigned int configuredThreads_;
+    unsigned int threads_;
+    unsigned int depth_;
+    unsigned int numSourcePackets_;
+    unsigned int packetsLoaded_;
+    unsigned int packetsReturned_;
+    unsigned int parityCursor_;
+    bool encoderReadingSourcePackets_;
+    bool decoderWaitingFirstPacket_;
+
+    /* Instances are kept over resets, only the first depth_ are in use */
+    std::vector<std::unique_ptr<CauchyFEC>> lanes_;
+    std::deque<std::vector<uint8_t>> pending_;
+
+    /* Decoder: lanes that received packets since they were last stepped */
+    std::vector<bool> laneDirty_;
+
+    /* Helper threads are kept between calls, every forEachLane() hands them one batch */
+    std::vector<std::thread> workers_;
+    std::mutex workMutex_;
+    std::condition_variable workReady_;
+    std::condition_variable workDone_;
+    std::function<void()> work_;
+    uint64_t workGeneration_;
+    unsigned int workersBusy_;
+    bool stopping_;
+
+    void setDepth(unsigned int depth) {
+        depth_ = depth;
+        while(lanes_.size() < depth_) {
+            lanes_.emplace_back(new CauchyFEC());
+        }
+        for(unsigned int lane = 0; lane < depth_; lane++) {
+            lanes_[lane]->setField(configuredField_);
+        }
+    }
+
+    unsigned int usedLanes() {
+        return std::min(depth_, packetsLoaded_);
+    }
+
+    void workerLoop(uint64_t generation) {
+        std::unique_lock<std::mutex> lock(workMutex_);
+
+        while(true) {
+            workReady_.wait(lock, [&]() { return stopping_ || workGeneration_ != generation; });
+            if(stopping_) {
+                return;
+            }
+            generation = workGeneration_;
+
+            std::function<void()> work = work_;
+            lock.unlock();
+            work();
+            lock.lock();
+
+            if(!--workersBusy_) {
+                workDone_.notify_all();
+            }
+        }
+    }
+
+    void startWorkers(unsigned int count) {
+        if(workers_.size() == count) {
+            return;
+        }
+
+        stopWorkers();
+
+        std::lock_guard<std::mutex> lock(workMutex_);
+        for(unsigned int i = 0; i < count; i++) {
+            workers_.emplace_back(&impl::workerLoop, this, workGeneration_);
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(workMutex_);
+            stopping_ = true;
+        }
+        workReady_.notify_all();
+
+        for(auto& worker: workers_) {
+            worker.join();
+        }
+        workers_.clear();
+        stopping_ = false;
+    }
+
+    /* Runs work(lane) for the given lanes, on the calling thread and threads_ - 1 helpers */
+    template<typename F> void forEachLane(const std::vector<unsigned int>& lanes, F work) {
+        if(threads_ <= 1 || lanes.size() <= 1) {
+            for(auto lane: lanes) {
+                work(lane);
+            }
+            return;
+        }
+
+        startWorkers(threads_ - 1);
+
+        std::atomic<unsigned int> next(0);
+        std::exception_ptr error;
+        std::atomic<bool> failed(false);
+
+        auto batch = [&]() {
+            try {
+                for(unsigned int i = next++; i < lanes.size(); i = next++) {
+                    work(lanes[i]);
+                }
+            } catch(...) {
+                if(!failed.exchange(true)) {
+                    error = std::current_exception();
+                }
+            }
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(workMutex_);
+            work_ = batch;
+            workersBusy_ = workers_.size();
+            workGeneration_++;
+        }
+        workReady_.notify_all();
+
+        batch();
+
+        {
+            std::unique_lock<std::mutex> lock(workMutex_);
+            workDone_.wait(lock, [&]() { return !workersBusy_; });
+            work_ = nullptr;
+        }
+
+        if(error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void appendTrailer(std::vector<uint8_t>& packet, unsigned int lane) {
+        packet.push_back(lane);
+        packet.push_back(depth_ - 1);
+    }
+
+    void encoderLoad(std::vector<uint8_t>&& packet) {
+        if(!encoderReadingSourcePackets_ || packetsLoaded_ >= depth_ * numSourcePackets_) {
+            throw std::runtime_error("Interleaver is full");
+        }
+
+        /* Source packets go out right away, in the order they were loaded */
+        unsigned int lane = packetsLoaded_ % depth_;
+        std::vector<uint8_t> output;
+
+        *lanes_[lane] << std::move(packet);
+        *lanes_[lane] >> output;
+        appendTrailer(output, lane);
+        pending_.push_back(std::move(output));
+
+        if(++packetsLoaded_ == depth_ * numSourcePackets_) {
+            encoderReadingSourcePackets_ = false;
+        }
+    }
+
+    unsigned int encoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        unsigned int count = 0;
+        for(; count < numPackets && !pending_.empty(); count++) {
+            packets.push_back(std::move(pending_.front()));
+            pending_.pop_front();
+        }
+
+        /* Parity needs every block to be complete */
+        if(count == numPackets || encoderReadingSourcePackets_) {
+            return count;
+        }
+
+        /*
+         * Parity is sent one packet of every block in turn, continuing the rotation of the
+         * source packets so that a burst over the boundary is spread as well. The blocks are
+         * encoded in parallel.
+         */
+        unsigned int lanesUsed = usedLanes();
+        unsigned int numParity = numPackets - count;
+        std::vector<unsigned int> parityPerLane(lanesUsed, 0);
+        for(unsigned int i = 0; i < numParity; i++) {
+            parityPerLane[(packetsLoaded_ + parityCursor_ + i) % lanesUsed]++;
+        }
+
+        std::vector<unsigned int> lanes;
+        for(unsigned int lane = 0; lane < lanesUsed; lane++) {
+            if(parityPerLane[lane]) {
+                lanes.push_back(lane);
+            }
+        }
+
+        std::vector<std::vector<std::vector<uint8_t>>> parity(lanesUsed);
+        forEachLane(lanes, [&](unsigned int lane) {
+            lanes_[lane]->requestPackets(parity[lane], parityPerLane[lane]);
+        });
+
+        std::vector<unsigned int> taken(lanesUsed, 0);
+        for(unsigned int i = 0; i < numParity; i++) {
+            unsigned int lane = (packetsLoaded_ + parityCursor_) % lanesUsed;
+            auto& packet = parity[lane][taken[lane]++];
+            appendTrailer(packet, lane);
+            packets.push_back(std::move(packet));
+            parityCursor_++;
+        }
+
+        return numPackets;
+    }
+
+    void decoderLoad(std::vector<uint8_t>&& packet) {
+        if(packet.size() <= TRAILER_SIZE) {
+            return;
+        }
+
+        unsigned int depth = packet[packet.size() - 1] + 1;
+        unsigned int lane = packet[packet.size() - 2];
+
+        if(decoderWaitingFirstPacket_) {
+            decoderWaitingFirstPacket_ = false;
+            setDepth(depth);
+            for(unsigned int i = 0; i < depth_; i++) {
+                lanes_[i]->reset(false);
+            }
+            laneDirty_.assign(depth_, false);
+        }
+
+        /* Packets of another series are ignored */
+        if(depth != depth_ || lane >= depth_) {
+            return;
+        }
+
+        packet.resize(packet.size() - TRAILER_SIZE);
+        *lanes_[lane] << std::move(packet);
+        laneDirty_[lane] = true;
+    }
+
+    unsigned int decoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        if(decoderWaitingFirstPacket_) {
+            return 0;
+        }
+
+        decoderStepLanes();
+
+        for(unsigned int count = 0; count < numPackets; count++) {
+            unsigned int lane = packetsReturned_ % depth_;
+            if(!(*lanes_[lane] >> packets)) {
+                return count;
+            }
+            packetsReturned_++;
+        }
+
+        return numPackets;
+    }
+
+    /* Lanes with new packets recover in parallel before any is served, the others are unchanged */
+    void decoderStepLanes() {
+        std::vector<unsigned int> lanes;
+        for(unsigned int lane = 0; lane < depth_; lane++) {
+            if(laneDirty_[lane]) {
+                laneDirty_[lane] = false;
+                lanes.push_back(lane);
+            }
+        }
+
+        forEachLane(lanes, [&](unsigned int lane) {
+            lanes_[lane]->step(std::numeric_limits<unsigned int>::max());
+        });
+    }
+};
+
+CauchyFECInterleaver::CauchyFECInterleaver():
+    impl_(new impl()) {
+}
+
+void CauchyFECInterleaver::setField(CauchyFEC::Field field) {
+    impl_->setField(field);
+}
+
+void CauchyFECInterleaver::setThreads(unsigned int threads) {
+    impl_->setThreads(threads);
+}
+
+void CauchyFECInterleaver::reset(bool encode, unsigned int depth, unsigned int numberOfSourcePackets) {
+    impl_->reset(encode, depth, numberOfSourcePackets);
+}
+
+void CauchyFECInterleaver::operator<<(const std::vector<uint8_t>& sourcePacket) {
+    impl_->operator<<(sourcePacket);
+}
+
+void CauchyFECInterleaver::operator<<(std::vector<uint8_t>&& sourcePacket) {
+    impl_->operator<<(std::move(sourcePacket));
+}
+
+void CauchyFECInterleaver::operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets) {
+    impl_->operator<<(sourcePackets);
+}
+
+unsigned int CauchyFECInterleaver::requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+    return impl_->requestPackets(outputPackets, numPackets);
+}
+
+bool CauchyFECInterleaver::operator>>(std::vector<uint8_t>& outputPacket) {
+    return impl_->operator>>(outputPacket);
+}
+
+bool CauchyFECInterleaver::operator>>(std::vector<std::vector<uint8_t>>& outputPackets) {
+    return impl_->requestPackets(outputPackets, 1) > 0;
+}
+
+void CauchyFECInterleaver::flush() {
+    impl_->flush();
+}
+
+CauchyFECInterleaver::~CauchyFECInterleaver() = default;
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <memory>
+#include "CauchyFEC.h"
+
+#ifndef CAUCHYFECINTERLEAVER_H_
+#define CAUCHYFECINTERLEAVER_H_
+
+/*
+ * Spreads consecutive source packets over 'depth' CauchyFEC blocks of k source packets
+ * each: packet i goes to block i % depth. Source packets are sent as they are loaded, the
+ * parity follows once every block is complete, one packet of every block in turn. A burst
+ * of B lost packets costs each block about B / depth packets, so bursts longer than the
+ * parity of one block are covered while k, and the decoding cost, stay small.
+ *
+ * Every packet is a CauchyFEC packet followed by a two byte trailer: the block it belongs
+ * to and the depth minus one. The decoder returns the packets in their original order.
+ * With more than one thread, parity of the blocks is generated and recovered in parallel.
+ */
+class CauchyFECInterleaver {
+public:
+    CAUCHYFEC_H_EXPORT_FUNCTION CauchyFECInterleaver();
+    CAUCHYFEC_H_EXPORT_FUNCTION ~CauchyFECInterleaver();
+
+    /* Both take effect at the next reset() */
+    void CAUCHYFEC_H_EXPORT_FUNCTION setField(CauchyFEC::Field field);
+    void CAUCHYFEC_H_EXPORT_FUNCTION setThreads(unsigned int threads);
+
+    void CAUCHYFEC_H_EXPORT_FUNCTION reset(bool encode, unsigned int depth = 0, unsigned int numberOfSourcePackets = 0);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<uint8_t>& sourcePacket);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(std::vector<uint8_t>&& sourcePacket);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets);
+    unsigned int CAUCHYFEC_H_EXPORT_FUNCTION requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets = 1);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<uint8_t>& outputPackets);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<std::vector<uint8_t>>& outputPackets);
+
+    /* Encoder: close all blocks with the source packets loaded so far */
+    void CAUCHYFEC_H_EXPORT_FUNCTION flush();
+
+private:
+    class impl;
+    std::unique_ptr<impl> impl_;
+};
+
+#endif /* CAUCHYFECINTERLEAVER_H_ */
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CauchyFECPacker.h"
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+
+class CauchyFECPacker::impl {
+public:
+    impl() {
+        reset(false, 0, 0);
+    }
+
+    void reset(bool encode, unsigned int numberOfSymbols, unsigned int symbolSize) {
+        isEncoder_ = encode;
+        numSymbols_ = numberOfSymbols;
+        symbolSize_ = symbolSize;
+        symbolsLoaded_ = 0;
+        currentSymbol_.clear();
+        datagrams_.clear();
+        partialDatagram_.clear();
+        partialLength_ = 0;
+        partialLengthShift_ = 0;
+        readingLength_ = true;
+        blockSymbolSize_ = 0;
+        blockBytesUnpacked_ = 0;
+        blockCorrupt_ = false;
+
+        if(isEncoder_) {
+            if(!symbolSize_) {
+                throw std::runtime_error("Symbol size must be at least one byte");
+            }
+            currentSymbol_.reserve(symbolSize_);
+        }
+
+        fec_.reset(encode, numberOfSymbols);
+    }
+
+    bool operator<<(const std::vector<uint8_t>& packet) {
+        if(!isEncoder_) {
+            fec_ << packet;
+            return true;
+        }
+
+        if(!packet.size()) {
+            throw std::runtime_error("size() == 0 packets are not supported");
+        }
+
+        /* Does it still fit in this block? */
+        size_t needed = lengthPrefixSize(packet.size()) + packet.size();
+        size_t available = (size_t)(numSymbols_ - symbolsLoaded_) * symbolSize_ - currentSymbol_.size();
+
+        if(needed > available) {
+            if(!symbolsLoaded_ && !currentSymbol_.size()) {
+                throw std::runtime_error("Datagram does not fit in a block");
+            }
+            return false;
+        }
+
+        /* Length prefix */
+        size_t length = packet.size();
+        do {
+            uint8_t lengthByte = length & 0x7F;
+            length >>= 7;
+            if(length) {
+                lengthByte |= 0x80;
+            }
+            append(&lengthByte, 1);
+        } while(length);
+
+        append(packet.data(), packet.size());
+
+        return true;
+    }
+
+    void flush() {
+        if(!isEncoder_) {
+            return;
+        }
+
+        /* The last symbol is simply shorter, the parity length does not change */
+        if(currentSymbol_.size()) {
+            loadSymbol();
+        }
+
+        if(symbolsLoaded_) {
+            fec_.flush();
+        }
+    }
+
+    unsigned int requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+        if(isEncoder_) {
+            return fec_.requestPackets(outputPackets, numPackets);
+        }
+
+        unsigned int count = 0;
+        for(count = 0; count < numPackets; count++) {
+            std::vector<uint8_t> datagram;
+            if(!operator>>(datagram)) {
+                break;
+            }
+            outputPackets.push_back(std::move(datagram));
+        }
+
+        return count;
+    }
+
+    bool operator>>(std::vector<uint8_t>& outputPacket) {
+        if(isEncoder_) {
+            std::vector<std::vector<uint8_t>> tmp;
+            if(fec_.requestPackets(tmp, 1)) {
+                outputPacket = std::move(tmp[0]);
+                return true;
+            }
+            return false;
+        }
+
+        /* Unpack symbols until a complete datagram is available */
+        std::vector<uint8_t> symbol;
+        while(!datagrams_.size() && fec_ >> symbol) {
+            unpackSymbol(symbol);
+        }
+
+        if(!datagrams_.size()) {
+            return false;
+        }
+
+        outputPacket = std::move(datagrams_.front());
+        datagrams_.pop_front();
+
+        return true;
+    }
+
+    void schedulePackets(unsigned int numPackets) {
+        fec_.schedulePackets(numPackets);
+    }
+
+    bool step(unsigned int maxWork) {
+        return fec_.step(maxWork);
+    }
+
+private:
+    /* A block holds at most this many symbols, GF(2^8) */
+    static const unsigned int MAX_SYMBOLS = 256;
+
+    static unsigned int lengthPrefixSize(size_t length) {
+        unsigned int size = 1;
+        while(length >>= 7) {
+            size++;
+        }
+        return size;
+    }
+
+    void loadSymbol() {
+        fec_ << currentSymbol_;
+        symbolsLoaded_++;
+        currentSymbol_.clear();
+    }
+
+    void append(const uint8_t* data, size_t length) {
+        while(length) {
+            size_t chunk = std::min<size_t>(length, symbolSize_ - currentSymbol_.size());
+            currentSymbol_.insert(currentSymbol_.end(), data, data + chunk);
+            data += chunk;
+            length -= chunk;
+
+            if(currentSymbol_.size() == symbolSize_) {
+                loadSymbol();
+            }
+        }
+    }
+
+    void unpackSymbol(const std::vector<uint8_t>& symbol) {
+        /* Only the last symbol of a block is shorter */
+        if(!blockSymbolSize_) {
+            blockSymbolSize_ = symbol.size();
+        }
+
+        size_t index = 0;
+
+        while(index < symbol.size() && !blockCorrupt_) {
+            if(readingLength_) {
+                uint8_t lengthByte = symbol[index++];
+                if(partialLengthShift_ < 8 * sizeof(size_t)) {
+                    partialLength_ |= (size_t)(lengthByte & 0x7F) << partialLengthShift_;
+                }
+                partialLengthShift_ += 7;
+
+                if(!(lengthByte & 0x80)) {
+                    readingLength_ = false;
+
+                    /*
+                     * The length comes from the wire: a datagram never has 0 bytes and never
+                     * extends past the end of the block. Anything else means the rest of the
+                     * block can't be parsed, it is dropped.
+                     */
+                    size_t left = (size_t)MAX_SYMBOLS * blockSymbolSize_ - (blockBytesUnpacked_ + index);
+                    if(!partialLength_ || partialLengthShift_ > 8 * sizeof(size_t) || partialLength_ > left) {
+                        blockCorrupt_ = true;
+                    }
+                }
+                continue;
+            }
+
+            size_t chunk = std::min<size_t>(symbol.size() - index, partialLength_ - partialDatagram_.size());
+            partialDatagram_.insert(partialDatagram_.end(), symbol.begin() + index, symbol.begin() + index + chunk);
+            index += chunk;
+
+            if(partialDatagram_.size() == partialLength_) {
+                datagrams_.push_back(std::move(partialDatagram_));
+                partialDatagram_.clear();
+                partialLength_ = 0;
+                partialLengthShift_ = 0;
+                readingLength_ = true;
+            }
+        }
+
+        blockBytesUnpacked_ += symbol.size();
+    }
+
+    CauchyFEC fec_;
+    bool isEncoder_;
+    unsigned int numSymbols_;
+    unsigned int symbolSize_;
+
+    /* Encoder */
+    unsigned int symbolsLoaded_;
+    std::vector<uint8_t> currentSymbol_;
+
+    /* Decoder */
+    std::deque<std::vector<uint8_t>> datagrams_;
+    std::vector<uint8_t> partialDatagram_;
+    size_t partialLength_;
+    unsigned int partialLengthShift_;
+    bool readingLength_;
+    size_t blockSymbolSize_;
+    size_t blockBytesUnpacked_;
+    bool blockCorrupt_;
+};
+
+CauchyFECPacker::CauchyFECPacker():
+    impl_(new impl()) {
+}
+
+void CauchyFECPacker::reset(bool encode, unsigned int numberOfSymbols, unsigned int symbolSize) {
+    impl_->reset(encode, numberOfSymbols, symbolSize);
+}
+
+bool CauchyFECPacker::operator<<(const std::vector<uint8_t>& packet) {
+    return impl_->operator<<(packet);
+}
+
+void CauchyFECPacker::flush() {
+    impl_->flush();
+}
+
+unsigned int CauchyFECPacker::requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+    return impl_->requestPackets(outputPackets, numPackets);
+}
+
+bool CauchyFECPacker::operator>>(std::vector<uint8_t>& outputPacket) {
+    return impl_->operator>>(outputPacket);
+}
+
+void CauchyFECPacker::schedulePackets(unsigned int numPackets) {
+    impl_->schedulePackets(numPackets);
+}
+
+bool CauchyFECPacker::step(unsigned int maxWork) {
+    return impl_->step(maxWork);
+}
+
+CauchyFECPacker::~CauchyFECPacker() = default;
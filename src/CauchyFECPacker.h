@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <memory>
+#include "CauchyFEC.h"
+
+#ifndef CAUCHYFECPACKER_H_
+#define CAUCHYFECPACKER_H_
+
+/*
+ * Packs a stream of variable length datagrams into symbols of a fixed size before
+ * protecting them with CauchyFEC. Every datagram is preceded by its length (7 bits per
+ * byte, high bit set when more bytes follow) and may span symbol boundaries, so the
+ * parity only grows with the real amount of data in the block.
+ */
+class CauchyFECPacker {
+public:
+    CAUCHYFEC_H_EXPORT_FUNCTION CauchyFECPacker();
+    CAUCHYFEC_H_EXPORT_FUNCTION ~CauchyFECPacker();
+
+    void CAUCHYFEC_H_EXPORT_FUNCTION reset(bool encode, unsigned int numberOfSymbols = 0, unsigned int symbolSize = 0);
+
+    /* Encoder: returns false if the datagram does not fit in the block anymore */
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<uint8_t>& packet);
+    void CAUCHYFEC_H_EXPORT_FUNCTION flush();
+    unsigned int CAUCHYFEC_H_EXPORT_FUNCTION requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets = 1);
+
+    /* Decoder: returns the next datagram */
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<uint8_t>& outputPacket);
+
+    void CAUCHYFEC_H_EXPORT_FUNCTION schedulePackets(unsigned int numPackets);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION step(unsigned int maxWork);
+
+private:
+    class impl;
+    std::unique_ptr<impl> impl_;
+};
+
+#endif /* CAUCHYFECPACKER_H_ */
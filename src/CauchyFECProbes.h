@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * USDT probes, provider "cauchyfec". A probe is a single nop plus an ELF note describing
+ * where its arguments live, so it costs nothing until bpftrace or perf attaches to it:
+ *
+ *   bpftrace -e 'usdt:./liberasure.so:cauchyfec:decode_end { @[arg2] = count(); }'
+ *
+ * <sys/sdt.h> is used when it is installed. Without it the same notes are emitted here for
+ * x86-64, where all arguments are passed as 64 bit values. On other targets, or when built
+ * with -DCAUCHYFEC_NO_PROBES, the probes compile to nothing.
+ */
+
+#ifndef CAUCHYFECPROBES_H_
+#define CAUCHYFECPROBES_H_
+
+#if !defined(CAUCHYFEC_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CAUCHYFEC_PROBES_SDT
+#endif
+#endif
+
+#if defined(CAUCHYFEC_PROBES_SDT)
+
+#define CAUCHYFEC_PROBE1(name, a) DTRACE_PROBE1(cauchyfec, name, a)
+#define CAUCHYFEC_PROBE2(name, a, b) DTRACE_PROBE2(cauchyfec, name, a, b)
+#define CAUCHYFEC_PROBE3(name, a, b, c) DTRACE_PROBE3(cauchyfec, name, a, b, c)
+
+#elif !defined(CAUCHYFEC_NO_PROBES) && defined(__x86_64__) && defined(__GNUC__)
+
+/* Same layout as <sys/sdt.h>: a version 3 stapsdt note and the .stapsdt.base anchor */
+#define CAUCHYFEC_PROBE_ASM(name, args, ...)                                        \
+    __asm__ __volatile__ (                                                          \
+        "990: nop\n"                                                                \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n"                               \
+        ".balign 4\n"                                                               \
+        ".4byte 992f-991f, 994f-993f, 3\n"                                          \
+        "991: .asciz \"stapsdt\"\n"                                                 \
+        "992: .balign 4\n"                                                          \
+        "993: .8byte 990b\n"                                                        \
+        ".8byte _.stapsdt.base\n"                                                   \
+        ".8byte 0\n"                                                                \
+        ".asciz \"cauchyfec\"\n"                                                    \
+        ".asciz \"" #name "\"\n"                                                    \
+        ".asciz \"" args "\"\n"                                                     \
+        "994: .balign 4\n"                                                          \
+        ".popsection\n"                                                             \
+        ".ifndef _.stapsdt.base\n"                                                  \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"     \
+        ".weak _.stapsdt.base\n"                                                    \
+        ".hidden _.stapsdt.base\n"                                                  \
+        "_.stapsdt.base: .space 1\n"                                                \
+        ".size _.stapsdt.base, 1\n"                                                 \
+        ".popsection\n"                                                             \
+        ".endif\n"                                                                  \
+        :: __VA_ARGS__)
+
+#define CAUCHYFEC_PROBE_ARG(x) "nor"((long long)(x))
+
+#define CAUCHYFEC_PROBE1(name, a) \
+    CAUCHYFEC_PROBE_ASM(name, "-8@%0", CAUCHYFEC_PROBE_ARG(a))
+#define CAUCHYFEC_PROBE2(name, a, b) \
+    CAUCHYFEC_PROBE_ASM(name, "-8@%0 -8@%1", CAUCHYFEC_PROBE_ARG(a), CAUCHYFEC_PROBE_ARG(b))
+#define CAUCHYFEC_PROBE3(name, a, b, c) \
+    CAUCHYFEC_PROBE_ASM(name, "-8@%0 -8@%1 -8@%2", CAUCHYFEC_PROBE_ARG(a), CAUCHYFEC_PROBE_ARG(b), CAUCHYFEC_PROBE_ARG(c))
+
+#else
+
+#define CAUCHYFEC_PROBE1(name, a) do { } while(0)
+#define CAUCHYFEC_PROBE2(name, a, b) do { } while(0)
+#define CAUCHYFEC_PROBE3(name, a, b, c) do { } while(0)
+
+#endif
+
+#endif /* CAUCHYFECPROBES_H_ */
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CauchyFECImpl.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+/* Every counter of Stats, lastStuckReason is kept separately */
+static uint64_t CauchyFEC::Stats::* const statsCounters[] = {
+    &CauchyFEC::Stats::packetsIn,
+    &CauchyFEC::Stats::packetsOut,
+    &CauchyFEC::Stats::parityGenerated,
+    &CauchyFEC::Stats::parityConsumed,
+    &CauchyFEC::Stats::duplicatesDropped,
+    &CauchyFEC::Stats::foreignPacketsIgnored,
+    &CauchyFEC::Stats::decodeAttempts,
+    &CauchyFEC::Stats::decodeSuccesses,
+    &CauchyFEC::Stats::decodeFailures,
+    &CauchyFEC::Stats::stuckBlocks,
+    &CauchyFEC::Stats::nsMessageMatrix,
+    &CauchyFEC::Stats::nsGenerator,
+    &CauchyFEC::Stats::nsInversion,
+    &CauchyFEC::Stats::nsMultiply,
+    &CauchyFEC::Stats::bytesAllocated,
+};
+
+static const unsigned int numStatsCounters = sizeof(statsCounters) / sizeof(statsCounters[0]);
+
+static std::atomic<bool> globalEnabled(false);
+static std::atomic<uint64_t> globalCounters[numStatsCounters];
+static std::atomic<int> globalLastStuckReason(CauchyFEC::STUCK_NONE);
+
+bool CauchyFEC::impl::globalStatsEnabled() {
+    return globalEnabled.load(std::memory_order_relaxed);
+}
+
+void CauchyFEC::impl::enableGlobalStats(bool enable) {
+    globalEnabled.store(enable, std::memory_order_relaxed);
+}
+
+void CauchyFEC::impl::getGlobalStats(Stats& stats) {
+    for(unsigned int i = 0; i < numStatsCounters; i++) {
+        stats.*statsCounters[i] = globalCounters[i].load(std::memory_order_relaxed);
+    }
+    stats.lastStuckReason = (StuckReason)globalLastStuckReason.load(std::memory_order_relaxed);
+}
+
+uint64_t CauchyFEC::impl::statsNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CauchyFEC::impl::clearStats() {
+    /* Counts that were not added to the aggregate yet are kept there */
+    statsFold();
+    memset(&stats_, 0, sizeof(stats_));
+    stats_.lastStuckReason = STUCK_NONE;
+    statsFolded_ = stats_;
+}
+
+void CauchyFEC::impl::statsFold() {
+    /* Counts made while the aggregate is off are skipped, not added when it is turned on again */
+    if(!statsGlobal_ || !globalStatsEnabled()) {
+        statsFolded_ = stats_;
+        return;
+    }
+
+    for(unsigned int i = 0; i < numStatsCounters; i++) {
+        uint64_t delta = stats_.*statsCounters[i] - statsFolded_.*statsCounters[i];
+        if(delta) {
+            globalCounters[i].fetch_add(delta, std::memory_order_relaxed);
+        }
+    }
+    if(stats_.stuckBlocks != statsFolded_.stuckBlocks) {
+        globalLastStuckReason.store(stats_.lastStuckReason, std::memory_order_relaxed);
+    }
+
+    statsFolded_ = stats_;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CauchyFECImpl.h"
+#include <stdexcept>
+#include <algorithm>
+
+template <typename GF> static int locateSource(const std::vector<uint16_t>& syndrome, const Matrix<uint16_t>& generator) {
+    /*
+     * An error e in source packet i gives syndrome g(j, i) * e in every parity row j. Only
+     * a single source packet may explain the syndrome, or the location is unknown.
+     */
+    int found = -1;
+
+    for(unsigned int source = 0; source < generator.columns(); source++) {
+        GF error = 0;
+        bool match = true;
+
+        for(unsigned int row = 0; row < generator.rows() && match; row++) {
+            GF coefficient = generator(row, source);
+            GF value = syndrome[row];
+
+            if(!coefficient) {
+                match = !value;
+            } else if(!error) {
+                error = value / coefficient;
+                match = !!error;
+            } else {
+                match = (value == error * coefficient);
+            }
+        }
+
+        if(match && error) {
+            if(found >= 0) {
+                return -1;
+            }
+            found = source;
+        }
+    }
+
+    return found;
+}
+
+static bool isZero(const uint8_t* data, size_t len) {
+    uint8_t acc = 0;
+    for(size_t i = 0; i < len; i++) {
+        acc |= data[i];
+    }
+    return !acc;
+}
+
+bool CauchyFEC::impl::verify(const std::vector<std::vector<uint8_t>>& packets,
+                             std::vector<unsigned int>& inconsistentParity, int& corruptSource) {
+    inconsistentParity.clear();
+    corruptSource = -1;
+
+    /* Sort the block out by index */
+    unsigned int blockSourcePackets = 0;
+    Generator blockGenerator = GENERATOR_CAUCHY;
+    std::vector<const std::vector<uint8_t>*> sources;
+    std::vector<const std::vector<uint8_t>*> parity;
+    std::vector<unsigned int> parityRows;
+
+    for(auto& packet: packets) {
+        if(packet.size() <= trailerSize()) {
+            throw std::runtime_error("Not an encoded packet");
+        }
+
+        unsigned int index, sourcePackets;
+        readTrailer(packet, index, sourcePackets);
+
+        Generator generator;
+        if(!readGenerator(packet, generator)) {
+            throw std::runtime_error("Unknown generator");
+        }
+
+        if(!blockSourcePackets) {
+            blockSourcePackets = sourcePackets;
+            blockGenerator = generator;
+            sources.assign(blockSourcePackets, nullptr);
+        } else if(sourcePackets != blockSourcePackets || generator != blockGenerator) {
+            throw std::runtime_error("Packets from different blocks");
+        }
+
+        if(index < blockSourcePackets) {
+            sources[index] = &packet;
+        } else {
+            parity.push_back(&packet);
+            parityRows.push_back(index);
+        }
+    }
+
+    if(std::find(sources.begin(), sources.end(), nullptr) != sources.end()) {
+        throw std::runtime_error("All source packets are needed");
+    }
+
+    if(parity.empty()) {
+        return true;
+    }
+
+    /* Parity packets all have the padded length of the longest source packet */
+    size_t parityLength = parity[0]->size() - trailerSize();
+    if(parityLength < lengthSize() || alignLength(parityLength) != parityLength) {
+        throw std::runtime_error("Invalid parity packet");
+    }
+    size_t dataLength = parityLength - lengthSize();
+
+    std::vector<unsigned int> checked;
+    for(unsigned int i = 0; i < parity.size(); i++) {
+        if(parity[i]->size() - trailerSize() == parityLength) {
+            checked.push_back(i);
+        } else {
+            inconsistentParity.push_back(parityRows[i]);
+        }
+    }
+
+    /* A source packet that does not fit in the parity explains every mismatch */
+    for(unsigned int source = 0; source < blockSourcePackets; source++) {
+        if(sources[source]->size() - trailerSize() > dataLength) {
+            for(auto i: checked) {
+                inconsistentParity.push_back(parityRows[i]);
+            }
+            std::sort(inconsistentParity.begin(), inconsistentParity.end());
+            corruptSource = source;
+            return false;
+        }
+    }
+
+    Matrix<Coefficient> generator(checked.size(), blockSourcePackets);
+    for(unsigned int j = 0; j < checked.size(); j++) {
+        Matrix<Coefficient> generatorRow = generator[j];
+        getGeneratorRow(generatorRow, parityRows[checked[j]], blockSourcePackets, blockGenerator);
+    }
+
+    /*
+     * The syndrome (parity minus the parity of the source packets) is built one chunk of
+     * columns at a time. Each chunk of a source packet is fetched once and added into
+     * every syndrome row, and nothing the size of a packet is allocated. The length field is the last chunk.
+     */
+    std::vector<std::vector<uint8_t>> syndrome(checked.size(), std::vector<uint8_t>(std::min(parityLength, chunkSize())));
+    std::vector<bool> mismatch(checked.size(), false);
+    std::vector<uint16_t> syndromeElements;
+
+    size_t offset = 0;
+    while(offset < parityLength) {
+        size_t end = (offset < dataLength)? std::min(dataLength, offset + chunkSize()) : parityLength;
+
+        for(unsigned int j = 0; j < checked.size(); j++) {
+            auto& parityPacket = *parity[checked[j]];
+            std::copy(parityPacket.begin() + offset, parityPacket.begin() + end, syndrome[j].begin());
+        }
+
+        /* Each source chunk is added into every syndrome row while it is still in cache */
+        for(unsigned int source = 0; source < blockSourcePackets; source++) {
+            size_t sourceLength = sources[source]->size() - trailerSize();
+
+            for(unsigned int j = 0; j < checked.size(); j++) {
+                if(offset == dataLength) {
+                    mulAddLength(syndrome[j].data(), sourceLength, generator(j, source));
+                } else if(sourceLength > offset) {
+                    mulAddRegion(syndrome[j].data(), &(*sources[source])[offset], generator(j, source),
+                                 std::min(sourceLength, end) - offset);
+                }
+            }
+        }
+
+        for(unsigned int j = 0; j < checked.size(); j++) {
+            mismatch[j] = mismatch[j] || !isZero(syndrome[j].data(), end - offset);
+        }
+
+        /* The first column with a non-zero syndrome is used to find the corrupt packet */
+        if(syndromeElements.empty() && std::find(mismatch.begin(), mismatch.end(), true) != mismatch.end()) {
+            size_t elementSize = (field_ == FIELD_GF65536)? 2 : 1;
+
+            for(size_t column = 0; column < end - offset && syndromeElements.empty(); column += elementSize) {
+                for(unsigned int j = 0; j < checked.size(); j++) {
+                    if(!isZero(&syndrome[j][column], elementSize)) {
+                        for(auto& s: syndrome) {
+                            syndromeElements.push_back((elementSize == 2)? ((s[column] << 8) | s[column + 1]) : s[column]);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        offset = end;
+    }
+
+    for(unsigned int j = 0; j < checked.size(); j++) {
+        if(mismatch[j]) {
+            inconsistentParity.push_back(parityRows[checked[j]]);
+        }
+    }
+    std::sort(inconsistentParity.begin(), inconsistentParity.end());
+
+    if(!syndromeElements.empty()) {
+        if(field_ == FIELD_GF65536) {
+            corruptSource = locateSource<RSGF65536Number>(syndromeElements, generator);
+        } else {
+            corruptSource = locateSource<RSGF256Number>(syndromeElements, generator);
+        }
+    }
+
+    return inconsistentParity.empty();
+}
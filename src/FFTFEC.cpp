@@ -0,0 +1,564 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FFTFEC.h"
+#include "AdditiveFFT.h"
+#include <algorithm>
+#include <stdexcept>
+
+using FFT256 = AdditiveFFT<8, 0x11D>;
+using FFT65536 = AdditiveFFT<16, 0x1002D>;
+
+class FFTFEC::impl {
+public:
+    static void init() {
+        FFT256::init();
+        FFT65536::init();
+    }
+
+    impl() {
+        configuredField_ = CauchyFEC::FIELD_GF256;
+        reset(false, 0, 0);
+    }
+
+    void setField(CauchyFEC::Field field) {
+        configuredField_ = field;
+    }
+
+    void reset(bool encode, unsigned int numberOfSourcePackets, unsigned int numberOfParityPackets) {
+        isEncoder_ = encode;
+        field_ = configuredField_;
+        sourcePackets_.clear();
+        parityPackets_.clear();
+        packetsReturned_ = 0;
+        decoderWaitingFirstPacket_ = true;
+        decoderStuck_ = false;
+        decoderReceived_ = 0;
+        numSourcePackets_ = numberOfSourcePackets;
+        numParityPackets_ = numberOfParityPackets;
+        parityLog2_ = 0;
+        encoderReadingSourcePackets_ = true;
+
+        if(!isEncoder_) {
+            return;
+        }
+
+        if(!numSourcePackets_ || !numParityPackets_) {
+            throw std::runtime_error("At least one source and one parity packet are needed");
+        }
+
+        while((1U << parityLog2_) < numParityPackets_) {
+            parityLog2_++;
+        }
+
+        if(numSourcePackets_ + (1U << parityLog2_) > fieldSize()) {
+            throw std::runtime_error("Too many packets for this field");
+        }
+    }
+
+    void operator<<(const std::vector<uint8_t>& packet) {
+        operator<<(std::vector<uint8_t>(packet));
+    }
+
+    void operator<<(std::vector<uint8_t>&& packet) {
+        if(isEncoder_) {
+            encoderLoad(std::move(packet));
+        } else {
+            decoderLoad(std::move(packet));
+        }
+    }
+
+    void operator<<(const std::vector<std::vector<uint8_t>>& packets) {
+        for(auto& packet: packets) {
+            operator<<(packet);
+        }
+    }
+
+    unsigned int requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+        if(isEncoder_) {
+            return encoderRequestPackets(outputPackets, numPackets);
+        } else {
+            return decoderRequestPackets(outputPackets, numPackets);
+        }
+    }
+
+    bool operator>>(std::vector<uint8_t>& outputPacket) {
+        std::vector<std::vector<uint8_t>> tmp;
+
+        if(requestPackets(tmp, 1)) {
+            outputPacket = std::move(tmp[0]);
+            return true;
+        }
+
+        return false;
+    }
+
+    void flush() {
+        if(!isEncoder_ || sourcePackets_.size() == numSourcePackets_) {
+            return;
+        }
+
+        if(!sourcePackets_.size()) {
+            throw std::runtime_error("At least one source packet is needed");
+        }
+
+        /* Close the block: the code is shortened to the packets loaded so far */
+        numSourcePackets_ = sourcePackets_.size();
+    }
+
+private:
+    /* Parity packets end with the length of the source packet, big endian */
+    static const size_t LENGTH_SIZE = 4;
+
+    bool isEncoder_;
+    CauchyFEC::Field field_;
+    CauchyFEC::Field configuredField_;
+
+    unsigned int numSourcePackets_;
+    unsigned int numParityPackets_;
+    unsigned int parityLog2_;
+    unsigned int packetsReturned_;
+
+    /* Source packets without trailer, parity packets without trailer (but with length) */
+    std::vector<std::vector<uint8_t>> sourcePackets_;
+    std::vector<std::vector<uint8_t>> parityPackets_;
+
+    bool encoderReadingSourcePackets_;
+
+    bool decoderWaitingFirstPacket_;
+    bool decoderStuck_;
+    unsigned int decoderReceived_;
+
+    unsigned int fieldSize() {
+        return (field_ == CauchyFEC::FIELD_GF65536)? 65536 : 256;
+    }
+
+    /* Index, number of source packets and log2 of the transform size */
+    size_t trailerSize() {
+        return (field_ == CauchyFEC::FIELD_GF65536)? 5 : 3;
+    }
+
+    size_t alignLength(size_t length) {
+        if(field_ == CauchyFEC::FIELD_GF65536) {
+            return (length + 1) & ~(size_t)1;
+        }
+        return length;
+    }
+
+    void writeTrailer(std::vector<uint8_t>& packet, unsigned int index) {
+        size_t offset = packet.size();
+        packet.resize(offset + trailerSize());
+
+        if(field_ == CauchyFEC::FIELD_GF65536) {
+            packet[offset++] = index >> 8;
+            packet[offset++] = index;
+            packet[offset++] = (numSourcePackets_ - 1) >> 8;
+            packet[offset++] = numSourcePackets_ - 1;
+        } else {
+            packet[offset++] = index;
+            packet[offset++] = numSourcePackets_ - 1;
+        }
+        packet[offset] = parityLog2_;
+    }
+
+    void readTrailer(const std::vector<uint8_t>& packet, unsigned int& index, unsigned int& sourcePackets, unsigned int& parityLog2) {
+        const uint8_t* trailer = &packet[packet.size() - trailerSize()];
+
+        if(field_ == CauchyFEC::FIELD_GF65536) {
+            index = (trailer[0] << 8) | trailer[1];
+            sourcePackets = ((trailer[2] << 8) | trailer[3]) + 1;
+            parityLog2 = trailer[4];
+        } else {
+            index = trailer[0];
+            sourcePackets = trailer[1] + 1;
+            parityLog2 = trailer[2];
+        }
+    }
+
+    /* Copies a source packet into a transform buffer: data, zero padding and the length */
+    static void loadSymbol(uint8_t* symbol, size_t symbolSize, const std::vector<uint8_t>& packet) {
+        std::copy(packet.begin(), packet.end(), symbol);
+        std::fill(symbol + packet.size(), symbol + symbolSize - LENGTH_SIZE, 0);
+
+        uint32_t length = packet.size();
+        for(unsigned int i = 0; i < LENGTH_SIZE; i++) {
+            symbol[symbolSize - 1 - i] = length >> (8 * i);
+        }
+    }
+
+    static size_t readSymbolLength(const uint8_t* symbol, size_t symbolSize) {
+        size_t length = 0;
+        for(unsigned int i = 0; i < LENGTH_SIZE; i++) {
+            length = (length << 8) | symbol[symbolSize - LENGTH_SIZE + i];
+        }
+        return length;
+    }
+
+    void encoderLoad(std::vector<uint8_t>&& packet) {
+        if(!packet.size()) {
+            throw std::runtime_error("size() == 0 packets are not supported");
+        }
+
+        if(!encoderReadingSourcePackets_) {
+            throw std::runtime_error("Reset required");
+        }
+
+        if(sourcePackets_.size() >= numSourcePackets_) {
+            throw std::runtime_error("Encoder is full");
+        }
+
+        if(packet.size() > 0xFFFFFFFF) {
+            throw std::runtime_error("Packet too large");
+        }
+
+        sourcePackets_.push_back(std::move(packet));
+    }
+
+    template<typename FFT> void encoderCalculateParity() {
+        const unsigned int m = 1U << parityLog2_;
+
+        size_t longest = 0;
+        for(auto& packet: sourcePackets_) {
+            longest = std::max(longest, packet.size());
+        }
+        const size_t symbolSize = alignLength(longest) + LENGTH_SIZE;
+
+        std::vector<uint8_t> work(m * symbolSize), temp(m * symbolSize);
+        std::vector<uint8_t*> workPointers(m), tempPointers(m);
+        for(unsigned int i = 0; i < m; i++) {
+            workPointers[i] = &work[i * symbolSize];
+            tempPointers[i] = &temp[i * symbolSize];
+        }
+
+        /*
+         * The source packets are the evaluations at points m .. m + k - 1, the parity packets
+         * at 0 .. m - 1. Every group of m source packets is transformed separately and the
+         * coefficients are summed.
+         */
+        for(unsigned int first = 0; first < numSourcePackets_; first += m) {
+            std::vector<uint8_t*>& target = first? tempPointers : workPointers;
+
+            for(unsigned int i = 0; i < m; i++) {
+                if(first + i < numSourcePackets_) {
+                    loadSymbol(target[i], symbolSize, sourcePackets_[first + i]);
+                } else {
+                    std::fill(target[i], target[i] + symbolSize, 0);
+                }
+            }
+
+            FFT::ifft(target.data(), symbolSize, m, m + first);
+
+            if(first) {
+                GFRegion::xorRegion(work.data(), temp.data(), work.size());
+            }
+        }
+
+        FFT::fft(workPointers.data(), symbolSize, numParityPackets_, m, 0);
+
+        parityPackets_.resize(numParityPackets_);
+        for(unsigned int i = 0; i < numParityPackets_; i++) {
+            parityPackets_[i].assign(workPointers[i], workPointers[i] + symbolSize);
+        }
+    }
+
+    unsigned int encoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        unsigned int count = 0;
+        for(count = 0; count < numPackets; count++) {
+            if(packetsReturned_ < numSourcePackets_) {
+                /* Are enough source packets loaded? */
+                if(packetsReturned_ >= sourcePackets_.size()) {
+                    break;
+                }
+
+                std::vector<uint8_t> outputPacket(sourcePackets_[packetsReturned_]);
+                writeTrailer(outputPacket, packetsReturned_);
+                packets.push_back(std::move(outputPacket));
+
+            } else if(packetsReturned_ < numSourcePackets_ + numParityPackets_) {
+                if(!parityPackets_.size()) {
+                    if(sourcePackets_.size() < numSourcePackets_) {
+                        break;
+                    }
+
+                    encoderReadingSourcePackets_ = false;
+                    if(field_ == CauchyFEC::FIELD_GF65536) {
+                        encoderCalculateParity<FFT65536>();
+                    } else {
+                        encoderCalculateParity<FFT256>();
+                    }
+                }
+
+                std::vector<uint8_t> outputPacket(std::move(parityPackets_[packetsReturned_ - numSourcePackets_]));
+                writeTrailer(outputPacket, packetsReturned_);
+                packets.push_back(std::move(outputPacket));
+
+            } else {
+                break;
+            }
+
+            packetsReturned_++;
+        }
+
+        return count;
+    }
+
+    void decoderLoad(std::vector<uint8_t>&& packet) {
+        if(decoderStuck_ || packet.size() <= trailerSize()) {
+            return;
+        }
+
+        unsigned int index, announcedSourcePackets, parityLog2;
+        readTrailer(packet, index, announcedSourcePackets, parityLog2);
+        packet.resize(packet.size() - trailerSize());
+
+        if(decoderWaitingFirstPacket_) {
+            unsigned int bits = (field_ == CauchyFEC::FIELD_GF65536)? 16 : 8;
+            if(parityLog2 >= bits || announcedSourcePackets + (1U << parityLog2) > fieldSize()) {
+                return;
+            }
+
+            decoderWaitingFirstPacket_ = false;
+            numSourcePackets_ = announcedSourcePackets;
+            parityLog2_ = parityLog2;
+            sourcePackets_.resize(numSourcePackets_);
+            parityPackets_.resize(1U << parityLog2_);
+        } else {
+            if(parityLog2 != parityLog2_) {
+                return;
+            }
+
+            if(announcedSourcePackets != numSourcePackets_ && !decoderShortenBlock(announcedSourcePackets, index)) {
+                return;
+            }
+        }
+
+        std::vector<uint8_t>* slot;
+        if(index < numSourcePackets_) {
+            slot = &sourcePackets_[index];
+        } else if(index - numSourcePackets_ < parityPackets_.size()) {
+            slot = &parityPackets_[index - numSourcePackets_];
+        } else {
+            return;
+        }
+
+        /* Duplicate? */
+        if(slot->size()) {
+            return;
+        }
+
+        *slot = std::move(packet);
+        decoderReceived_++;
+    }
+
+    bool decoderShortenBlock(unsigned int announcedSourcePackets, unsigned int packetIndex) {
+        /* Source packets of a flushed block are identical in both codes */
+        if(announcedSourcePackets > numSourcePackets_) {
+            return packetIndex < numSourcePackets_;
+        }
+
+        /* Shrink the block, this is only possible if no packet contradicts the shorter code */
+        for(auto& packet: parityPackets_) {
+            if(packet.size()) {
+                return false;
+            }
+        }
+
+        for(unsigned int i = announcedSourcePackets; i < numSourcePackets_; i++) {
+            if(sourcePackets_[i].size()) {
+                return false;
+            }
+        }
+
+        numSourcePackets_ = announcedSourcePackets;
+        sourcePackets_.resize(numSourcePackets_);
+
+        return true;
+    }
+
+    template<typename FFT> bool decoderRecover() {
+        const unsigned int m = 1U << parityLog2_;
+
+        unsigned int n = 1;
+        while(n < m + numSourcePackets_) {
+            n <<= 1;
+        }
+
+        /* All parity packets have the same length, source packets must fit in it */
+        size_t symbolSize = 0;
+        for(auto& packet: parityPackets_) {
+            if(packet.size()) {
+                if(symbolSize && packet.size() != symbolSize) {
+                    return false;
+                }
+                symbolSize = packet.size();
+            }
+        }
+
+        if(symbolSize < LENGTH_SIZE || alignLength(symbolSize) != symbolSize) {
+            return false;
+        }
+
+        std::vector<bool> erased(n);
+        for(unsigned int i = 0; i < m; i++) {
+            erased[i] = !parityPackets_[i].size();
+        }
+        for(unsigned int i = 0; i < numSourcePackets_; i++) {
+            if(sourcePackets_[i].size() > symbolSize - LENGTH_SIZE) {
+                return false;
+            }
+            erased[m + i] = !sourcePackets_[i].size();
+        }
+
+        std::vector<uint32_t> errorLocator;
+        FFT::errorLocator(erased, errorLocator);
+
+        std::vector<uint8_t> work(n * symbolSize);
+        std::vector<uint8_t*> workPointers(n);
+        for(unsigned int i = 0; i < n; i++) {
+            workPointers[i] = &work[i * symbolSize];
+        }
+
+        /* Received symbols, scaled by the error locator. Erased and unused points are zero */
+        for(unsigned int i = 0; i < m; i++) {
+            if(!erased[i]) {
+                std::copy(parityPackets_[i].begin(), parityPackets_[i].end(), workPointers[i]);
+                FFT::mulRegionLog(workPointers[i], errorLocator[i], symbolSize);
+            }
+        }
+        for(unsigned int i = 0; i < numSourcePackets_; i++) {
+            if(!erased[m + i]) {
+                loadSymbol(workPointers[m + i], symbolSize, sourcePackets_[i]);
+                FFT::mulRegionLog(workPointers[m + i], errorLocator[m + i], symbolSize);
+            }
+        }
+
+        FFT::ifft(workPointers.data(), symbolSize, n, 0);
+        FFT::formalDerivative(workPointers.data(), symbolSize, n);
+        FFT::fft(workPointers.data(), symbolSize, m + numSourcePackets_, n, 0);
+
+        /* Validate everything before touching the packet buffer */
+        std::vector<unsigned int> recovered;
+        for(unsigned int i = 0; i < numSourcePackets_; i++) {
+            if(erased[m + i]) {
+                uint8_t* symbol = workPointers[m + i];
+                FFT::mulRegionLog(symbol, FFT::inverseLog(errorLocator[m + i]), symbolSize);
+
+                size_t length = readSymbolLength(symbol, symbolSize);
+                if(!length || length > symbolSize - LENGTH_SIZE) {
+                    return false;
+                }
+                recovered.push_back(i);
+            }
+        }
+
+        for(unsigned int i: recovered) {
+            uint8_t* symbol = workPointers[m + i];
+            sourcePackets_[i].assign(symbol, symbol + readSymbolLength(symbol, symbolSize));
+        }
+
+        return true;
+    }
+
+    unsigned int decoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        unsigned int count = 0;
+        for(count = 0; count < numPackets; count++) {
+            if(decoderStuck_ || decoderWaitingFirstPacket_ || packetsReturned_ >= numSourcePackets_) {
+                break;
+            }
+
+            if(!sourcePackets_[packetsReturned_].size()) {
+                /* This source packet is missing, recover all of them at once */
+                if(decoderReceived_ < numSourcePackets_) {
+                    break;
+                }
+
+                bool success;
+                if(field_ == CauchyFEC::FIELD_GF65536) {
+                    success = decoderRecover<FFT65536>();
+                } else {
+                    success = decoderRecover<FFT256>();
+                }
+
+                if(!success) {
+                    decoderStuck_ = true;
+                    break;
+                }
+            }
+
+            packets.push_back(sourcePackets_[packetsReturned_]);
+            packetsReturned_++;
+        }
+
+        return count;
+    }
+};
+
+void FFTFEC::init() {
+    FFTFEC::impl::init();
+}
+
+FFTFEC::FFTFEC():
+    impl_(new impl()) {
+}
+
+void FFTFEC::setField(CauchyFEC::Field field) {
+    impl_->setField(field);
+}
+
+void FFTFEC::reset(bool encode, unsigned int numberOfSourcePackets, unsigned int numberOfParityPackets) {
+    impl_->reset(encode, numberOfSourcePackets, numberOfParityPackets);
+}
+
+void FFTFEC::operator<<(const std::vector<uint8_t>& sourcePacket) {
+    impl_->operator<<(sourcePacket);
+}
+
+void FFTFEC::operator<<(std::vector<uint8_t>&& sourcePacket) {
+    impl_->operator<<(std::move(sourcePacket));
+}
+
+void FFTFEC::operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets) {
+    impl_->operator<<(sourcePackets);
+}
+
+unsigned int FFTFEC::requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+    return impl_->requestPackets(outputPackets, numPackets);
+}
+
+bool FFTFEC::operator>>(std::vector<uint8_t>& outputPacket) {
+    return impl_->operator>>(outputPacket);
+}
+
+bool FFTFEC::operator>>(std::vector<std::vector<uint8_t>>& outputPackets) {
+    return impl_->requestPackets(outputPackets, 1) > 0;
+}
+
+void FFTFEC::flush() {
+    impl_->flush();
+}
+
+FFTFEC::~FFTFEC() = default;
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <memory>
+#include "CauchyFEC.h"
+
+#ifndef FFTFEC_H_
+#define FFTFEC_H_
+
+/*
+ * Systematic Reed-Solomon code based on the additive FFT, for blocks that are too large
+ * for the Cauchy matrix code: encoding and decoding take O(n log n) operations per byte
+ * instead of O(k * m) and O(k^3). The number of parity packets is fixed at reset(), it is
+ * rounded up to a power of two m internally and m + k must fit in the field. The wire
+ * format is not compatible with CauchyFEC.
+ */
+class FFTFEC {
+public:
+    static CAUCHYFEC_H_EXPORT_FUNCTION void init();
+    CAUCHYFEC_H_EXPORT_FUNCTION FFTFEC();
+    CAUCHYFEC_H_EXPORT_FUNCTION ~FFTFEC();
+
+    /* Takes effect at the next reset() */
+    void CAUCHYFEC_H_EXPORT_FUNCTION setField(CauchyFEC::Field field);
+
+    void CAUCHYFEC_H_EXPORT_FUNCTION reset(bool encode, unsigned int numberOfSourcePackets = 0, unsigned int numberOfParityPackets = 0);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<uint8_t>& sourcePacket);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(std::vector<uint8_t>&& sourcePacket);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets);
+    unsigned int CAUCHYFEC_H_EXPORT_FUNCTION requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets = 1);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<uint8_t>& outputPackets);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<std::vector<uint8_t>>& outputPackets);
+
+    /* Encoder: close the block with the source packets loaded so far */
+    void CAUCHYFEC_H_EXPORT_FUNCTION flush();
+
+private:
+    class impl;
+    std::unique_ptr<impl> impl_;
+};
+
+#endif /* FFTFEC_H_ */
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FIXEDCAUCHYCODEC_H_
+#define FIXEDCAUCHYCODEC_H_
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include "GFRegion.h"
+
+/*
+ * Header only encoder for a fixed number of source (K) and parity (M) packets. The field
+ * tables, generator coefficients and multiplication tables are all calculated at compile
+ * time and the loops over K and M are unrolled. The output is identical to what CauchyFEC
+ * produces (GF(2^8), 16 bit lengths), so CauchyFEC can decode it.
+ */
+namespace FixedCauchy {
+
+/* Same field as GF256Number<> */
+static constexpr uint16_t POLYNOMIAL = 0x18b;
+static constexpr uint8_t GENERATOR = 0x87;
+
+struct FieldTables {
+    uint8_t exp[512];
+    uint8_t log[256];
+};
+
+constexpr uint8_t mulSlow(uint8_t a, uint8_t b) {
+    uint16_t result = 0;
+
+    for(unsigned int i = 0; i < 8; i++) {
+        if(b & (1 << i)) {
+            result ^= a << i;
+        }
+    }
+
+    for(unsigned int i = 15; i >= 8; i--) {
+        if(result & (1 << i)) {
+            result ^= POLYNOMIAL << (i - 8);
+        }
+    }
+
+    return result;
+}
+
+constexpr FieldTables buildFieldTables() {
+    FieldTables tables = {};
+
+    tables.exp[0] = 1;
+    for(unsigned int i = 1; i < 512; i++) {
+        tables.exp[i] = mulSlow(tables.exp[i - 1], GENERATOR);
+    }
+    for(unsigned int i = 0; i < 255; i++) {
+        tables.log[tables.exp[i]] = i;
+    }
+
+    return tables;
+}
+
+static constexpr FieldTables fieldTables = buildFieldTables();
+
+constexpr uint8_t mul(uint8_t a, uint8_t b) {
+    return (a && b)? fieldTables.exp[fieldTables.log[a] + fieldTables.log[b]] : 0;
+}
+
+constexpr uint8_t inverse(uint8_t a) {
+    return fieldTables.exp[255 - fieldTables.log[a]];
+}
+
+/* Same construction as CauchyFEC::impl::getGeneratorRow */
+constexpr uint8_t generatorCoefficient(unsigned int row, unsigned int col, unsigned int sourcePackets) {
+    if(row < sourcePackets) {
+        return (row == col)? 1 : 0;
+    }
+
+    if(row == sourcePackets) {
+        return 1;
+    }
+
+    return inverse((255 - row) ^ (255 - sourcePackets + col + 1));
+}
+
+template <unsigned int K, unsigned int M> struct CodecTables {
+    uint8_t coefficients[M][K];
+    uint8_t nibbles[M][K][2][16];
+};
+
+template <unsigned int K, unsigned int M> constexpr CodecTables<K, M> buildCodecTables() {
+    CodecTables<K, M> tables = {};
+
+    for(unsigned int j = 0; j < M; j++) {
+        for(unsigned int s = 0; s < K; s++) {
+            uint8_t c = generatorCoefficient(K + j, s, K);
+            tables.coefficients[j][s] = c;
+
+            for(unsigned int i = 0; i < 16; i++) {
+                tables.nibbles[j][s][0][i] = mul(c, i);
+                tables.nibbles[j][s][1][i] = mul(c, i << 4);
+            }
+        }
+    }
+
+    return tables;
+}
+
+}
+
+template <unsigned int K, unsigned int M> class FixedCauchyCodec {
+    static_assert(K >= 1, "At least one source packet is needed");
+    static_assert(K + M <= 256, "Can't generate more packets");
+
+public:
+    /* Appends the trailer to a source packet, this is packet 'index' of the block */
+    static void sourcePacket(const std::vector<uint8_t>& input, unsigned int index, std::vector<uint8_t>& output) {
+        if(!input.size()) {
+            throw std::runtime_error("size() == 0 packets are not supported");
+        }
+
+        output.resize(input.size() + 2);
+        std::copy(input.begin(), input.end(), output.begin());
+        output[input.size()] = index;
+        output[input.size() + 1] = K - 1;
+    }
+
+    /* Calculates the M parity packets (with trailer) for exactly K source packets */
+    static void encode(const std::vector<std::vector<uint8_t>>& sources, std::vector<std::vector<uint8_t>>& parity) {
+        const uint8_t* sourcePointers[K];
+        size_t lengths[K];
+        size_t longest = 0;
+
+        if(sources.size() != K) {
+            throw std::runtime_error("Exactly K source packets are needed");
+        }
+
+        for(unsigned int s = 0; s < K; s++) {
+            sourcePointers[s] = sources[s].data();
+            lengths[s] = sources[s].size();
+            if(lengths[s] > longest) {
+                longest = lengths[s];
+            }
+        }
+
+        parity.resize(M);
+        uint8_t* parityPointers[M];
+        for(unsigned int j = 0; j < M; j++) {
+            parity[j].resize(parityLength(longest));
+            parityPointers[j] = parity[j].data();
+        }
+
+        encode(sourcePointers, lengths, parityPointers);
+    }
+
+    static size_t parityLength(size_t longestSource) {
+        return longestSource + 4;
+    }
+
+    /* Every parity buffer must hold parityLength(longest source) bytes */
+    static void encode(const uint8_t* const sources[K], const size_t lengths[K], uint8_t* const parity[M]) {
+        size_t shortest = lengths[0];
+        size_t longest = lengths[0];
+        for(unsigned int s = 1; s < K; s++) {
+            shortest = std::min(shortest, lengths[s]);
+            longest = std::max(longest, lengths[s]);
+        }
+
+        /* The length field holds two bytes, a length of 0 marks a missing packet */
+        if(!shortest) {
+            throw std::runtime_error("size() == 0 packets are not supported");
+        }
+        if(longest > 0xFFFF) {
+            throw std::runtime_error("Packet too large");
+        }
+
+        /* Columns that all sources have are processed with the unrolled kernel */
+        size_t done = 0;
+#ifdef GFREGION_X86
+        switch(GFRegion::kernelLevel()) {
+        case GFRegion::KERNEL_AVX2:
+            done = encodeAVX2(sources, parity, shortest);
+            break;
+        case GFRegion::KERNEL_SSSE3:
+            done = encodeSSSE3(sources, parity, shortest);
+            break;
+        default:
+            break;
+        }
+#endif
+        encodeScalar(sources, parity, done, shortest);
+
+        /* The rest only covers the sources that are long enough, padding is never multiplied */
+        for(unsigned int j = 0; j < M; j++) {
+            std::fill(parity[j] + shortest, parity[j] + longest + 2, 0);
+
+            for(unsigned int s = 0; s < K; s++) {
+                if(lengths[s] > shortest) {
+                    GFRegion::mulAdd8(parity[j] + shortest, sources[s] + shortest,
+                                      tables_.nibbles[j][s], lengths[s] - shortest);
+                }
+
+                parity[j][longest] ^= FixedCauchy::mul(tables_.coefficients[j][s], lengths[s] >> 8);
+                parity[j][longest + 1] ^= FixedCauchy::mul(tables_.coefficients[j][s], lengths[s] & 0xFF);
+            }
+
+            parity[j][longest + 2] = K + j;
+            parity[j][longest + 3] = K - 1;
+        }
+    }
+
+private:
+    static constexpr FixedCauchy::CodecTables<K, M> tables_ = FixedCauchy::buildCodecTables<K, M>();
+
+    static void encodeScalar(const uint8_t* const sources[K], uint8_t* const parity[M], size_t start, size_t end) {
+        for(size_t i = start; i < end; i++) {
+            uint8_t acc[M] = {};
+
+            for(unsigned int s = 0; s < K; s++) {
+                uint8_t in = sources[s][i];
+                for(unsigned int j = 0; j < M; j++) {
+                    acc[j] ^= tables_.nibbles[j][s][0][in & 0xF] ^ tables_.nibbles[j][s][1][in >> 4];
+                }
+            }
+
+            for(unsigned int j = 0; j < M; j++) {
+                parity[j][i] = acc[j];
+            }
+        }
+    }
+
+#ifdef GFREGION_X86
+    __attribute__((target("ssse3")))
+    static size_t encodeSSSE3(const uint8_t* const sources[K], uint8_t* const parity[M], size_t len) {
+        const __m128i mask = _mm_set1_epi8(0x0F);
+
+        size_t i = 0;
+        for(; i + 16 <= len; i += 16) {
+            __m128i acc[M];
+            for(unsigned int j = 0; j < M; j++) {
+                acc[j] = _mm_setzero_si128();
+            }
+
+            for(unsigned int s = 0; s < K; s++) {
+                __m128i in = _mm_loadu_si128((const __m128i*)(sources[s] + i));
+                __m128i lo = _mm_and_si128(in, mask);
+                __m128i hi = _mm_and_si128(_mm_srli_epi64(in, 4), mask);
+
+                for(unsigned int j = 0; j < M; j++) {
+                    if(tables_.coefficients[j][s] == 1) {
+                        acc[j] = _mm_xor_si128(acc[j], in);
+                        continue;
+                    }
+
+                    __m128i tableLo = _mm_loadu_si128((const __m128i*)tables_.nibbles[j][s][0]);
+                    __m128i tableHi = _mm_loadu_si128((const __m128i*)tables_.nibbles[j][s][1]);
+                    acc[j] = _mm_xor_si128(acc[j], _mm_xor_si128(_mm_shuffle_epi8(tableLo, lo), _mm_shuffle_epi8(tableHi, hi)));
+                }
+            }
+
+            for(unsigned int j = 0; j < M; j++) {
+                _mm_storeu_si128((__m128i*)(parity[j] + i), acc[j]);
+            }
+        }
+
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    static size_t encodeAVX2(const uint8_t* const sources[K], uint8_t* const parity[M], size_t len) {
+        const __m256i mask = _mm256_set1_epi8(0x0F);
+
+        size_t i = 0;
+        for(; i + 32 <= len; i += 32) {
+            __m256i acc[M];
+            for(unsigned int j = 0; j < M; j++) {
+                acc[j] = _mm256_setzero_si256();
+            }
+
+            for(unsigned int s = 0; s < K; s++) {
+                __m256i in = _mm256_loadu_si256((const __m256i*)(sources[s] + i));
+                __m256i lo = _mm256_and_si256(in, mask);
+                __m256i hi = _mm256_and_si256(_mm256_srli_epi64(in, 4), mask);
+
+                for(unsigned int j = 0; j < M; j++) {
+                    if(tables_.coefficients[j][s] == 1) {
+                        acc[j] = _mm256_xor_si256(acc[j], in);
+                        continue;
+                    }
+
+                    __m256i tableLo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables_.nibbles[j][s][0]));
+                    __m256i tableHi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables_.nibbles[j][s][1]));
+                    acc[j] = _mm256_xor_si256(acc[j], _mm256_xor_si256(_mm256_shuffle_epi8(tableLo, lo), _mm256_shuffle_epi8(tableHi, hi)));
+                }
+            }
+
+            for(unsigned int j = 0; j < M; j++) {
+                _mm256_storeu_si256((__m256i*)(parity[j] + i), acc[j]);
+            }
+        }
+
+        return i;
+    }
+#endif
+};
+
+template <unsigned int K, unsigned int M> constexpr FixedCauchy::CodecTables<K, M> FixedCauchyCodec<K, M>::tables_;
+
+#endif /* FIXEDCAUCHYCODEC_H_ */
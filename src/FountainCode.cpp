@@ -0,0 +1,493 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FountainCode.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <mutex>
+
+static uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static bool isPrime(unsigned int n) {
+    if(n < 2) {
+        return false;
+    }
+    for(unsigned int i = 2; i * i <= n; i++) {
+        if(n % i == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* LT degree distribution of RFC 5053, as thresholds out of 2^20 */
+static unsigned int ltDegree(uint32_t v) {
+    static const uint32_t thresholds[] = { 10241, 491582, 712794, 831695, 948446, 1032189 };
+    static const unsigned int degrees[] = { 1, 2, 3, 4, 10, 11 };
+
+    for(unsigned int i = 0; i < 6; i++) {
+        if(v < thresholds[i]) {
+            return degrees[i];
+        }
+    }
+    return 40;
+}
+
+FountainCode::FountainCode(unsigned int sourceSymbols, uint32_t seed) {
+    k_ = sourceSymbols;
+    seed_ = seed;
+
+    /* LDPC symbols as in RFC 5053: about 1% plus sqrt(2k), rounded up to a prime */
+    unsigned int x = 1;
+    while(x * (x - 1) < 2 * k_) {
+        x++;
+    }
+    s_ = std::max(3U, (k_ + 99) / 100 + x);
+    while(!isPrime(s_)) {
+        s_++;
+    }
+
+    h_ = HDPC_SYMBOLS;
+    l_ = k_ + s_ + h_;
+}
+
+void FountainCode::encodingRow(uint32_t esi, std::vector<uint32_t>& columns) const {
+    uint64_t state = ((uint64_t)seed_ << 32) ^ esi;
+    splitMix64(state);
+
+    /* LT part over the source and LDPC columns */
+    const unsigned int ltColumns = k_ + s_;
+    unsigned int degree = std::min(ltDegree(splitMix64(state) & 0xFFFFF), ltColumns);
+
+    columns.clear();
+    while(columns.size() < degree) {
+        uint32_t column = splitMix64(state) % ltColumns;
+        if(std::find(columns.begin(), columns.end(), column) == columns.end()) {
+            columns.push_back(column);
+        }
+    }
+
+    /* Two or three of the permanently inactive HDPC columns */
+    unsigned int piDegree = 2 + (splitMix64(state) & 1);
+    while(columns.size() < degree + piDegree) {
+        uint32_t column = ltColumns + splitMix64(state) % h_;
+        if(std::find(columns.begin() + degree, columns.end(), column) == columns.end()) {
+            columns.push_back(column);
+        }
+    }
+}
+
+void FountainCode::encode(uint32_t esi, const std::vector<uint8_t>& intermediate, size_t symbolSize, uint8_t* output) const {
+    std::vector<uint32_t> columns;
+    encodingRow(esi, columns);
+
+    std::fill(output, output + symbolSize, 0);
+    for(uint32_t column: columns) {
+        GFRegion::xorRegion(output, &intermediate[column * symbolSize], symbolSize);
+    }
+}
+
+void FountainCode::ldpcRows(std::vector<std::vector<uint32_t>>& rows) const {
+    rows.assign(s_, std::vector<uint32_t>());
+
+    /* Every source column is checked by three LDPC rows, with a stride that changes per group */
+    for(unsigned int i = 0; i < k_; i++) {
+        unsigned int a = 1 + (i / s_) % (s_ - 1);
+        unsigned int b = i % s_;
+
+        for(unsigned int j = 0; j < 3; j++) {
+            rows[b].push_back(i);
+            b = (b + a) % s_;
+        }
+    }
+
+    /* Each LDPC row also checks its own symbol and two of the HDPC symbols */
+    for(unsigned int j = 0; j < s_; j++) {
+        rows[j].push_back(k_ + j);
+        rows[j].push_back(k_ + s_ + j % h_);
+        rows[j].push_back(k_ + s_ + (j + 1) % h_);
+    }
+}
+
+/*
+ * The HDPC matrix is MT * GAMMA as in RFC 6330: MT has two ones per column (powers of
+ * alpha in the last one) and GAMMA[i][j] = alpha^(i - j) for i >= j. This makes the
+ * product with the data a Horner recursion instead of H multiplications per column.
+ */
+void FountainCode::hdpcColumn(unsigned int column, unsigned int& first, unsigned int& second) const {
+    uint64_t state = ((uint64_t)(seed_ ^ 0x48445043) << 32) ^ column;
+    first = splitMix64(state) % h_;
+    second = (first + 1 + splitMix64(state) % (h_ - 1)) % h_;
+}
+
+void FountainCode::hdpcMatrix(std::vector<std::vector<uint8_t>>& matrix) const {
+    matrix.assign(h_, std::vector<uint8_t>(l_));
+
+    const unsigned int last = k_ + s_ - 1;
+    RSGF256Number power(1);
+    for(unsigned int h = 0; h < h_; h++) {
+        matrix[h][last] = power;
+        power *= RSGF256Number(ALPHA);
+    }
+
+    for(unsigned int c = last; c-- > 0;) {
+        unsigned int first, second;
+        hdpcColumn(c, first, second);
+
+        for(unsigned int h = 0; h < h_; h++) {
+            matrix[h][c] = RSGF256Number(matrix[h][c + 1]) * RSGF256Number(ALPHA);
+        }
+        matrix[first][c] ^= 1;
+        matrix[second][c] ^= 1;
+    }
+
+    /* Every HDPC row also has its own symbol */
+    for(unsigned int h = 0; h < h_; h++) {
+        matrix[h][k_ + s_ + h] = 1;
+    }
+}
+
+bool FountainCode::solve(const std::vector<uint32_t>& esis, const std::vector<const uint8_t*>& symbols, size_t symbolSize,
+                         std::vector<uint8_t>& intermediate) const {
+    /*
+     * Sparse rows only ever get XORed together, so their coefficients on the inactive
+     * columns are bits.
+     */
+    struct Row {
+        std::vector<uint32_t> columns;
+        std::vector<uint64_t> inactive;
+        bool used;
+    };
+
+    /* Sparse rows: LDPC checks (zero) followed by the received symbols */
+    std::vector<Row> rows(s_ + esis.size());
+    std::vector<std::vector<uint32_t>> checks;
+    ldpcRows(checks);
+    for(unsigned int i = 0; i < s_; i++) {
+        rows[i].columns = std::move(checks[i]);
+    }
+    for(unsigned int i = 0; i < esis.size(); i++) {
+        encodingRow(esis[i], rows[s_ + i].columns);
+    }
+
+    std::vector<uint8_t> rowData(rows.size() * symbolSize);
+    for(unsigned int i = 0; i < esis.size(); i++) {
+        if(symbolSize) {
+            std::copy(symbols[i], symbols[i] + symbolSize, rowData.data() + (s_ + i) * symbolSize);
+        }
+    }
+
+    /* Dense rows: HDPC checks, coefficients are cleared as columns are eliminated */
+    std::vector<std::vector<uint8_t>> hdpc;
+    std::vector<std::vector<uint8_t>> hdpcInactive(h_);
+    std::vector<uint8_t> hdpcData(h_ * symbolSize);
+    hdpcMatrix(hdpc);
+
+    /* Rows are kept in buckets per number of unknowns, stale entries are skipped */
+    std::vector<std::vector<uint32_t>> columnRows(l_);
+    std::vector<std::vector<uint32_t>> buckets;
+    unsigned int lowestBucket = 0;
+
+    auto enqueue = [&](uint32_t r) {
+        unsigned int degree = rows[r].columns.size();
+        if(degree) {
+            buckets[degree].push_back(r);
+            lowestBucket = std::min(lowestBucket, degree);
+        }
+    };
+
+    size_t maxDegree = 0;
+    for(uint32_t r = 0; r < rows.size(); r++) {
+        rows[r].used = false;
+        for(uint32_t c: rows[r].columns) {
+            columnRows[c].push_back(r);
+        }
+        maxDegree = std::max(maxDegree, rows[r].columns.size());
+    }
+    buckets.resize(maxDegree + 1);
+    lowestBucket = maxDegree + 1;
+    for(uint32_t r = 0; r < rows.size(); r++) {
+        enqueue(r);
+    }
+
+    auto nextRow = [&](uint32_t& r) -> bool {
+        for(; lowestBucket < buckets.size(); lowestBucket++) {
+            std::vector<uint32_t>& bucket = buckets[lowestBucket];
+            while(bucket.size()) {
+                r = bucket.back();
+                bucket.pop_back();
+                if(!rows[r].used && rows[r].columns.size() == lowestBucket) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    const uint32_t ACTIVE = UINT32_MAX;
+    std::vector<uint32_t> pivotRow(l_, ACTIVE);
+    std::vector<uint32_t> inactiveColumns;
+    std::vector<bool> inactive(l_);
+
+    auto removeColumn = [&](uint32_t r, uint32_t c) -> bool {
+        std::vector<uint32_t>& columns = rows[r].columns;
+        auto it = std::find(columns.begin(), columns.end(), c);
+        if(it == columns.end()) {
+            return false;
+        }
+
+        *it = columns.back();
+        columns.pop_back();
+        enqueue(r);
+        return true;
+    };
+
+    auto inactivate = [&](uint32_t c) {
+        unsigned int index = inactiveColumns.size();
+        inactiveColumns.push_back(c);
+        inactive[c] = true;
+
+        for(uint32_t r: columnRows[c]) {
+            if(!rows[r].used && removeColumn(r, c)) {
+                rows[r].inactive.resize(index / 64 + 1);
+                rows[r].inactive[index / 64] ^= 1ULL << (index % 64);
+            }
+        }
+
+        for(unsigned int h = 0; h < h_; h++) {
+            hdpcInactive[h].resize(index + 1);
+            hdpcInactive[h][index] ^= hdpc[h][c];
+            hdpc[h][c] = 0;
+        }
+    };
+
+    /* The HDPC columns are dense, they are never peeled */
+    for(uint32_t c = k_ + s_; c < l_; c++) {
+        inactivate(c);
+    }
+
+    /* Peeling, a column is inactivated whenever no row with a single unknown is left */
+    uint32_t r;
+    while(nextRow(r)) {
+
+        while(rows[r].columns.size() > 1) {
+            inactivate(rows[r].columns.back());
+        }
+
+        uint32_t c = rows[r].columns[0];
+        removeColumn(r, c);
+        rows[r].used = true;
+        pivotRow[c] = r;
+
+        const std::vector<uint64_t>& pivotInactive = rows[r].inactive;
+        uint8_t* pivotData = rowData.data() + r * symbolSize;
+
+        for(uint32_t r2: columnRows[c]) {
+            if(r2 != r && !rows[r2].used && removeColumn(r2, c)) {
+                std::vector<uint64_t>& target = rows[r2].inactive;
+                if(target.size() < pivotInactive.size()) {
+                    target.resize(pivotInactive.size());
+                }
+                for(unsigned int i = 0; i < pivotInactive.size(); i++) {
+                    target[i] ^= pivotInactive[i];
+                }
+                GFRegion::xorRegion(rowData.data() + r2 * symbolSize, pivotData, symbolSize);
+            }
+        }
+
+        for(unsigned int h = 0; h < h_; h++) {
+            uint8_t coefficient = hdpc[h][c];
+            if(coefficient) {
+                for(unsigned int i = 0; i < pivotInactive.size(); i++) {
+                    for(uint64_t bits = pivotInactive[i]; bits; bits &= bits - 1) {
+                        hdpcInactive[h][i * 64 + __builtin_ctzll(bits)] ^= coefficient;
+                    }
+                }
+                hdpc[h][c] = 0;
+            }
+        }
+    }
+
+    /* Columns that no sparse row covers are left to the dense rows */
+    for(uint32_t c = 0; c < l_; c++) {
+        if(pivotRow[c] == ACTIVE && !inactive[c]) {
+            inactivate(c);
+        }
+    }
+
+    /* Data of the HDPC rows: the peeled columns multiplied by MT * GAMMA */
+    if(symbolSize) {
+        std::vector<uint8_t> horner(symbolSize);
+        const unsigned int last = k_ + s_ - 1;
+
+        for(uint32_t c = 0; c <= last; c++) {
+            /* x * c == x + x * (c + 1) */
+            RSGF256Number::mulAddRegion(horner.data(), horner.data(), ALPHA ^ 1, symbolSize);
+            if(!inactive[c]) {
+                GFRegion::xorRegion(horner.data(), rowData.data() + pivotRow[c] * symbolSize, symbolSize);
+            }
+
+            if(c == last) {
+                RSGF256Number power(1);
+                for(unsigned int h = 0; h < h_; h++) {
+                    RSGF256Number::mulAddRegion(hdpcData.data() + h * symbolSize, horner.data(), power, symbolSize);
+                    power *= RSGF256Number(ALPHA);
+                }
+            } else {
+                unsigned int first, second;
+                hdpcColumn(c, first, second);
+                GFRegion::xorRegion(hdpcData.data() + first * symbolSize, horner.data(), symbolSize);
+                GFRegion::xorRegion(hdpcData.data() + second * symbolSize, horner.data(), symbolSize);
+            }
+        }
+    }
+
+    /* Gaussian elimination of the inactive columns over the unused and HDPC rows */
+    const unsigned int numInactive = inactiveColumns.size();
+    std::vector<std::vector<uint8_t>> dense;
+    std::vector<uint8_t*> denseData;
+    for(uint32_t r = 0; r < rows.size(); r++) {
+        if(!rows[r].used) {
+            std::vector<uint8_t> coefficients(numInactive);
+            for(unsigned int j = 0; j < numInactive; j++) {
+                if(j / 64 < rows[r].inactive.size()) {
+                    coefficients[j] = (rows[r].inactive[j / 64] >> (j % 64)) & 1;
+                }
+            }
+            dense.push_back(std::move(coefficients));
+            denseData.push_back(rowData.data() + r * symbolSize);
+        }
+    }
+    for(unsigned int h = 0; h < h_; h++) {
+        hdpcInactive[h].resize(numInactive);
+        dense.push_back(std::move(hdpcInactive[h]));
+        denseData.push_back(hdpcData.data() + h * symbolSize);
+    }
+
+    for(unsigned int j = 0; j < numInactive; j++) {
+        unsigned int pivot = j;
+        while(pivot < dense.size() && !dense[pivot][j]) {
+            pivot++;
+        }
+        if(pivot == dense.size()) {
+            return false;
+        }
+        std::swap(dense[j], dense[pivot]);
+        std::swap(denseData[j], denseData[pivot]);
+
+        std::vector<uint8_t>& pivotRow = dense[j];
+        uint8_t scale = RSGF256Number(1) / RSGF256Number(pivotRow[j]);
+        if(scale != 1) {
+            for(unsigned int i = j; i < numInactive; i++) {
+                pivotRow[i] = RSGF256Number(pivotRow[i]) * RSGF256Number(scale);
+            }
+            /* x * c == x + x * (c + 1) */
+            RSGF256Number::mulAddRegion(denseData[j], denseData[j], scale ^ 1, symbolSize);
+        }
+
+        for(unsigned int r = 0; r < dense.size(); r++) {
+            uint8_t coefficient = dense[r][j];
+            if(r == j || !coefficient) {
+                continue;
+            }
+            for(unsigned int i = j; i < numInactive; i++) {
+                dense[r][i] ^= RSGF256Number(pivotRow[i]) * RSGF256Number(coefficient);
+            }
+            RSGF256Number::mulAddRegion(denseData[r], denseData[j], coefficient, symbolSize);
+        }
+    }
+
+    if(!symbolSize) {
+        return true;
+    }
+
+    /* Back substitution of the inactive symbols into the peeled columns */
+    intermediate.assign(l_ * symbolSize, 0);
+    for(unsigned int j = 0; j < numInactive; j++) {
+        std::copy(denseData[j], denseData[j] + symbolSize, &intermediate[inactiveColumns[j] * symbolSize]);
+    }
+
+    for(uint32_t c = 0; c < l_; c++) {
+        if(inactive[c]) {
+            continue;
+        }
+
+        const Row& row = rows[pivotRow[c]];
+        const uint8_t* pivotData = rowData.data() + pivotRow[c] * symbolSize;
+        uint8_t* output = &intermediate[c * symbolSize];
+
+        std::copy(pivotData, pivotData + symbolSize, output);
+        for(unsigned int i = 0; i < row.inactive.size(); i++) {
+            for(uint64_t bits = row.inactive[i]; bits; bits &= bits - 1) {
+                unsigned int j = i * 64 + __builtin_ctzll(bits);
+                GFRegion::xorRegion(output, &intermediate[inactiveColumns[j] * symbolSize], symbolSize);
+            }
+        }
+    }
+
+    return true;
+}
+
+static uint32_t findSystematicSeed(unsigned int sourceSymbols) {
+    std::vector<uint32_t> esis(sourceSymbols);
+    for(unsigned int i = 0; i < sourceSymbols; i++) {
+        esis[i] = i;
+    }
+
+    std::vector<const uint8_t*> symbols;
+    std::vector<uint8_t> intermediate;
+
+    for(uint32_t seed = 0; seed < 4096; seed++) {
+        if(FountainCode(sourceSymbols, seed).solve(esis, symbols, 0, intermediate)) {
+            return seed;
+        }
+    }
+
+    throw std::runtime_error("No systematic seed found");
+}
+
+uint32_t FountainCode::systematicSeed(unsigned int sourceSymbols) {
+    /* The search solves the code for every candidate, so it only runs once per k */
+    static std::once_flag once[MAX_SOURCE_SYMBOLS];
+    static uint32_t seeds[MAX_SOURCE_SYMBOLS];
+
+    if(!sourceSymbols || sourceSymbols > MAX_SOURCE_SYMBOLS) {
+        throw std::runtime_error("Invalid number of source symbols");
+    }
+
+    std::call_once(once[sourceSymbols - 1], [sourceSymbols]() {
+        seeds[sourceSymbols - 1] = findSystematicSeed(sourceSymbols);
+    });
+
+    return seeds[sourceSymbols - 1];
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FOUNTAINCODE_H_
+#define FOUNTAINCODE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "GF256Number.h"
+
+/*
+ * Structure of a Raptor style fountain code. The k source symbols are precoded into L
+ * intermediate symbols: S LDPC symbols (sparse XOR checks) and H HDPC symbols (dense
+ * GF(2^8) checks) are added. Every encoding symbol, identified by its ESI, is the XOR of a
+ * few intermediate symbols chosen by a pseudo random generator. The code is systematic:
+ * the intermediate block is chosen so that ESI 0 .. k-1 are the source symbols, the seed
+ * for which this is solvable only depends on k.
+ */
+class FountainCode {
+public:
+    using RSGF256Number = GF256Number<>;
+
+    static const unsigned int MAX_SOURCE_SYMBOLS = 65536;
+
+    FountainCode(unsigned int sourceSymbols, uint32_t seed);
+
+    /* Finds the seed that makes the code systematic for this number of source symbols, once per k */
+    static uint32_t systematicSeed(unsigned int sourceSymbols);
+
+    unsigned int intermediateSymbols() const {
+        return l_;
+    }
+
+    /* Intermediate symbols that are XORed to form encoding symbol esi */
+    void encodingRow(uint32_t esi, std::vector<uint32_t>& columns) const;
+
+    void encode(uint32_t esi, const std::vector<uint8_t>& intermediate, size_t symbolSize, uint8_t* output) const;
+
+    /*
+     * Calculates the intermediate block from at least k encoding symbols with inactivation
+     * decoding: the sparse rows are peeled, columns that block the peeling are inactivated
+     * and solved with Gaussian elimination together with the HDPC rows. Returns false if
+     * the symbols do not determine the block. A symbolSize of 0 only checks solvability.
+     */
+    bool solve(const std::vector<uint32_t>& esis, const std::vector<const uint8_t*>& symbols, size_t symbolSize,
+               std::vector<uint8_t>& intermediate) const;
+
+private:
+    static const unsigned int HDPC_SYMBOLS = 10;
+    static const uint8_t ALPHA = 0x87;
+
+    unsigned int k_;
+    unsigned int s_;
+    unsigned int h_;
+    unsigned int l_;
+    uint32_t seed_;
+
+    void ldpcRows(std::vector<std::vector<uint32_t>>& rows) const;
+    void hdpcColumn(unsigned int column, unsigned int& first, unsigned int& second) const;
+    void hdpcMatrix(std::vector<std::vector<uint8_t>>& matrix) const;
+};
+
+#endif /* FOUNTAINCODE_H_ */
@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FountainFEC.h"
+#include "FountainCode.h"
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+
+class FountainFEC::impl {
+public:
+    static void init() {
+        FountainCode::RSGF256Number::init();
+    }
+
+    impl() {
+        reset(false, 0);
+    }
+
+    void reset(bool encode, unsigned int numberOfSourcePackets) {
+        isEncoder_ = encode;
+        numSourcePackets_ = numberOfSourcePackets;
+        sourcePackets_.clear();
+        repairPackets_.clear();
+        intermediate_.clear();
+        code_.reset();
+        symbolSize_ = 0;
+        packetsReturned_ = 0;
+        encoderReadingSourcePackets_ = true;
+        decoderWaitingFirstPacket_ = true;
+        decoderStuck_ = false;
+        decoderReceived_ = 0;
+        decoderFailedAt_ = 0;
+
+        if(!isEncoder_) {
+            return;
+        }
+
+        if(!numSourcePackets_) {
+            throw std::runtime_error("At least one source packet is needed");
+        }
+
+        if(numSourcePackets_ > MAX_SOURCE_PACKETS) {
+            throw std::runtime_error("Too many source packets");
+        }
+    }
+
+    void operator<<(const std::vector<uint8_t>& packet) {
+        operator<<(std::vector<uint8_t>(packet));
+    }
+
+    void operator<<(std::vector<uint8_t>&& packet) {
+        if(isEncoder_) {
+            encoderLoad(std::move(packet));
+        } else {
+            decoderLoad(std::move(packet));
+        }
+    }
+
+    void operator<<(const std::vector<std::vector<uint8_t>>& packets) {
+        for(auto& packet: packets) {
+            operator<<(packet);
+        }
+    }
+
+    unsigned int requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+        if(isEncoder_) {
+            return encoderRequestPackets(outputPackets, numPackets);
+        } else {
+            return decoderRequestPackets(outputPackets, numPackets);
+        }
+    }
+
+    bool operator>>(std::vector<uint8_t>& outputPacket) {
+        std::vector<std::vector<uint8_t>> tmp;
+
+        if(requestPackets(tmp, 1)) {
+            outputPacket = std::move(tmp[0]);
+            return true;
+        }
+
+        return false;
+    }
+
+    void flush() {
+        if(!isEncoder_ || sourcePackets_.size() == numSourcePackets_) {
+            return;
+        }
+
+        if(!sourcePackets_.size()) {
+            throw std::runtime_error("At least one source packet is needed");
+        }
+
+        /* Close the block: the code is shortened to the packets loaded so far */
+        numSourcePackets_ = sourcePackets_.size();
+    }
+
+private:
+    static const size_t TRAILER_SIZE = 5;
+    static const size_t LENGTH_SIZE = 4;
+    static const unsigned int MAX_SOURCE_PACKETS = FountainCode::MAX_SOURCE_SYMBOLS;
+    static const uint32_t MAX_SYMBOL_ID = 0xFFFFFF;
+
+    bool isEncoder_;
+    unsigned int numSourcePackets_;
+    uint32_t packetsReturned_;
+
+    /* Source packets without trailer, repair symbols by ID */
+    std::vector<std::vector<uint8_t>> sourcePackets_;
+    std::map<uint32_t, std::vector<uint8_t>> repairPackets_;
+
+    std::unique_ptr<FountainCode> code_;
+    std::vector<uint8_t> intermediate_;
+    size_t symbolSize_;
+
+    bool encoderReadingSourcePackets_;
+
+    bool decoderWaitingFirstPacket_;
+    bool decoderStuck_;
+    unsigned int decoderReceived_;
+    unsigned int decoderFailedAt_;
+
+    void writeTrailer(std::vector<uint8_t>& packet, uint32_t symbolId) {
+        size_t offset = packet.size();
+        packet.resize(offset + TRAILER_SIZE);
+
+        packet[offset] = symbolId >> 16;
+        packet[offset + 1] = symbolId >> 8;
+        packet[offset + 2] = symbolId;
+        packet[offset + 3] = (numSourcePackets_ - 1) >> 8;
+        packet[offset + 4] = numSourcePackets_ - 1;
+    }
+
+    void readTrailer(const std::vector<uint8_t>& packet, uint32_t& symbolId, unsigned int& sourcePackets) {
+        const uint8_t* trailer = &packet[packet.size() - TRAILER_SIZE];
+
+        symbolId = (trailer[0] << 16) | (trailer[1] << 8) | trailer[2];
+        sourcePackets = ((trailer[3] << 8) | trailer[4]) + 1;
+    }
+
+    /* Source symbols are padded to the symbol size and end with the packet length */
+    static void loadSymbol(uint8_t* symbol, size_t symbolSize, const std::vector<uint8_t>& packet) {
+        std::copy(packet.begin(), packet.end(), symbol);
+        std::fill(symbol + packet.size(), symbol + symbolSize - LENGTH_SIZE, 0);
+
+        uint32_t length = packet.size();
+        for(unsigned int i = 0; i < LENGTH_SIZE; i++) {
+            symbol[symbolSize - 1 - i] = length >> (8 * i);
+        }
+    }
+
+    static size_t readSymbolLength(const uint8_t* symbol, size_t symbolSize) {
+        size_t length = 0;
+        for(unsigned int i = 0; i < LENGTH_SIZE; i++) {
+            length = (length << 8) | symbol[symbolSize - LENGTH_SIZE + i];
+        }
+        return length;
+    }
+
+    void encoderLoad(std::vector<uint8_t>&& packet) {
+        if(!packet.size()) {
+            throw std::runtime_error("size() == 0 packets are not supported");
+        }
+
+        if(!encoderReadingSourcePackets_) {
+            throw std::runtime_error("Reset required");
+        }
+
+        if(sourcePackets_.size() >= numSourcePackets_) {
+            throw std::runtime_error("Encoder is full");
+        }
+
+        if(packet.size() > 0xFFFFFFFF) {
+            throw std::runtime_error("Packet too large");
+        }
+
+        sourcePackets_.push_back(std::move(packet));
+    }
+
+    void encoderPrecode() {
+        size_t longest = 0;
+        for(auto& packet: sourcePackets_) {
+            longest = std::max(longest, packet.size());
+        }
+        symbolSize_ = longest + LENGTH_SIZE;
+
+        std::vector<uint8_t> symbols(numSourcePackets_ * symbolSize_);
+        std::vector<const uint8_t*> symbolPointers(numSourcePackets_);
+        std::vector<uint32_t> symbolIds(numSourcePackets_);
+        for(unsigned int i = 0; i < numSourcePackets_; i++) {
+            loadSymbol(&symbols[i * symbolSize_], symbolSize_, sourcePackets_[i]);
+            symbolPointers[i] = &symbols[i * symbolSize_];
+            symbolIds[i] = i;
+        }
+
+        code_.reset(new FountainCode(numSourcePackets_, FountainCode::systematicSeed(numSourcePackets_)));
+        if(!code_->solve(symbolIds, symbolPointers, symbolSize_, intermediate_)) {
+            throw std::logic_error("Systematic seed does not solve");
+        }
+    }
+
+    unsigned int encoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        unsigned int count = 0;
+        for(count = 0; count < numPackets; count++) {
+            if(packetsReturned_ < numSourcePackets_) {
+                /* Are enough source packets loaded? */
+                if(packetsReturned_ >= sourcePackets_.size()) {
+                    break;
+                }
+
+                std::vector<uint8_t> outputPacket(sourcePackets_[packetsReturned_]);
+                writeTrailer(outputPacket, packetsReturned_);
+                packets.push_back(std::move(outputPacket));
+
+            } else {
+                if(packetsReturned_ > MAX_SYMBOL_ID) {
+                    throw std::runtime_error("Can't generate more packets");
+                }
+
+                if(!code_) {
+                    if(sourcePackets_.size() < numSourcePackets_) {
+                        break;
+                    }
+
+                    encoderReadingSourcePackets_ = false;
+                    encoderPrecode();
+                }
+
+                std::vector<uint8_t> outputPacket(symbolSize_);
+                code_->encode(packetsReturned_, intermediate_, symbolSize_, outputPacket.data());
+                writeTrailer(outputPacket, packetsReturned_);
+                packets.push_back(std::move(outputPacket));
+            }
+
+            packetsReturned_++;
+        }
+
+        return count;
+    }
+
+    void decoderLoad(std::vector<uint8_t>&& packet) {
+        if(decoderStuck_ || packet.size() <= TRAILER_SIZE) {
+            return;
+        }
+
+        uint32_t symbolId;
+        unsigned int announcedSourcePackets;
+        readTrailer(packet, symbolId, announcedSourcePackets);
+        packet.resize(packet.size() - TRAILER_SIZE);
+
+        if(decoderWaitingFirstPacket_) {
+            decoderWaitingFirstPacket_ = false;
+            numSourcePackets_ = announcedSourcePackets;
+            sourcePackets_.resize(numSourcePackets_);
+        } else if(announcedSourcePackets != numSourcePackets_ && !decoderShortenBlock(announcedSourcePackets, symbolId)) {
+            return;
+        }
+
+        if(symbolId < numSourcePackets_) {
+            if(sourcePackets_[symbolId].size()) {
+                return;
+            }
+            sourcePackets_[symbolId] = std::move(packet);
+        } else {
+            /* All repair symbols have the same size */
+            if(symbolSize_ && packet.size() != symbolSize_) {
+                return;
+            }
+            if(packet.size() <= LENGTH_SIZE || repairPackets_.count(symbolId)) {
+                return;
+            }
+            symbolSize_ = packet.size();
+            repairPackets_[symbolId] = std::move(packet);
+        }
+
+        decoderReceived_++;
+    }
+
+    bool decoderShortenBlock(unsigned int announcedSourcePackets, uint32_t symbolId) {
+        /* Source packets of a flushed block are identical in both codes */
+        if(announcedSourcePackets > numSourcePackets_) {
+            return symbolId < numSourcePackets_;
+        }
+
+        /* Shrink the block, this is only possible if no packet contradicts the shorter code */
+        if(repairPackets_.size()) {
+            return false;
+        }
+
+        for(unsigned int i = announcedSourcePackets; i < numSourcePackets_; i++) {
+            if(sourcePackets_[i].size()) {
+                return false;
+            }
+        }
+
+        numSourcePackets_ = announcedSourcePackets;
+        sourcePackets_.resize(numSourcePackets_);
+
+        return true;
+    }
+
+    /* Returns false if more packets are needed */
+    bool decoderRecover() {
+        if(!code_) {
+            code_.reset(new FountainCode(numSourcePackets_, FountainCode::systematicSeed(numSourcePackets_)));
+        }
+
+        std::vector<uint32_t> symbolIds;
+        std::vector<const uint8_t*> symbolPointers;
+        std::vector<uint8_t> sourceSymbols(numSourcePackets_ * symbolSize_);
+
+        for(unsigned int i = 0; i < numSourcePackets_; i++) {
+            if(sourcePackets_[i].size()) {
+                if(sourcePackets_[i].size() > symbolSize_ - LENGTH_SIZE) {
+                    decoderStuck_ = true;
+                    return false;
+                }
+                loadSymbol(&sourceSymbols[i * symbolSize_], symbolSize_, sourcePackets_[i]);
+                symbolIds.push_back(i);
+                symbolPointers.push_back(&sourceSymbols[i * symbolSize_]);
+            }
+        }
+        for(auto& repairPacket: repairPackets_) {
+            symbolIds.push_back(repairPacket.first);
+            symbolPointers.push_back(repairPacket.second.data());
+        }
+
+        if(!code_->solve(symbolIds, symbolPointers, symbolSize_, intermediate_)) {
+            return false;
+        }
+
+        /* Validate everything before touching the packet buffer */
+        std::vector<uint8_t> recovered(numSourcePackets_ * symbolSize_);
+        for(unsigned int i = 0; i < numSourcePackets_; i++) {
+            if(!sourcePackets_[i].size()) {
+                uint8_t* symbol = &recovered[i * symbolSize_];
+                code_->encode(i, intermediate_, symbolSize_, symbol);
+
+                size_t length = readSymbolLength(symbol, symbolSize_);
+                if(!length || length > symbolSize_ - LENGTH_SIZE) {
+                    decoderStuck_ = true;
+                    return false;
+                }
+            }
+        }
+
+        for(unsigned int i = 0; i < numSourcePackets_; i++) {
+            if(!sourcePackets_[i].size()) {
+                uint8_t* symbol = &recovered[i * symbolSize_];
+                sourcePackets_[i].assign(symbol, symbol + readSymbolLength(symbol, symbolSize_));
+            }
+        }
+
+        intermediate_.clear();
+        repairPackets_.clear();
+
+        return true;
+    }
+
+    unsigned int decoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        unsigned int count = 0;
+        for(count = 0; count < numPackets; count++) {
+            if(decoderStuck_ || decoderWaitingFirstPacket_ || packetsReturned_ >= numSourcePackets_) {
+                break;
+            }
+
+            if(!sourcePackets_[packetsReturned_].size()) {
+                /* Recover all missing packets at once, a failed attempt waits for more packets */
+                if(decoderReceived_ < numSourcePackets_ || decoderReceived_ == decoderFailedAt_) {
+                    break;
+                }
+
+                if(!decoderRecover()) {
+                    decoderFailedAt_ = decoderReceived_;
+                    break;
+                }
+            }
+
+            packets.push_back(sourcePackets_[packetsReturned_]);
+            packetsReturned_++;
+        }
+
+        return count;
+    }
+};
+
+void FountainFEC::init() {
+    FountainFEC::impl::init();
+}
+
+FountainFEC::FountainFEC():
+    impl_(new impl()) {
+}
+
+void FountainFEC::reset(bool encode, unsigned int numberOfSourcePackets) {
+    impl_->reset(encode, numberOfSourcePackets);
+}
+
+void FountainFEC::operator<<(const std::vector<uint8_t>& sourcePacket) {
+    impl_->operator<<(sourcePacket);
+}
+
+void FountainFEC::operator<<(std::vector<uint8_t>&& sourcePacket) {
+    impl_->operator<<(std::move(sourcePacket));
+}
+
+void FountainFEC::operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets) {
+    impl_->operator<<(sourcePackets);
+}
+
+unsigned int FountainFEC::requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+    return impl_->requestPackets(outputPackets, numPackets);
+}
+
+bool FountainFEC::operator>>(std::vector<uint8_t>& outputPacket) {
+    return impl_->operator>>(outputPacket);
+}
+
+bool FountainFEC::operator>>(std::vector<std::vector<uint8_t>>& outputPackets) {
+    return impl_->requestPackets(outputPackets, 1) > 0;
+}
+
+void FountainFEC::flush() {
+    impl_->flush();
+}
+
+FountainFEC::~FountainFEC() = default;
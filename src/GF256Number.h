@@ -30,6 +30,8 @@
 
 #include <stdexcept>
 #include <cstdint>
+#include <cstddef>
+#include "GFRegion.h"
 
 template <uint16_t P = 0x18b, uint8_t G = 0x87> class GF256Number {
 public:
@@ -105,6 +107,37 @@ public:
         return !operator==(b);
     }
 
+    /* dst[i] += c * src[i] for a region of len bytes */
+    static void mulAddRegion(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len) {
+        if(c == 0) {
+            return;
+        }
+
+        if(c == 1) {
+            GFRegion::xorRegion(dst, src, len);
+            return;
+        }
+
+        /* Short regions are not worth building the nibble tables for */
+        if(len < 32) {
+            unsigned int logC = logTable_[c];
+            for(size_t i = 0; i < len; i++) {
+                if(src[i]) {
+                    dst[i] ^= expTable_[logTable_[src[i]] + logC];
+                }
+            }
+            return;
+        }
+
+        uint8_t tables[2][16];
+        for(unsigned int i = 0; i < 16; i++) {
+            tables[0][i] = gfMultTableStatic(c, i);
+            tables[1][i] = gfMultTableStatic(c, i << 4);
+        }
+
+        GFRegion::mulAdd8(dst, src, tables, len);
+    }
+
 private:
     uint8_t value_;
 
@@ -113,6 +146,10 @@ private:
     }
 
     inline uint8_t gfMultTable(uint8_t a, uint8_t b) const {
+        return gfMultTableStatic(a, b);
+    }
+
+    static inline uint8_t gfMultTableStatic(uint8_t a, uint8_t b) {
         if(a == 0 || b == 0) {
             return 0;
         }
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GF65536NUMBER_H_
+#define GF65536NUMBER_H_
+
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include "GFRegion.h"
+
+/*
+ * GF(2^16) counterpart of GF256Number. In byte buffers every element is stored as two
+ * bytes, most significant byte first.
+ */
+template <uint32_t P = 0x1100b, uint16_t G = 0x2> class GF65536Number {
+public:
+    inline GF65536Number(const GF65536Number<P, G>& value) {
+        value_ = value.value_;
+    }
+
+    inline GF65536Number(uint16_t value) {
+        value_ = value;
+    }
+
+    inline GF65536Number() {
+        value_ = 0;
+    }
+
+    static void init() {
+        buildTables();
+    }
+
+    inline void operator=(const GF65536Number<P, G>& value) {
+        value_ = value.value_;
+    }
+
+    inline void operator=(uint16_t value) {
+        value_ = value;
+    }
+
+    inline GF65536Number<P, G> operator+(const GF65536Number<P, G>& b) const {
+        return GF65536Number(gfAddSub(value_, b.value_));
+    }
+
+    inline void operator+=(const GF65536Number<P, G>& b) {
+        value_ = gfAddSub(value_, b.value_);
+    }
+
+    inline GF65536Number<P, G> operator-(const GF65536Number<P, G>& b) const {
+        return GF65536Number<P, G>(gfAddSub(value_, b.value_));
+    }
+
+    inline void operator-=(const GF65536Number<P, G>& b) {
+        value_ = gfAddSub(value_, b.value_);
+    }
+
+    inline GF65536Number<P, G> operator*(const GF65536Number<P, G>& b) const {
+        return GF65536Number(gfMultTable(value_, b.value_));
+    }
+
+    inline void operator*=(const GF65536Number<P, G>& b) {
+        value_ = gfMultTable(value_, b.value_);
+    }
+
+    inline GF65536Number<P, G> operator/(const GF65536Number<P, G>& b) const {
+        return GF65536Number(gfDivTable(value_, b.value_));
+    }
+
+    inline void operator/=(const GF65536Number<P, G>& b) {
+        value_ = gfDivTable(value_, b.value_);
+    }
+
+    inline uint16_t value() const {
+        return value_;
+    }
+
+    inline operator uint16_t() const {
+        return value_;
+    }
+
+    inline bool operator==(const GF65536Number<P, G>& b) const {
+        return value_ == b.value_;
+    }
+
+    inline bool operator!=(const GF65536Number<P, G>& b) const {
+        return !operator==(b);
+    }
+
+    /*
+     * dst[i] += c * src[i] for a region of len bytes. An odd length is treated as if the
+     * region was padded with a zero byte, dst must have room for that byte.
+     */
+    static void mulAddRegion(uint8_t* dst, const uint8_t* src, uint16_t c, size_t len) {
+        if(c == 0) {
+            return;
+        }
+
+        if(c == 1) {
+            GFRegion::xorRegion(dst, src, len);
+            return;
+        }
+
+        /* Split table: the product of every nibble position, low and high byte separately */
+        uint8_t tables[8][16];
+        for(unsigned int nibble = 0; nibble < 4; nibble++) {
+            for(unsigned int i = 0; i < 16; i++) {
+                uint16_t product = gfMultTableStatic(c, i << (4 * nibble));
+                tables[2 * nibble][i] = product & 0xFF;
+                tables[2 * nibble + 1][i] = product >> 8;
+            }
+        }
+
+        GFRegion::mulAdd16(dst, src, tables, len & ~(size_t)1);
+
+        if(len & 1) {
+            uint16_t product = gfMultTableStatic(c, src[len - 1] << 8);
+            dst[len - 1] ^= product >> 8;
+            dst[len] ^= product & 0xFF;
+        }
+    }
+
+private:
+    uint16_t value_;
+
+    inline uint16_t gfAddSub(uint16_t a, uint16_t b) const {
+        return a^b;
+    }
+
+    inline uint16_t gfMultTable(uint16_t a, uint16_t b) const {
+        return gfMultTableStatic(a, b);
+    }
+
+    static inline uint16_t gfMultTableStatic(uint16_t a, uint16_t b) {
+        if(a == 0 || b == 0) {
+            return 0;
+        }
+        return expTable_[logTable_[a] + logTable_[b] + 65535];
+    }
+
+    inline uint16_t gfDivTable(uint16_t a, uint16_t b) const {
+        if(b == 0) {
+            throw std::invalid_argument("Division by 0");
+        }
+        if(a == 0) {
+            return 0;
+        }
+        return expTable_[logTable_[a] - logTable_[b] + 65535];
+    }
+
+    static uint16_t gfMultSlow(uint16_t a, uint16_t b) {
+        uint32_t result = 0;
+
+        /* Multiply */
+        for(unsigned int i = 0; i < 16; i++) {
+            if(b & (1 << i)) {
+                result ^= (uint32_t)a << i;
+            }
+        }
+
+        /* Reduce */
+        for(unsigned int i = 31; i >= 16; i--) {
+            if(result & (1U << i)) {
+                result ^= P << (i-16);
+            }
+        }
+
+        return result;
+    }
+
+    static void buildTables() {
+        if(tableBuilt_) return;
+
+        /* a^0 == 1 */
+        expTable_[0] = 1;
+        logTable_[1] = 0;
+
+        /* Log(0) has no result */
+        logTable_[0] = 0;
+
+        /* Calculate other entries */
+        for(unsigned int i=1; i<65536; i++) {
+            uint16_t tmp = gfMultSlow(expTable_[i-1], G);
+
+            /* Fill in exponent table */
+            expTable_[i] = tmp;
+            expTable_[i + 65535] = tmp;
+            expTable_[i + 65535 * 2] = tmp;
+
+            /* Fill in log table */
+            if(i < 65535) {
+                logTable_[tmp] = i;
+            }
+        }
+
+        tableBuilt_  = true;
+    }
+
+    /*
+     * The exponent table is larger than needed, but this saves somewhat
+     * expensive mod 65535 operations.
+     */
+    static uint16_t expTable_[65536+65535+65535];
+    static uint16_t logTable_[65536];
+    static bool tableBuilt_;
+};
+
+template <uint32_t P, uint16_t G> uint16_t GF65536Number<P, G>::expTable_[65536+65535+65535];
+template <uint32_t P, uint16_t G> uint16_t GF65536Number<P, G>::logTable_[65536];
+template <uint32_t P, uint16_t G> bool     GF65536Number<P, G>::tableBuilt_ = false;
+
+#endif /* GF65536NUMBER_H_ */
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "GFJit.h"
+#include "GF256Number.h"
+#include "GFRegion.h"
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstring>
+
+#if defined(__x86_64__) && !defined(CAUCHYFEC_NO_JIT)
+#include <sys/mman.h>
+#include <unistd.h>
+#define GFJIT_X86_64
+#endif
+
+namespace GFJit {
+
+#ifdef GFJIT_X86_64
+
+namespace {
+
+/* Registers */
+enum {
+    RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7, R8 = 8,
+};
+
+/*
+ * ymm0 .. ymm9 hold the sums of up to ten rows, ymm15 the nibble mask, ymm14 the source,
+ * ymm13 and ymm12 its low and high nibbles, ymm11 and ymm10 the products.
+ */
+static const unsigned int MAX_ROWS = 10;
+static const int MASK = 15, SOURCE = 14, NIBBLE_LO = 13, NIBBLE_HI = 12, PRODUCT_A = 11, PRODUCT_B = 10;
+
+/* Routines larger than this are not worth the compile time */
+static const size_t MAX_TERMS = 16384;
+static const size_t MAX_CACHED = 64;
+
+struct Memory {
+    int base;
+    int index;
+    int32_t disp;
+};
+
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+
+    void byte(uint8_t value) {
+        code.push_back(value);
+    }
+
+    void dword(uint32_t value) {
+        for(unsigned int i = 0; i < 4; i++) {
+            byte(value >> (8 * i));
+        }
+    }
+
+    /* Three byte VEX prefix, map 1 = 0F, 2 = 0F38, pp 1 = 66, 2 = F3 */
+    void vex(unsigned int map, unsigned int pp, int reg, int vvvv, int index, int base) {
+        byte(0xC4);
+        byte((!(reg & 8) << 7) | (!(index & 8) << 6) | (!(base & 8) << 5) | map);
+        byte(((~vvvv & 0xF) << 3) | (1 << 2) | pp);
+    }
+
+    void modrmRegister(int reg, int rm) {
+        byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    void modrmMemory(int reg, const Memory& m) {
+        if(m.index < 0) {
+            byte(0x80 | ((reg & 7) << 3) | (m.base & 7));
+            dword(m.disp);
+        } else {
+            byte(0x04 | ((reg & 7) << 3));
+            byte(((m.index & 7) << 3) | (m.base & 7));
+        }
+    }
+
+    void vmovdquLoad(int dst, const Memory& m) {
+        vex(1, 2, dst, 0, m.index < 0? 0 : m.index, m.base);
+        byte(0x6F);
+        modrmMemory(dst, m);
+    }
+
+    void vmovdquStore(const Memory& m, int src) {
+        vex(1, 2, src, 0, m.index < 0? 0 : m.index, m.base);
+        byte(0x7F);
+        modrmMemory(src, m);
+    }
+
+    void vpxor(int dst, int a, int b) {
+        vex(1, 1, dst, a, 0, b);
+        byte(0xEF);
+        modrmRegister(dst, b);
+    }
+
+    void vpxorMemory(int dst, int a, const Memory& m) {
+        vex(1, 1, dst, a, m.index < 0? 0 : m.index, m.base);
+        byte(0xEF);
+        modrmMemory(dst, m);
+    }
+
+    void vpand(int dst, int a, int b) {
+        vex(1, 1, dst, a, 0, b);
+        byte(0xDB);
+        modrmRegister(dst, b);
+    }
+
+    void vpsrlq(int dst, int src, uint8_t shift) {
+        vex(1, 1, 0, dst, 0, src);
+        byte(0x73);
+        modrmRegister(2, src);
+        byte(shift);
+    }
+
+    /* dst = table shuffled by indices */
+    void vpshufb(int dst, int table, int indices) {
+        vex(2, 1, dst, table, 0, indices);
+        byte(0x00);
+        modrmRegister(dst, indices);
+    }
+
+    /* mov r8, [base + disp32] */
+    void loadPointer(int base, int32_t disp) {
+        byte(0x4C);
+        byte(0x8B);
+        byte(0x80 | ((R8 & 7) << 3) | (base & 7));
+        dword(disp);
+    }
+};
+
+class RoutineBuilder {
+public:
+    RoutineBuilder(const uint16_t* coefficients, unsigned int rows, unsigned int columns):
+        coefficients_(coefficients),
+        rows_(rows),
+        columns_(columns) {
+    }
+
+    std::shared_ptr<const Routine> build() {
+        /* Nibble tables of every coefficient above one, each half repeated for both lanes */
+        std::vector<int> tableOffset(256, -1);
+        std::vector<uint8_t> tables(32, 0x0F);
+        for(unsigned int i = 0; i < rows_ * columns_; i++) {
+            uint8_t c = coefficients_[i];
+            if(c > 1 && tableOffset[c] < 0) {
+                tableOffset[c] = tables.size();
+                for(unsigned int half = 0; half < 2; half++) {
+                    for(unsigned int lane = 0; lane < 2; lane++) {
+                        for(unsigned int n = 0; n < 16; n++) {
+                            tables.push_back((GF256Number<>(c) * GF256Number<>(half? n << 4 : n)).value());
+                        }
+                    }
+                }
+            }
+        }
+
+        /* Arguments: rdi = destinations, rsi = sources, rdx = length; rcx points to the tables */
+        Assembler a;
+        size_t leaRcx = a.code.size();
+        a.byte(0x48);
+        a.byte(0x8D);
+        a.byte(0x0D);
+        a.dword(0);
+
+        a.vmovdquLoad(MASK, Memory{RCX, -1, 0});
+
+        for(unsigned int first = 0; first < rows_; first += MAX_ROWS) {
+            emitRows(a, first, std::min(rows_, first + MAX_ROWS), tableOffset);
+        }
+
+        a.byte(0xC5);
+        a.byte(0xF8);
+        a.byte(0x77);
+        a.byte(0xC3);
+
+        size_t tablesStart = (a.code.size() + 63) & ~(size_t)63;
+        int32_t rel = tablesStart - (leaRcx + 7);
+        memcpy(&a.code[leaRcx + 3], &rel, 4);
+
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+        size_t size = (tablesStart + tables.size() + pageSize - 1) & ~(pageSize - 1);
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED) {
+            return nullptr;
+        }
+
+        memcpy(memory, a.code.data(), a.code.size());
+        memcpy((uint8_t*)memory + tablesStart, tables.data(), tables.size());
+
+        if(mprotect(memory, size, PROT_READ | PROT_EXEC) < 0) {
+            munmap(memory, size);
+            return nullptr;
+        }
+
+        return std::make_shared<const Routine>(memory, size);
+    }
+
+private:
+    const uint16_t* coefficients_;
+    unsigned int rows_;
+    unsigned int columns_;
+
+    void emitRows(Assembler& a, unsigned int first, unsigned int last, const std::vector<int>& tableOffset) {
+        /* for(rax = 0; rax < rdx; rax += 32) */
+        a.byte(0x31);
+        a.byte(0xC0);
+        a.byte(0x48);
+        a.byte(0x85);
+        a.byte(0xD2);
+        a.byte(0x0F);
+        a.byte(0x84);
+        size_t skip = a.code.size();
+        a.dword(0);
+        size_t loop = a.code.size();
+
+        for(unsigned int r = first; r < last; r++) {
+            a.vpxor(r - first, r - first, r - first);
+        }
+
+        for(unsigned int c = 0; c < columns_; c++) {
+            bool used = false, multiply = false;
+            for(unsigned int r = first; r < last; r++) {
+                uint8_t coefficient = coefficients_[r * columns_ + c];
+                used |= coefficient != 0;
+                multiply |= coefficient > 1;
+            }
+            if(!used) {
+                continue;
+            }
+
+            a.loadPointer(RSI, 8 * c);
+            a.vmovdquLoad(SOURCE, Memory{R8, RAX, 0});
+
+            if(multiply) {
+                a.vpsrlq(NIBBLE_HI, SOURCE, 4);
+                a.vpand(NIBBLE_LO, SOURCE, MASK);
+                a.vpand(NIBBLE_HI, NIBBLE_HI, MASK);
+            }
+
+            for(unsigned int r = first; r < last; r++) {
+                uint8_t coefficient = coefficients_[r * columns_ + c];
+                int sum = r - first;
+
+                if(coefficient == 1) {
+                    a.vpxor(sum, sum, SOURCE);
+                } else if(coefficient) {
+                    a.vmovdquLoad(PRODUCT_A, Memory{RCX, -1, tableOffset[coefficient]});
+                    a.vmovdquLoad(PRODUCT_B, Memory{RCX, -1, tableOffset[coefficient] + 32});
+                    a.vpshufb(PRODUCT_A, PRODUCT_A, NIBBLE_LO);
+                    a.vpshufb(PRODUCT_B, PRODUCT_B, NIBBLE_HI);
+                    a.vpxor(sum, sum, PRODUCT_A);
+                    a.vpxor(sum, sum, PRODUCT_B);
+                }
+            }
+        }
+
+        for(unsigned int r = first; r < last; r++) {
+            int sum = r - first;
+            a.loadPointer(RDI, 8 * r);
+            a.vpxorMemory(sum, sum, Memory{R8, RAX, 0});
+            a.vmovdquStore(Memory{R8, RAX, 0}, sum);
+        }
+
+        /* add rax, 32; cmp rax, rdx; jb loop */
+        a.byte(0x48);
+        a.byte(0x83);
+        a.byte(0xC0);
+        a.byte(BLOCK_SIZE);
+        a.byte(0x48);
+        a.byte(0x39);
+        a.byte(0xD0);
+        a.byte(0x0F);
+        a.byte(0x82);
+        a.dword(loop - (a.code.size() + 4));
+
+        uint32_t skipRel = a.code.size() - (skip + 4);
+        memcpy(&a.code[skip], &skipRel, 4);
+    }
+};
+
+struct CacheKey {
+    unsigned int rows;
+    unsigned int columns;
+    std::vector<uint16_t> coefficients;
+
+    bool operator<(const CacheKey& other) const {
+        if(rows != other.rows) {
+            return rows < other.rows;
+        }
+        if(columns != other.columns) {
+            return columns < other.columns;
+        }
+        return coefficients < other.coefficients;
+    }
+};
+
+}
+
+Routine::Routine(void* memory, size_t size):
+    memory_(memory),
+    size_(size),
+    function_((Function)memory) {
+}
+
+Routine::~Routine() {
+    munmap(memory_, size_);
+}
+
+std::shared_ptr<const Routine> compile(const uint16_t* coefficients, unsigned int rows, unsigned int columns) {
+    static std::mutex lock;
+    static std::map<CacheKey, std::shared_ptr<const Routine>> cache;
+
+    if(!rows || !columns || (size_t)rows * columns > MAX_TERMS || GFRegion::kernelLevel() != GFRegion::KERNEL_AVX2) {
+        return nullptr;
+    }
+
+    CacheKey key{rows, columns, std::vector<uint16_t>(coefficients, coefficients + rows * columns)};
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = cache.find(key);
+    if(it != cache.end()) {
+        return it->second;
+    }
+
+    /* Routines in use stay alive through their shared pointers */
+    if(cache.size() >= MAX_CACHED) {
+        cache.clear();
+    }
+
+    auto routine = RoutineBuilder(coefficients, rows, columns).build();
+    cache[std::move(key)] = routine;
+    return routine;
+}
+
+#else
+
+Routine::Routine(void* memory, size_t size):
+    memory_(memory),
+    size_(size),
+    function_(nullptr) {
+}
+
+Routine::~Routine() {
+}
+
+std::shared_ptr<const Routine> compile(const uint16_t*, unsigned int, unsigned int) {
+    return nullptr;
+}
+
+#endif
+
+}
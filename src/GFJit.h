@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GFJIT_H_
+#define GFJIT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+/*
+ * Machine code specialised for one GF(2^8) coefficient matrix. The routine computes
+ * dst[r] += sum of M(r, c) * src[c] for every row, reading every source once per 32 bytes
+ * and writing every destination once. Zero coefficients are left out, ones become a XOR,
+ * the nibble tables of the other coefficients are embedded in the routine.
+ *
+ * Only x86-64 with AVX2 is supported. compile() returns nullptr when the JIT is not
+ * available (or CAUCHYFEC_NO_JIT is defined), the caller then uses the region kernels.
+ * Routines are cached per matrix and can be shared between threads.
+ */
+namespace GFJit {
+
+/* Lengths passed to a routine are a multiple of this */
+static const size_t BLOCK_SIZE = 32;
+
+class Routine {
+public:
+    Routine(void* memory, size_t size);
+    ~Routine();
+
+    inline void operator()(uint8_t* const* dst, const uint8_t* const* src, size_t length) const {
+        function_(dst, src, length);
+    }
+
+private:
+    using Function = void (*)(uint8_t* const*, const uint8_t* const*, size_t);
+
+    void* memory_;
+    size_t size_;
+    Function function_;
+};
+
+std::shared_ptr<const Routine> compile(const uint16_t* coefficients, unsigned int rows, unsigned int columns);
+
+}
+
+#endif /* GFJIT_H_ */
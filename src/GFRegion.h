@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GFREGION_H_
+#define GFREGION_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GFREGION_X86
+#endif
+
+/*
+ * Region kernels shared by the field types. A multiplication by a constant is split in
+ * nibbles: every nibble of the input selects one of 16 precomputed products, which maps
+ * directly on a byte shuffle. GF(2^8) needs two such tables, GF(2^16) symbols (stored big
+ * endian) need eight: four nibbles times the low and high byte of the product.
+ */
+namespace GFRegion {
+
+enum KernelLevel {
+    KERNEL_SCALAR,
+    KERNEL_SSSE3,
+    KERNEL_AVX2,
+};
+
+inline KernelLevel kernelLevel() {
+#ifdef GFREGION_X86
+    static KernelLevel level = []() {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            return KERNEL_AVX2;
+        }
+        if(__builtin_cpu_supports("ssse3")) {
+            return KERNEL_SSSE3;
+        }
+        return KERNEL_SCALAR;
+    }();
+    return level;
+#else
+    return KERNEL_SCALAR;
+#endif
+}
+
+/* tables: [0] = low nibble products, [1] = high nibble products */
+inline void mulAdd8Scalar(uint8_t* dst, const uint8_t* src, const uint8_t tables[2][16], size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        dst[i] ^= tables[0][src[i] & 0xF] ^ tables[1][src[i] >> 4];
+    }
+}
+
+/* tables: [2 * nibble] = low byte, [2 * nibble + 1] = high byte of the product, nibble 0 is the lowest */
+inline void mulAdd16Scalar(uint8_t* dst, const uint8_t* src, const uint8_t tables[8][16], size_t len) {
+    for(size_t i = 0; i + 1 < len; i += 2) {
+        uint8_t hi = src[i];
+        uint8_t lo = src[i + 1];
+
+        dst[i]     ^= tables[1][lo & 0xF] ^ tables[3][lo >> 4] ^ tables[5][hi & 0xF] ^ tables[7][hi >> 4];
+        dst[i + 1] ^= tables[0][lo & 0xF] ^ tables[2][lo >> 4] ^ tables[4][hi & 0xF] ^ tables[6][hi >> 4];
+    }
+}
+
+#ifdef GFREGION_X86
+__attribute__((target("ssse3")))
+inline size_t mulAdd8SSSE3(uint8_t* dst, const uint8_t* src, const uint8_t tables[2][16], size_t len) {
+    const __m128i tableLo = _mm_loadu_si128((const __m128i*)tables[0]);
+    const __m128i tableHi = _mm_loadu_si128((const __m128i*)tables[1]);
+    const __m128i mask = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for(; i + 16 <= len; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_and_si128(in, mask);
+        __m128i hi = _mm_and_si128(_mm_srli_epi64(in, 4), mask);
+        __m128i product = _mm_xor_si128(_mm_shuffle_epi8(tableLo, lo), _mm_shuffle_epi8(tableHi, hi));
+        __m128i out = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(out, product));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+inline size_t mulAdd8AVX2(uint8_t* dst, const uint8_t* src, const uint8_t tables[2][16], size_t len) {
+    const __m256i tableLo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[0]));
+    const __m256i tableHi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[1]));
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for(; i + 32 <= len; i += 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i lo = _mm256_and_si256(in, mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi64(in, 4), mask);
+        __m256i product = _mm256_xor_si256(_mm256_shuffle_epi8(tableLo, lo), _mm256_shuffle_epi8(tableHi, hi));
+        __m256i out = _mm256_loadu_si256((const __m256i*)(dst + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(out, product));
+    }
+
+    return i;
+}
+
+/*
+ * The big endian symbols are split in a vector of high bytes and one of low bytes first,
+ * the products are interleaved again afterwards.
+ */
+__attribute__((target("ssse3")))
+inline size_t mulAdd16SSSE3(uint8_t* dst, const uint8_t* src, const uint8_t tables[8][16], size_t len) {
+    __m128i t[8];
+    for(unsigned int j = 0; j < 8; j++) {
+        t[j] = _mm_loadu_si128((const __m128i*)tables[j]);
+    }
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+    size_t i = 0;
+    for(; i + 32 <= len; i += 32) {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), split);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i + 16)), split);
+        __m128i hi = _mm_unpacklo_epi64(a, b);
+        __m128i lo = _mm_unpackhi_epi64(a, b);
+
+        __m128i n0 = _mm_and_si128(lo, mask);
+        __m128i n1 = _mm_and_si128(_mm_srli_epi64(lo, 4), mask);
+        __m128i n2 = _mm_and_si128(hi, mask);
+        __m128i n3 = _mm_and_si128(_mm_srli_epi64(hi, 4), mask);
+
+        __m128i productLo = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(t[0], n0), _mm_shuffle_epi8(t[2], n1)),
+                                          _mm_xor_si128(_mm_shuffle_epi8(t[4], n2), _mm_shuffle_epi8(t[6], n3)));
+        __m128i productHi = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(t[1], n0), _mm_shuffle_epi8(t[3], n1)),
+                                          _mm_xor_si128(_mm_shuffle_epi8(t[5], n2), _mm_shuffle_epi8(t[7], n3)));
+
+        __m128i outA = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i outB = _mm_loadu_si128((const __m128i*)(dst + i + 16));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(outA, _mm_unpacklo_epi8(productHi, productLo)));
+        _mm_storeu_si128((__m128i*)(dst + i + 16), _mm_xor_si128(outB, _mm_unpackhi_epi8(productHi, productLo)));
+    }
+
+    return i;
+}
+
+/* Same as above, every operation stays within 128 bit lanes so the split is undone exactly */
+__attribute__((target("avx2")))
+inline size_t mulAdd16AVX2(uint8_t* dst, const uint8_t* src, const uint8_t tables[8][16], size_t len) {
+    __m256i t[8];
+    for(unsigned int j = 0; j < 8; j++) {
+        t[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[j]));
+    }
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i split = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                           0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+    size_t i = 0;
+    for(; i + 64 <= len; i += 64) {
+        __m256i a = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), split);
+        __m256i b = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i + 32)), split);
+        __m256i hi = _mm256_unpacklo_epi64(a, b);
+        __m256i lo = _mm256_unpackhi_epi64(a, b);
+
+        __m256i n0 = _mm256_and_si256(lo, mask);
+        __m256i n1 = _mm256_and_si256(_mm256_srli_epi64(lo, 4), mask);
+        __m256i n2 = _mm256_and_si256(hi, mask);
+        __m256i n3 = _mm256_and_si256(_mm256_srli_epi64(hi, 4), mask);
+
+        __m256i productLo = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(t[0], n0), _mm256_shuffle_epi8(t[2], n1)),
+                                             _mm256_xor_si256(_mm256_shuffle_epi8(t[4], n2), _mm256_shuffle_epi8(t[6], n3)));
+        __m256i productHi = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(t[1], n0), _mm256_shuffle_epi8(t[3], n1)),
+                                             _mm256_xor_si256(_mm256_shuffle_epi8(t[5], n2), _mm256_shuffle_epi8(t[7], n3)));
+
+        __m256i outA = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i outB = _mm256_loadu_si256((const __m256i*)(dst + i + 32));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(outA, _mm256_unpacklo_epi8(productHi, productLo)));
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), _mm256_xor_si256(outB, _mm256_unpackhi_epi8(productHi, productLo)));
+    }
+
+    return i;
+}
+#endif
+
+inline void mulAdd8(uint8_t* dst, const uint8_t* src, const uint8_t tables[2][16], size_t len) {
+    size_t done = 0;
+
+#ifdef GFREGION_X86
+    switch(kernelLevel()) {
+    case KERNEL_AVX2:
+        done = mulAdd8AVX2(dst, src, tables, len);
+        break;
+    case KERNEL_SSSE3:
+        done = mulAdd8SSSE3(dst, src, tables, len);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    mulAdd8Scalar(dst + done, src + done, tables, len - done);
+}
+
+inline void mulAdd16(uint8_t* dst, const uint8_t* src, const uint8_t tables[8][16], size_t len) {
+    size_t done = 0;
+
+#ifdef GFREGION_X86
+    switch(kernelLevel()) {
+    case KERNEL_AVX2:
+        done = mulAdd16AVX2(dst, src, tables, len);
+        break;
+    case KERNEL_SSSE3:
+        done = mulAdd16SSSE3(dst, src, tables, len);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    mulAdd16Scalar(dst + done, src + done, tables, len - done);
+}
+
+inline void xorRegion(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for(; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        __builtin_memcpy(&a, dst + i, 8);
+        __builtin_memcpy(&b, src + i, 8);
+        a ^= b;
+        __builtin_memcpy(dst + i, &a, 8);
+    }
+    for(; i < len; i++) {
+        dst[i] ^= src[i];
+    }
+}
+
+}
+
+#endif /* GFREGION_H_ */
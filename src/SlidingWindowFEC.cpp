@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SlidingWindowFEC.h"
+#include "GF256Number.h"
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+
+using RSGF256Number = GF256Number<>;
+
+class SlidingWindowFEC::impl {
+public:
+    static void init() {
+        RSGF256Number::init();
+    }
+
+    impl() {
+        reset(false, 0);
+    }
+
+    void reset(bool encode, unsigned int windowSize) {
+        isEncoder_ = encode;
+        windowSize_ = windowSize;
+        window_.clear();
+        queued_.clear();
+        nextSequence_ = 0;
+        repairSeed_ = 0;
+        known_.clear();
+        equations_.clear();
+        decoderStarted_ = false;
+        nextRelease_ = 0;
+        newest_ = 0;
+        lost_ = 0;
+
+        if(isEncoder_ && (windowSize_ < 1 || windowSize_ > MAX_WINDOW)) {
+            throw std::runtime_error("Window must be 1 to 256 packets");
+        }
+    }
+
+    void operator<<(std::vector<uint8_t>&& packet) {
+        if(isEncoder_) {
+            encoderLoad(std::move(packet));
+        } else {
+            decoderLoad(std::move(packet));
+        }
+    }
+
+    unsigned int requestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        unsigned int count = 0;
+        for(count = 0; count < numPackets; count++) {
+            if(isEncoder_) {
+                if(queued_.size()) {
+                    packets.push_back(std::move(queued_.front()));
+                    queued_.pop_front();
+                } else if(window_.size()) {
+                    packets.push_back(encoderRepair());
+                } else {
+                    break;
+                }
+            } else {
+                if(!queued_.size()) {
+                    break;
+                }
+                packets.push_back(std::move(queued_.front()));
+                queued_.pop_front();
+            }
+        }
+
+        return count;
+    }
+
+    unsigned int lostPackets() {
+        return lost_;
+    }
+
+private:
+    static const unsigned int MAX_WINDOW = 256;
+
+    /* Source: sequence, window - 1, type. Repair: first sequence, count - 1, seed, type. */
+    static const size_t SOURCE_TRAILER_SIZE = 6;
+    static const size_t REPAIR_TRAILER_SIZE = 8;
+    enum PacketType {
+        TYPE_SOURCE = 0,
+        TYPE_REPAIR = 1,
+    };
+
+    /*
+     * A symbol is the packet preceded by its 16 bit length. Shorter symbols are padded with
+     * zeros, so combinations of symbols of different lengths stay aligned.
+     */
+    static const size_t LENGTH_SIZE = 2;
+
+    /*
+     * The decoder works with 64 bit sequence numbers, so the 32 bit ones on the wire can wrap.
+     * They start at 2^32, so packets from before the first one received stay positive.
+     */
+    static const uint64_t SEQUENCE_BASE = 1ULL << 32;
+
+    struct Equation {
+        std::map<uint64_t, uint8_t> unknowns;
+        std::vector<uint8_t> data;
+    };
+
+    bool isEncoder_;
+    unsigned int windowSize_;
+
+    /* Encoder: symbols of the current window. Decoder: packets ready to be read. */
+    std::deque<std::vector<uint8_t>> window_;
+    std::deque<std::vector<uint8_t>> queued_;
+    uint32_t nextSequence_;
+    uint16_t repairSeed_;
+
+    std::map<uint64_t, std::vector<uint8_t>> known_;
+    std::vector<Equation> equations_;
+    bool decoderStarted_;
+    uint64_t nextRelease_;
+    uint64_t newest_;
+    unsigned int lost_;
+
+    static uint8_t coefficient(uint32_t firstSequence, uint16_t seed, unsigned int index) {
+        uint64_t z = ((uint64_t)firstSequence << 32) ^ ((uint64_t)seed << 16) ^ index;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+
+        return 1 + z % 255;
+    }
+
+    static void writeUint(std::vector<uint8_t>& packet, uint32_t value, unsigned int bytes) {
+        for(unsigned int i = bytes; i-- > 0;) {
+            packet.push_back(value >> (8 * i));
+        }
+    }
+
+    static uint32_t readUint(const uint8_t* data, unsigned int bytes) {
+        uint32_t value = 0;
+        for(unsigned int i = 0; i < bytes; i++) {
+            value = (value << 8) | data[i];
+        }
+        return value;
+    }
+
+    void encoderLoad(std::vector<uint8_t>&& packet) {
+        if(!packet.size()) {
+            throw std::runtime_error("size() == 0 packets are not supported");
+        }
+
+        if(packet.size() > 0xFFFF) {
+            throw std::runtime_error("Packet too large");
+        }
+
+        std::vector<uint8_t> symbol;
+        symbol.reserve(LENGTH_SIZE + packet.size());
+        writeUint(symbol, packet.size(), LENGTH_SIZE);
+        symbol.insert(symbol.end(), packet.begin(), packet.end());
+
+        window_.push_back(std::move(symbol));
+        if(window_.size() > windowSize_) {
+            window_.pop_front();
+        }
+
+        writeUint(packet, nextSequence_++, 4);
+        packet.push_back(windowSize_ - 1);
+        packet.push_back(TYPE_SOURCE);
+        queued_.push_back(std::move(packet));
+    }
+
+    std::vector<uint8_t> encoderRepair() {
+        uint32_t firstSequence = nextSequence_ - window_.size();
+        uint16_t seed = repairSeed_++;
+
+        size_t longest = 0;
+        for(auto& symbol: window_) {
+            longest = std::max(longest, symbol.size());
+        }
+
+        std::vector<uint8_t> packet(longest);
+        for(unsigned int i = 0; i < window_.size(); i++) {
+            RSGF256Number::mulAddRegion(packet.data(), window_[i].data(), coefficient(firstSequence, seed, i), window_[i].size());
+        }
+
+        writeUint(packet, firstSequence, 4);
+        packet.push_back(window_.size() - 1);
+        writeUint(packet, seed, 2);
+        packet.push_back(TYPE_REPAIR);
+
+        return packet;
+    }
+
+    void decoderLoad(std::vector<uint8_t>&& packet) {
+        if(packet.size() <= SOURCE_TRAILER_SIZE) {
+            return;
+        }
+
+        uint8_t type = packet.back();
+        if(type == TYPE_SOURCE) {
+            const uint8_t* trailer = &packet[packet.size() - SOURCE_TRAILER_SIZE];
+            uint32_t wireSequence = readUint(trailer, 4);
+            unsigned int windowSize = trailer[4] + 1;
+
+            packet.resize(packet.size() - SOURCE_TRAILER_SIZE);
+            decoderStart(wireSequence, windowSize);
+            uint64_t sequence = unwrap(wireSequence);
+
+            if(known_.count(sequence)) {
+                return;
+            }
+
+            std::vector<uint8_t> symbol;
+            symbol.reserve(LENGTH_SIZE + packet.size());
+            writeUint(symbol, packet.size(), LENGTH_SIZE);
+            symbol.insert(symbol.end(), packet.begin(), packet.end());
+
+            newest_ = std::max(newest_, sequence);
+            decoderAddKnown(sequence, std::move(symbol));
+
+        } else if(type == TYPE_REPAIR && packet.size() > REPAIR_TRAILER_SIZE + LENGTH_SIZE) {
+            const uint8_t* trailer = &packet[packet.size() - REPAIR_TRAILER_SIZE];
+            uint32_t firstSequence = readUint(trailer, 4);
+            unsigned int count = trailer[4] + 1;
+            uint16_t seed = readUint(trailer + 5, 2);
+
+            packet.resize(packet.size() - REPAIR_TRAILER_SIZE);
+            decoderStart(firstSequence, count);
+            uint64_t first = unwrap(firstSequence);
+            newest_ = std::max(newest_, first + count - 1);
+
+            Equation equation;
+            equation.data = std::move(packet);
+
+            for(unsigned int i = 0; i < count; i++) {
+                uint64_t sequence = first + i;
+                uint8_t c = coefficient(firstSequence, seed, i);
+
+                auto it = known_.find(sequence);
+                if(it == known_.end()) {
+                    equation.unknowns[sequence] = c;
+                } else {
+                    /* The repair covers every symbol in its window */
+                    if(it->second.size() > equation.data.size()) {
+                        return;
+                    }
+                    RSGF256Number::mulAddRegion(equation.data.data(), it->second.data(), c, it->second.size());
+                }
+            }
+
+            if(!equation.unknowns.size()) {
+                return;
+            }
+
+            equations_.push_back(std::move(equation));
+            decoderReduce();
+        } else {
+            return;
+        }
+
+        decoderRelease();
+    }
+
+    void decoderStart(uint32_t sequence, unsigned int windowSize) {
+        windowSize_ = std::max(windowSize_, windowSize);
+
+        if(!decoderStarted_) {
+            decoderStarted_ = true;
+            nextRelease_ = SEQUENCE_BASE + sequence;
+            newest_ = nextRelease_;
+        }
+    }
+
+    /* Serial number arithmetic: the 64 bit sequence number closest to the newest one */
+    uint64_t unwrap(uint32_t sequence) {
+        return newest_ + (int32_t)(sequence - (uint32_t)newest_);
+    }
+
+    /* A symbol became known, remove it from all equations */
+    void decoderAddKnown(uint64_t sequence, std::vector<uint8_t>&& symbol) {
+        bool reduce = false;
+
+        for(auto& equation: equations_) {
+            auto it = equation.unknowns.find(sequence);
+            if(it == equation.unknowns.end()) {
+                continue;
+            }
+
+            if(equation.data.size() < symbol.size()) {
+                equation.data.resize(symbol.size());
+            }
+            RSGF256Number::mulAddRegion(equation.data.data(), symbol.data(), it->second, symbol.size());
+            equation.unknowns.erase(it);
+            reduce = true;
+        }
+
+        known_[sequence] = std::move(symbol);
+
+        if(reduce) {
+            decoderReduce();
+        }
+    }
+
+    /* Gauss-Jordan elimination over the equations, equations with one unknown are solved */
+    void decoderReduce() {
+        std::vector<uint64_t> unknowns;
+        for(auto& equation: equations_) {
+            for(auto& term: equation.unknowns) {
+                unknowns.push_back(term.first);
+            }
+        }
+        std::sort(unknowns.begin(), unknowns.end());
+        unknowns.erase(std::unique(unknowns.begin(), unknowns.end()), unknowns.end());
+
+        unsigned int pivots = 0;
+        for(uint64_t unknown: unknowns) {
+            unsigned int row = pivots;
+            while(row < equations_.size() && !equations_[row].unknowns.count(unknown)) {
+                row++;
+            }
+            if(row == equations_.size()) {
+                continue;
+            }
+            std::swap(equations_[row], equations_[pivots]);
+            Equation& pivot = equations_[pivots];
+
+            uint8_t scale = RSGF256Number(1) / RSGF256Number(pivot.unknowns[unknown]);
+            if(scale != 1) {
+                for(auto& term: pivot.unknowns) {
+                    term.second = RSGF256Number(term.second) * RSGF256Number(scale);
+                }
+                /* x * c == x + x * (c + 1) */
+                RSGF256Number::mulAddRegion(pivot.data.data(), pivot.data.data(), scale ^ 1, pivot.data.size());
+            }
+
+            for(unsigned int r = 0; r < equations_.size(); r++) {
+                auto it = equations_[r].unknowns.find(unknown);
+                if(r == pivots || it == equations_[r].unknowns.end()) {
+                    continue;
+                }
+
+                Equation& target = equations_[r];
+                uint8_t factor = it->second;
+                for(auto& term: pivot.unknowns) {
+                    uint8_t value = target.unknowns[term.first] ^ (RSGF256Number(term.second) * RSGF256Number(factor));
+                    if(value) {
+                        target.unknowns[term.first] = value;
+                    } else {
+                        target.unknowns.erase(term.first);
+                    }
+                }
+
+                if(target.data.size() < pivot.data.size()) {
+                    target.data.resize(pivot.data.size());
+                }
+                RSGF256Number::mulAddRegion(target.data.data(), pivot.data.data(), factor, pivot.data.size());
+            }
+
+            pivots++;
+        }
+
+        /* Solved symbols are removed from the system, this can solve others */
+        std::vector<std::pair<uint64_t, std::vector<uint8_t>>> solved;
+        for(unsigned int r = 0; r < equations_.size();) {
+            Equation& equation = equations_[r];
+
+            if(equation.unknowns.size() == 1) {
+                std::vector<uint8_t>& symbol = equation.data;
+                size_t length = symbol.size() >= LENGTH_SIZE? readUint(symbol.data(), LENGTH_SIZE) : 0;
+
+                if(length && length + LENGTH_SIZE <= symbol.size()) {
+                    symbol.resize(length + LENGTH_SIZE);
+                    solved.push_back(std::make_pair(equation.unknowns.begin()->first, std::move(symbol)));
+                }
+            } else if(equation.unknowns.size()) {
+                r++;
+                continue;
+            }
+
+            equations_.erase(equations_.begin() + r);
+        }
+
+        for(auto& symbol: solved) {
+            if(!known_.count(symbol.first)) {
+                decoderAddKnown(symbol.first, std::move(symbol.second));
+            }
+        }
+    }
+
+    void decoderRelease() {
+        while(true) {
+            auto it = known_.find(nextRelease_);
+            if(it != known_.end()) {
+                std::vector<uint8_t>& symbol = it->second;
+                queued_.push_back(std::vector<uint8_t>(symbol.begin() + LENGTH_SIZE, symbol.end()));
+            } else if(nextRelease_ + windowSize_ <= newest_) {
+                /* Future repair packets can't cover this packet anymore */
+                lost_++;
+            } else {
+                break;
+            }
+            nextRelease_++;
+        }
+
+        /* Forget what no future repair packet can refer to */
+        uint64_t horizon = newest_ - std::min<uint64_t>(newest_, 2 * windowSize_);
+        while(known_.size() && known_.begin()->first < horizon && known_.begin()->first < nextRelease_) {
+            known_.erase(known_.begin());
+        }
+
+        for(unsigned int r = 0; r < equations_.size();) {
+            if(equations_[r].unknowns.rbegin()->first < horizon) {
+                equations_.erase(equations_.begin() + r);
+            } else {
+                r++;
+            }
+        }
+    }
+};
+
+void SlidingWindowFEC::init() {
+    SlidingWindowFEC::impl::init();
+}
+
+SlidingWindowFEC::SlidingWindowFEC():
+    impl_(new impl()) {
+}
+
+void SlidingWindowFEC::reset(bool encode, unsigned int windowSize) {
+    impl_->reset(encode, windowSize);
+}
+
+void SlidingWindowFEC::operator<<(const std::vector<uint8_t>& packet) {
+    impl_->operator<<(std::vector<uint8_t>(packet));
+}
+
+void SlidingWindowFEC::operator<<(std::vector<uint8_t>&& packet) {
+    impl_->operator<<(std::move(packet));
+}
+
+unsigned int SlidingWindowFEC::requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+    return impl_->requestPackets(outputPackets, numPackets);
+}
+
+bool SlidingWindowFEC::operator>>(std::vector<uint8_t>& outputPacket) {
+    std::vector<std::vector<uint8_t>> tmp;
+
+    if(impl_->requestPackets(tmp, 1)) {
+        outputPacket = std::move(tmp[0]);
+        return true;
+    }
+
+    return false;
+}
+
+unsigned int SlidingWindowFEC::lostPackets() {
+    return impl_->lostPackets();
+}
+
+SlidingWindowFEC::~SlidingWindowFEC() = default;
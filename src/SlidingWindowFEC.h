@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <memory>
+#include "CauchyFEC.h"
+
+#ifndef SLIDINGWINDOWFEC_H_
+#define SLIDINGWINDOWFEC_H_
+
+/*
+ * Sliding window random linear code for low latency streams. Source packets are sent as
+ * they arrive, every repair packet is a random GF(2^8) combination of the last (up to)
+ * windowSize source packets and is identified by the first sequence number it covers and
+ * a seed. The decoder keeps reducing the equations it received and releases every source
+ * packet in order as soon as it is received or decodable. A packet that is missing when
+ * no future repair packet can cover it anymore is skipped.
+ *
+ * Encoder: every call to operator<< queues one source packet. requestPackets() returns the
+ * queued source packets first, when none are left it generates repair packets.
+ */
+class SlidingWindowFEC {
+public:
+    static CAUCHYFEC_H_EXPORT_FUNCTION void init();
+    CAUCHYFEC_H_EXPORT_FUNCTION SlidingWindowFEC();
+    CAUCHYFEC_H_EXPORT_FUNCTION ~SlidingWindowFEC();
+
+    /* The window is at most 256 packets. The decoder learns it from the repair packets. */
+    void CAUCHYFEC_H_EXPORT_FUNCTION reset(bool encode, unsigned int windowSize = 0);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<uint8_t>& packet);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(std::vector<uint8_t>&& packet);
+    unsigned int CAUCHYFEC_H_EXPORT_FUNCTION requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets = 1);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<uint8_t>& outputPacket);
+
+    /* Decoder: number of source packets that were skipped because they could not be decoded */
+    unsigned int CAUCHYFEC_H_EXPORT_FUNCTION lostPackets();
+
+private:
+    class impl;
+    std::unique_ptr<impl> impl_;
+};
+
+#endif /* SLIDINGWINDOWFEC_H_ */
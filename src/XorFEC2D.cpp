@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "XorFEC2D.h"
+#include "GFRegion.h"
+#include <algorithm>
+#include <stdexcept>
+
+class XorFEC2D::impl {
+public:
+    impl() {
+        reset(false, 0, 0);
+    }
+
+    void reset(bool encode, unsigned int columns, unsigned int rows) {
+        isEncoder_ = encode;
+        numColumns_ = columns;
+        numSourcePackets_ = columns * rows;
+        sourcePackets_.clear();
+        parityPackets_.clear();
+        packetsReturned_ = 0;
+        encoderReadingSourcePackets_ = true;
+        decoderWaitingFirstPacket_ = true;
+
+        if(!isEncoder_) {
+            return;
+        }
+
+        if(!columns || !rows) {
+            throw std::runtime_error("At least one row and one column are needed");
+        }
+
+        /* Source and parity packets share the 16 bit index */
+        if(columns > MAX_COLUMNS || numSourcePackets_ + columns + rows > MAX_PACKETS) {
+            throw std::runtime_error("Too many source packets");
+        }
+    }
+
+    void operator<<(const std::vector<uint8_t>& packet) {
+        operator<<(std::vector<uint8_t>(packet));
+    }
+
+    void operator<<(std::vector<uint8_t>&& packet) {
+        if(isEncoder_) {
+            encoderLoad(std::move(packet));
+        } else {
+            decoderLoad(std::move(packet));
+        }
+    }
+
+    void operator<<(const std::vector<std::vector<uint8_t>>& packets) {
+        for(auto& packet: packets) {
+            operator<<(packet);
+        }
+    }
+
+    unsigned int requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+        if(isEncoder_) {
+            return encoderRequestPackets(outputPackets, numPackets);
+        } else {
+            return decoderRequestPackets(outputPackets, numPackets);
+        }
+    }
+
+    bool operator>>(std::vector<uint8_t>& outputPacket) {
+        std::vector<std::vector<uint8_t>> tmp;
+
+        if(requestPackets(tmp, 1)) {
+            outputPacket = std::move(tmp[0]);
+            return true;
+        }
+
+        return false;
+    }
+
+    void flush() {
+        if(!isEncoder_ || sourcePackets_.size() == numSourcePackets_) {
+            return;
+        }
+
+        if(!sourcePackets_.size()) {
+            throw std::runtime_error("At least one source packet is needed");
+        }
+
+        numSourcePackets_ = sourcePackets_.size();
+    }
+
+private:
+    static const size_t TRAILER_SIZE = 5;
+    static const size_t LENGTH_SIZE = 2;
+    static const unsigned int MAX_COLUMNS = 256;
+    static const unsigned int MAX_PACKETS = 65536;
+
+    bool isEncoder_;
+    unsigned int numColumns_;
+    unsigned int numSourcePackets_;
+    unsigned int packetsReturned_;
+
+    /* Source packets without trailer, parity packets (column parity first) without trailer */
+    std::vector<std::vector<uint8_t>> sourcePackets_;
+    std::vector<std::vector<uint8_t>> parityPackets_;
+
+    bool encoderReadingSourcePackets_;
+    bool decoderWaitingFirstPacket_;
+
+    /* A flushed block has a shorter last row, and maybe fewer columns */
+    unsigned int usedColumns() {
+        return std::min(numColumns_, numSourcePackets_);
+    }
+
+    unsigned int usedRows() {
+        return (numSourcePackets_ + numColumns_ - 1) / numColumns_;
+    }
+
+    unsigned int numParityPackets() {
+        return usedColumns() + usedRows();
+    }
+
+    /* Parity packet index to source packet: column parity first, then row parity */
+    bool groupMember(unsigned int parity, unsigned int member, unsigned int& source) {
+        if(parity < usedColumns()) {
+            source = parity + member * numColumns_;
+        } else {
+            unsigned int row = parity - usedColumns();
+            if(member >= numColumns_) {
+                return false;
+            }
+            source = row * numColumns_ + member;
+        }
+        return source < numSourcePackets_;
+    }
+
+    void writeTrailer(std::vector<uint8_t>& packet, unsigned int index) {
+        packet.push_back(index >> 8);
+        packet.push_back(index);
+        packet.push_back((numSourcePackets_ - 1) >> 8);
+        packet.push_back(numSourcePackets_ - 1);
+        packet.push_back(numColumns_ - 1);
+    }
+
+    void readTrailer(const std::vector<uint8_t>& packet, unsigned int& index, unsigned int& sourcePackets, unsigned int& columns) {
+        const uint8_t* trailer = &packet[packet.size() - TRAILER_SIZE];
+
+        index = (trailer[0] << 8) | trailer[1];
+        sourcePackets = ((trailer[2] << 8) | trailer[3]) + 1;
+        columns = trailer[4] + 1;
+    }
+
+    /* parity += [packet, zero padding][length] */
+    static void addToParity(std::vector<uint8_t>& parity, const std::vector<uint8_t>& packet) {
+        size_t dataLength = parity.size() - LENGTH_SIZE;
+
+        GFRegion::xorRegion(parity.data(), packet.data(), packet.size());
+        parity[dataLength] ^= packet.size() >> 8;
+        parity[dataLength + 1] ^= packet.size() & 0xFF;
+    }
+
+    void encoderLoad(std::vector<uint8_t>&& packet) {
+        if(!packet.size()) {
+            throw std::runtime_error("size() == 0 packets are not supported");
+        }
+
+        if(!encoderReadingSourcePackets_) {
+            throw std::runtime_error("Reset required");
+        }
+
+        if(sourcePackets_.size() >= numSourcePackets_) {
+            throw std::runtime_error("Encoder is full");
+        }
+
+        if(packet.size() > 0xFFFF) {
+            throw std::runtime_error("Packet too large");
+        }
+
+        sourcePackets_.push_back(std::move(packet));
+    }
+
+    void encoderCalculateParity() {
+        parityPackets_.resize(numParityPackets());
+
+        for(unsigned int parity = 0; parity < parityPackets_.size(); parity++) {
+            /* Every parity packet is only as long as the longest packet it covers */
+            size_t longest = 0;
+            unsigned int source;
+            for(unsigned int member = 0; groupMember(parity, member, source); member++) {
+                longest = std::max(longest, sourcePackets_[source].size());
+            }
+
+            parityPackets_[parity].assign(longest + LENGTH_SIZE, 0);
+            for(unsigned int member = 0; groupMember(parity, member, source); member++) {
+                addToParity(parityPackets_[parity], sourcePackets_[source]);
+            }
+        }
+    }
+
+    unsigned int encoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        unsigned int count = 0;
+        for(count = 0; count < numPackets; count++) {
+            std::vector<uint8_t> outputPacket;
+
+            if(packetsReturned_ < numSourcePackets_) {
+                /* Are enough source packets loaded? */
+                if(packetsReturned_ >= sourcePackets_.size()) {
+                    break;
+                }
+
+                outputPacket = sourcePackets_[packetsReturned_];
+
+            } else if(packetsReturned_ < numSourcePackets_ + numParityPackets()) {
+                if(!parityPackets_.size()) {
+                    if(sourcePackets_.size() < numSourcePackets_) {
+                        break;
+                    }
+
+                    encoderReadingSourcePackets_ = false;
+                    encoderCalculateParity();
+                }
+
+                outputPacket = std::move(parityPackets_[packetsReturned_ - numSourcePackets_]);
+
+            } else {
+                break;
+            }
+
+            writeTrailer(outputPacket, packetsReturned_);
+            packets.push_back(std::move(outputPacket));
+            packetsReturned_++;
+        }
+
+        return count;
+    }
+
+    void decoderLoad(std::vector<uint8_t>&& packet) {
+        if(packet.size() <= TRAILER_SIZE) {
+            return;
+        }
+
+        unsigned int index, announcedSourcePackets, columns;
+        readTrailer(packet, index, announcedSourcePackets, columns);
+        packet.resize(packet.size() - TRAILER_SIZE);
+
+        if(decoderWaitingFirstPacket_) {
+            decoderWaitingFirstPacket_ = false;
+            numSourcePackets_ = announcedSourcePackets;
+            numColumns_ = columns;
+            sourcePackets_.resize(numSourcePackets_);
+            parityPackets_.resize(numParityPackets());
+        } else {
+            if(columns != numColumns_) {
+                return;
+            }
+
+            if(announcedSourcePackets != numSourcePackets_ && !decoderShortenBlock(announcedSourcePackets, index)) {
+                return;
+            }
+        }
+
+        if(index < numSourcePackets_) {
+            if(!sourcePackets_[index].size()) {
+                sourcePackets_[index] = std::move(packet);
+            }
+        } else if(index - numSourcePackets_ < parityPackets_.size() && packet.size() > LENGTH_SIZE) {
+            if(!parityPackets_[index - numSourcePackets_].size()) {
+                parityPackets_[index - numSourcePackets_] = std::move(packet);
+            }
+        }
+    }
+
+    bool decoderShortenBlock(unsigned int announcedSourcePackets, unsigned int packetIndex) {
+        /* Source packets of a flushed block are identical in both codes */
+        if(announcedSourcePackets > numSourcePackets_) {
+            return packetIndex < numSourcePackets_;
+        }
+
+        /* Shrink the block, this is only possible if no packet contradicts the shorter code */
+        for(auto& packet: parityPackets_) {
+            if(packet.size()) {
+                return false;
+            }
+        }
+
+        for(unsigned int i = announcedSourcePackets; i < numSourcePackets_; i++) {
+            if(sourcePackets_[i].size()) {
+                return false;
+            }
+        }
+
+        numSourcePackets_ = announcedSourcePackets;
+        sourcePackets_.resize(numSourcePackets_);
+        parityPackets_.resize(numParityPackets());
+
+        return true;
+    }
+
+    /* Single erasure repair over all rows and columns, until no more packets are found */
+    void decoderRecover() {
+        bool progress = true;
+
+        while(progress) {
+            progress = false;
+
+            for(unsigned int parity = 0; parity < parityPackets_.size(); parity++) {
+                if(!parityPackets_[parity].size()) {
+                    continue;
+                }
+
+                unsigned int missing = 0, missingSource = 0, source;
+                for(unsigned int member = 0; groupMember(parity, member, source); member++) {
+                    if(!sourcePackets_[source].size()) {
+                        missing++;
+                        missingSource = source;
+                    }
+                }
+                if(missing != 1) {
+                    continue;
+                }
+
+                std::vector<uint8_t> recovered(std::move(parityPackets_[parity]));
+                parityPackets_[parity].clear();
+
+                bool valid = true;
+                for(unsigned int member = 0; groupMember(parity, member, source); member++) {
+                    if(source != missingSource) {
+                        if(sourcePackets_[source].size() > recovered.size() - LENGTH_SIZE) {
+                            valid = false;
+                            break;
+                        }
+                        addToParity(recovered, sourcePackets_[source]);
+                    }
+                }
+
+                size_t dataLength = recovered.size() - LENGTH_SIZE;
+                size_t length = (recovered[dataLength] << 8) | recovered[dataLength + 1];
+                if(!valid || !length || length > dataLength) {
+                    continue;
+                }
+
+                recovered.resize(length);
+                sourcePackets_[missingSource] = std::move(recovered);
+                progress = true;
+            }
+        }
+    }
+
+    unsigned int decoderRequestPackets(std::vector<std::vector<uint8_t>>& packets, unsigned int numPackets) {
+        unsigned int count = 0;
+        for(count = 0; count < numPackets; count++) {
+            if(decoderWaitingFirstPacket_ || packetsReturned_ >= numSourcePackets_) {
+                break;
+            }
+
+            if(!sourcePackets_[packetsReturned_].size()) {
+                decoderRecover();
+
+                if(!sourcePackets_[packetsReturned_].size()) {
+                    break;
+                }
+            }
+
+            packets.push_back(sourcePackets_[packetsReturned_]);
+            packetsReturned_++;
+        }
+
+        return count;
+    }
+};
+
+XorFEC2D::XorFEC2D():
+    impl_(new impl()) {
+}
+
+void XorFEC2D::reset(bool encode, unsigned int columns, unsigned int rows) {
+    impl_->reset(encode, columns, rows);
+}
+
+void XorFEC2D::operator<<(const std::vector<uint8_t>& sourcePacket) {
+    impl_->operator<<(sourcePacket);
+}
+
+void XorFEC2D::operator<<(std::vector<uint8_t>&& sourcePacket) {
+    impl_->operator<<(std::move(sourcePacket));
+}
+
+void XorFEC2D::operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets) {
+    impl_->operator<<(sourcePackets);
+}
+
+unsigned int XorFEC2D::requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets) {
+    return impl_->requestPackets(outputPackets, numPackets);
+}
+
+bool XorFEC2D::operator>>(std::vector<uint8_t>& outputPacket) {
+    return impl_->operator>>(outputPacket);
+}
+
+bool XorFEC2D::operator>>(std::vector<std::vector<uint8_t>>& outputPackets) {
+    return impl_->requestPackets(outputPackets, 1) > 0;
+}
+
+void XorFEC2D::flush() {
+    impl_->flush();
+}
+
+XorFEC2D::~XorFEC2D() = default;
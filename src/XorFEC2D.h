@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <memory>
+#include "CauchyFEC.h"
+
+#ifndef XORFEC2D_H_
+#define XORFEC2D_H_
+
+/*
+ * Two dimensional XOR parity (SMPTE 2022-1 style) for links where GF multiplications cost
+ * too much CPU. The source packets are arranged row by row in a matrix of 'columns' wide
+ * and 'rows' high. Every column and every row gets a parity packet that is the XOR of its
+ * members, as the row of ones of the Cauchy generator. The decoder repeats single erasure
+ * repair over rows and columns until nothing changes.
+ *
+ * Packets use the CauchyFEC layout: source packets are sent unchanged, parity packets carry
+ * the XOR of the padded packets followed by the XOR of their 16 bit lengths. The trailer is
+ * the 16 bit index, the 16 bit number of source packets minus one and the number of columns
+ * minus one. Column parity packets are generated first, so requesting only 'columns' parity
+ * packets gives one dimensional column FEC. At most 256 columns, and the source and parity
+ * packets together (columns * rows + columns + rows) must not exceed 65536.
+ */
+class XorFEC2D {
+public:
+    CAUCHYFEC_H_EXPORT_FUNCTION XorFEC2D();
+    CAUCHYFEC_H_EXPORT_FUNCTION ~XorFEC2D();
+
+    void CAUCHYFEC_H_EXPORT_FUNCTION reset(bool encode, unsigned int columns = 0, unsigned int rows = 0);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<uint8_t>& sourcePacket);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(std::vector<uint8_t>&& sourcePacket);
+    void CAUCHYFEC_H_EXPORT_FUNCTION operator<<(const std::vector<std::vector<uint8_t>>& sourcePackets);
+    unsigned int CAUCHYFEC_H_EXPORT_FUNCTION requestPackets(std::vector<std::vector<uint8_t>>& outputPackets, unsigned int numPackets = 1);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<uint8_t>& outputPackets);
+    bool CAUCHYFEC_H_EXPORT_FUNCTION operator>>(std::vector<std::vector<uint8_t>>& outputPackets);
+
+    /* Encoder: close the block with the source packets loaded so far, the last row is shorter */
+    void CAUCHYFEC_H_EXPORT_FUNCTION flush();
+
+private:
+    class impl;
+    std::unique_ptr<impl> impl_;
+};
+
+#endif /* XORFEC2D_H_ */
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#ifndef ASYNCIO_H_
+#define ASYNCIO_H_
+
+/*
+ * Minimal io_uring queue on the raw system calls (no liburing). Reads and writes are tagged
+ * with a slot, wait(slot) blocks until everything queued for that slot is done. The slots
+ * are registered as fixed buffers when the kernel allows it. Without io_uring (old kernel,
+ * seccomp) valid() is false and the caller uses another path.
+ */
+class AsyncIO {
+public:
+    struct Buffer {
+        uint8_t* data;
+        size_t size;
+    };
+
+    AsyncIO(unsigned int depth, const std::vector<Buffer>& slots):
+        ringFd_(-1), sqRing_(nullptr), cqRing_(nullptr), sqes_(nullptr), sqRingSize_(0), cqRingSize_(0),
+        sqesSize_(0), fixedBuffers_(false), slots_(slots), pending_(slots.size(), 0), unsubmitted_(0), inFlight_(0) {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        ringFd_ = syscall(__NR_io_uring_setup, depth, &params);
+        if(ringFd_ < 0) {
+            return;
+        }
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if(params.features & IORING_FEAT_SINGLE_MMAP) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+
+        sqRing_ = (uint8_t*)mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+        if(sqRing_ == MAP_FAILED) {
+            sqRing_ = nullptr;
+            teardown();
+            return;
+        }
+
+        if(params.features & IORING_FEAT_SINGLE_MMAP) {
+            cqRing_ = sqRing_;
+        } else {
+            cqRing_ = (uint8_t*)mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+            if(cqRing_ == MAP_FAILED) {
+                cqRing_ = nullptr;
+                teardown();
+                return;
+            }
+        }
+
+        sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_ = (struct io_uring_sqe*)mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+        if(sqes_ == MAP_FAILED) {
+            sqes_ = nullptr;
+            teardown();
+            return;
+        }
+
+        sqHead_ = (uint32_t*)(sqRing_ + params.sq_off.head);
+        sqTail_ = (uint32_t*)(sqRing_ + params.sq_off.tail);
+        sqMask_ = *(uint32_t*)(sqRing_ + params.sq_off.ring_mask);
+        sqEntries_ = params.sq_entries;
+        sqArray_ = (uint32_t*)(sqRing_ + params.sq_off.array);
+        cqHead_ = (uint32_t*)(cqRing_ + params.cq_off.head);
+        cqTail_ = (uint32_t*)(cqRing_ + params.cq_off.tail);
+        cqMask_ = *(uint32_t*)(cqRing_ + params.cq_off.ring_mask);
+        cqEntries_ = params.cq_entries;
+        cqes_ = (struct io_uring_cqe*)(cqRing_ + params.cq_off.cqes);
+
+        /* Fixed buffers save the page pinning on every request, but need RLIMIT_MEMLOCK */
+        std::vector<struct iovec> iovecs(slots_.size());
+        for(unsigned int i = 0; i < slots_.size(); i++) {
+            iovecs[i].iov_base = slots_[i].data;
+            iovecs[i].iov_len = slots_[i].size;
+        }
+        fixedBuffers_ = syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size()) == 0;
+    }
+
+    ~AsyncIO() {
+        teardown();
+    }
+
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    bool valid() const {
+        return ringFd_ >= 0;
+    }
+
+    bool fixedBuffers() const {
+        return fixedBuffers_;
+    }
+
+    /* data must lie within the buffer of 'slot' */
+    void read(unsigned int slot, int fd, uint8_t* data, size_t length, uint64_t offset) {
+        queue(slot, fixedBuffers_? IORING_OP_READ_FIXED : IORING_OP_READ, fd, data, length, offset);
+    }
+
+    void write(unsigned int slot, int fd, const uint8_t* data, size_t length, uint64_t offset) {
+        queue(slot, fixedBuffers_? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, (uint8_t*)data, length, offset);
+    }
+
+    void submit() {
+        enter(0);
+    }
+
+    void wait(unsigned int slot) {
+        submit();
+        while(pending_[slot]) {
+            enter(1);
+        }
+    }
+
+    void waitAll() {
+        for(unsigned int slot = 0; slot < slots_.size(); slot++) {
+            wait(slot);
+        }
+    }
+
+private:
+    struct Request {
+        unsigned int slot;
+        uint8_t opcode;
+        int fd;
+        uint8_t* data;
+        size_t length;
+        uint64_t offset;
+    };
+
+    void queue(unsigned int slot, uint8_t opcode, int fd, uint8_t* data, size_t length, uint64_t offset) {
+        /* A request larger than the kernel takes at once is split */
+        while(length) {
+            size_t part = std::min<size_t>(length, 1 << 30);
+
+            unsigned int id = allocateRequest();
+            requests_[id] = Request{slot, opcode, fd, data, part, offset};
+            pending_[slot]++;
+            push(id);
+
+            data += part;
+            offset += part;
+            length -= part;
+        }
+    }
+
+    unsigned int allocateRequest() {
+        if(freeRequests_.empty()) {
+            requests_.push_back(Request());
+            return requests_.size() - 1;
+        }
+
+        unsigned int id = freeRequests_.back();
+        freeRequests_.pop_back();
+        return id;
+    }
+
+    void push(unsigned int id) {
+        uint32_t tail = *sqTail_;
+
+        /* Never more requests in flight than the completion queue holds */
+        while(inFlight_ >= cqEntries_) {
+            enter(1);
+        }
+
+        /* Submission queue full: hand it to the kernel and make room */
+        while(tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == sqEntries_) {
+            enter(0);
+            if(tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == sqEntries_) {
+                enter(1);
+            }
+        }
+
+        Request& request = requests_[id];
+        struct io_uring_sqe* sqe = &sqes_[tail & sqMask_];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = request.opcode;
+        sqe->fd = request.fd;
+        sqe->addr = (uint64_t)request.data;
+        sqe->len = request.length;
+        sqe->off = request.offset;
+        sqe->user_data = id;
+        if(request.opcode == IORING_OP_READ_FIXED || request.opcode == IORING_OP_WRITE_FIXED) {
+            sqe->buf_index = request.slot;
+        }
+
+        sqArray_[tail & sqMask_] = tail & sqMask_;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        unsubmitted_++;
+        inFlight_++;
+    }
+
+    void enter(unsigned int minComplete) {
+        int ret;
+        do {
+            ret = syscall(__NR_io_uring_enter, ringFd_, unsubmitted_, minComplete,
+                          minComplete? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        } while(ret < 0 && errno == EINTR);
+
+        if(ret < 0 && errno != EBUSY && errno != EAGAIN) {
+            throw std::runtime_error(std::string("io_uring_enter: ") + strerror(errno));
+        }
+        if(ret > 0) {
+            unsubmitted_ -= std::min<unsigned int>(ret, unsubmitted_);
+        }
+
+        reap();
+    }
+
+    void reap() {
+        uint32_t head = *cqHead_;
+        uint32_t tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+        for(; head != tail; head++) {
+            struct io_uring_cqe* cqe = &cqes_[head & cqMask_];
+            complete(cqe->user_data, cqe->res);
+        }
+
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+
+    void complete(unsigned int id, int result) {
+        Request& request = requests_[id];
+        bool isRead = request.opcode == IORING_OP_READ_FIXED || request.opcode == IORING_OP_READ;
+
+        if(result < 0) {
+            throw std::runtime_error(std::string(isRead? "read: " : "write: ") + strerror(-result));
+        }
+
+        /* Short transfers are finished synchronously, they are rare for regular files */
+        size_t done = result;
+        while(done < request.length) {
+            ssize_t ret = isRead? pread(request.fd, request.data + done, request.length - done, request.offset + done) :
+                                  pwrite(request.fd, request.data + done, request.length - done, request.offset + done);
+            if(ret < 0 && errno == EINTR) {
+                continue;
+            }
+            if(ret <= 0) {
+                throw std::runtime_error(std::string(isRead? "read: " : "write: ") + (ret? strerror(errno) : "end of file"));
+            }
+            done += ret;
+        }
+
+        pending_[request.slot]--;
+        inFlight_--;
+        freeRequests_.push_back(id);
+    }
+
+    void teardown() {
+        if(sqes_) {
+            munmap(sqes_, sqesSize_);
+        }
+        if(cqRing_ && cqRing_ != sqRing_) {
+            munmap(cqRing_, cqRingSize_);
+        }
+        if(sqRing_) {
+            munmap(sqRing_, sqRingSize_);
+        }
+        if(ringFd_ >= 0) {
+            close(ringFd_);
+        }
+        sqes_ = nullptr;
+        cqRing_ = sqRing_ = nullptr;
+        ringFd_ = -1;
+    }
+
+    int ringFd_;
+    uint8_t* sqRing_;
+    uint8_t* cqRing_;
+    struct io_uring_sqe* sqes_;
+    size_t sqRingSize_;
+    size_t cqRingSize_;
+    size_t sqesSize_;
+
+    uint32_t* sqHead_;
+    uint32_t* sqTail_;
+    uint32_t sqMask_;
+    uint32_t sqEntries_;
+    uint32_t* sqArray_;
+    uint32_t* cqHead_;
+    uint32_t* cqTail_;
+    uint32_t cqMask_;
+    uint32_t cqEntries_;
+    struct io_uring_cqe* cqes_;
+
+    bool fixedBuffers_;
+    std::vector<Buffer> slots_;
+    std::vector<unsigned int> pending_;
+    std::vector<Request> requests_;
+    std::vector<unsigned int> freeRequests_;
+    unsigned int unsubmitted_;
+    unsigned int inFlight_;
+};
+
+#endif /* ASYNCIO_H_ */
@@ -0,0 +1,718 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * File level erasure coding on top of CauchyFEC. The input file is memory mapped and cut in
+ * stripes of k symbols, every stripe gets m parity symbols. Shard file i holds symbol i of
+ * every stripe, behind a small header. Any k shards rebuild the file.
+ *
+ * By default the I/O goes through io_uring: while one stripe is encoded or decoded, the next
+ * one is read and the previous one written, from a fixed pool of three stripe buffers. If
+ * io_uring is not available (or with --mmap) the files are memory mapped instead. Symbols
+ * are then passed to the codec straight from the mapping and only the parity of the current
+ * stripe is held in memory. Either way the resident set stays bounded whatever the file size.
+ */
+
+#include "CauchyFEC.h"
+#include "AsyncIO.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const size_t HEADER_SIZE = 32;
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+static const uint8_t HEADER_MAGIC[4] = {'C', 'F', 'E', 'C'};
+static const unsigned int ASYNC_SLOTS = 3;
+static const unsigned int ASYNC_QUEUE_DEPTH = 256;
+
+struct ShardHeader {
+    CauchyFEC::Field field;
+    unsigned int sourceShards;
+    unsigned int parityShards;
+    unsigned int index;
+    size_t symbolSize;
+    uint64_t fileSize;
+};
+
+static void writeHeader(uint8_t* dst, const ShardHeader& header) {
+    memset(dst, 0, HEADER_SIZE);
+    memcpy(dst, HEADER_MAGIC, sizeof(HEADER_MAGIC));
+    dst[4] = 1;
+    dst[5] = header.field;
+    dst[6] = (header.sourceShards - 1) >> 8;
+    dst[7] = header.sourceShards - 1;
+    dst[8] = header.parityShards >> 8;
+    dst[9] = header.parityShards;
+    dst[10] = header.index >> 8;
+    dst[11] = header.index;
+    for(unsigned int i = 0; i < 4; i++) {
+        dst[12 + i] = header.symbolSize >> (8 * (3 - i));
+    }
+    for(unsigned int i = 0; i < 8; i++) {
+        dst[16 + i] = header.fileSize >> (8 * (7 - i));
+    }
+}
+
+static bool readHeader(const uint8_t* src, ShardHeader& header) {
+    if(memcmp(src, HEADER_MAGIC, sizeof(HEADER_MAGIC)) || src[4] != 1 || src[5] > CauchyFEC::FIELD_GF65536) {
+        return false;
+    }
+
+    header.field = (CauchyFEC::Field)src[5];
+    header.sourceShards = ((src[6] << 8) | src[7]) + 1;
+    header.parityShards = (src[8] << 8) | src[9];
+    header.index = (src[10] << 8) | src[11];
+    header.symbolSize = 0;
+    for(unsigned int i = 0; i < 4; i++) {
+        header.symbolSize = (header.symbolSize << 8) | src[12 + i];
+    }
+    header.fileSize = 0;
+    for(unsigned int i = 0; i < 8; i++) {
+        header.fileSize = (header.fileSize << 8) | src[16 + i];
+    }
+
+    return header.symbolSize && header.index < header.sourceShards + header.parityShards;
+}
+
+static void writeAll(int fd, const uint8_t* data, size_t length) {
+    while(length) {
+        ssize_t written = write(fd, data, length);
+        if(written < 0) {
+            throw std::runtime_error(std::string("write: ") + strerror(errno));
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+/* Read only mapping of a whole file, read front to back */
+class MappedFile {
+public:
+    MappedFile(const std::string& path, bool mustExist = true):
+        data_(nullptr), size_(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            if(mustExist) {
+                throw std::runtime_error(path + ": " + strerror(errno));
+            }
+            return;
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) < 0) {
+            close(fd);
+            throw std::runtime_error(path + ": " + strerror(errno));
+        }
+
+        size_ = st.st_size;
+        if(size_) {
+            void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(map == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error(path + ": " + strerror(errno));
+            }
+            data_ = (uint8_t*)map;
+            madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if(data_) {
+            munmap(data_, size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool valid() const {
+        return data_ != nullptr;
+    }
+
+    const uint8_t* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    /* Hint the kernel about the next window and drop the one we are done with */
+    void prefetch(size_t offset, size_t length) {
+        advise(offset, length, MADV_WILLNEED);
+    }
+
+    void release(size_t offset, size_t length) {
+        advise(offset, length, MADV_DONTNEED);
+    }
+
+private:
+    void advise(size_t offset, size_t length, int advice) {
+        if(!data_ || offset >= size_) {
+            return;
+        }
+
+        /* madvise works on whole pages */
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+        size_t start = offset & ~(pageSize - 1);
+        size_t end = std::min(size_, offset + length);
+        madvise(data_ + start, end - start, advice);
+    }
+
+    uint8_t* data_;
+    size_t size_;
+};
+
+/* Symbol buffers, huge page aligned so transparent huge pages can back them */
+class BufferPool {
+public:
+    BufferPool(unsigned int count, size_t size):
+        buffers_(count, nullptr) {
+        for(auto& buffer: buffers_) {
+            void* ptr;
+            if(posix_memalign(&ptr, HUGE_PAGE_SIZE, std::max<size_t>(size, 1))) {
+                throw std::runtime_error("Out of memory");
+            }
+            madvise(ptr, size, MADV_HUGEPAGE);
+            buffer = (uint8_t*)ptr;
+        }
+    }
+
+    ~BufferPool() {
+        for(auto buffer: buffers_) {
+            free(buffer);
+        }
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    uint8_t* operator[](unsigned int index) {
+        return buffers_[index];
+    }
+
+    uint8_t* const* data() {
+        return buffers_.data();
+    }
+
+private:
+    std::vector<uint8_t*> buffers_;
+};
+
+static std::string shardName(const std::string& prefix, unsigned int index) {
+    return prefix + "." + std::to_string(index);
+}
+
+static void setupCodec(CauchyFEC& fec, CauchyFEC::Field field, unsigned int sourceShards) {
+    fec.setField(field);
+    fec.setLargeSymbols(true);
+    fec.reset(true, sourceShards);
+}
+
+static int openFile(const std::string& path, int flags) {
+    int fd = open(path.c_str(), flags, 0644);
+    if(fd < 0) {
+        throw std::runtime_error(path + ": " + strerror(errno));
+    }
+    return fd;
+}
+
+static void closeFile(int fd) {
+    if(close(fd) < 0) {
+        throw std::runtime_error(std::string("close: ") + strerror(errno));
+    }
+}
+
+static std::vector<int> createShards(const std::string& prefix, ShardHeader header) {
+    std::vector<int> shards(header.sourceShards + header.parityShards);
+
+    for(unsigned int i = 0; i < shards.size(); i++) {
+        shards[i] = openFile(shardName(prefix, i), O_WRONLY | O_CREAT | O_TRUNC);
+
+        uint8_t headerBytes[HEADER_SIZE];
+        header.index = i;
+        writeHeader(headerBytes, header);
+        writeAll(shards[i], headerBytes, HEADER_SIZE);
+    }
+
+    return shards;
+}
+
+static size_t stripeCount(const ShardHeader& header) {
+    size_t stripeSize = header.sourceShards * header.symbolSize;
+    return (header.fileSize + stripeSize - 1) / stripeSize;
+}
+
+/* The source area of a slot holds the stripe as it is in the file, the parity follows */
+static void encodeFileAsync(AsyncIO& io, std::vector<AsyncIO::Buffer>& slots, int input, const std::vector<int>& shards,
+                            CauchyFEC& fec, const ShardHeader& header) {
+    unsigned int sourceShards = header.sourceShards;
+    unsigned int parityShards = header.parityShards;
+    size_t symbolSize = header.symbolSize;
+    size_t stripeSize = sourceShards * symbolSize;
+    size_t parityLength = fec.parityLength(symbolSize);
+    size_t stripes = stripeCount(header);
+
+    std::vector<const uint8_t*> sources(sourceShards);
+    std::vector<uint8_t*> parity(parityShards);
+    std::vector<size_t> lengths(sourceShards, symbolSize);
+    std::vector<unsigned int> parityRows(parityShards);
+    for(unsigned int j = 0; j < parityShards; j++) {
+        parityRows[j] = sourceShards + j;
+    }
+
+    /*
+     * Three slots rotate: stripe n + 1 is read and stripe n - 1 is written while stripe n is
+     * encoded, so the disks stay busy during the GF work.
+     */
+    for(size_t stripe = 0; stripe <= stripes; stripe++) {
+        if(stripe < stripes) {
+            unsigned int slot = stripe % slots.size();
+            io.wait(slot);
+
+            size_t offset = stripe * stripeSize;
+            size_t length = std::min<uint64_t>(stripeSize, header.fileSize - offset);
+            if(length < stripeSize) {
+                memset(slots[slot].data + length, 0, stripeSize - length);
+            }
+            io.read(slot, input, slots[slot].data, length, offset);
+            io.submit();
+        }
+
+        if(stripe > 0) {
+            size_t current = stripe - 1;
+            unsigned int slot = current % slots.size();
+            io.wait(slot);
+
+            uint8_t* data = slots[slot].data;
+            for(unsigned int i = 0; i < sourceShards; i++) {
+                sources[i] = data + i * symbolSize;
+            }
+            for(unsigned int j = 0; j < parityShards; j++) {
+                parity[j] = data + stripeSize + j * parityLength;
+            }
+
+            fec.encodeBlock(sourceShards, sources.data(), lengths.data(), parityShards, parityRows.data(), parity.data(), parityLength);
+
+            for(unsigned int i = 0; i < sourceShards; i++) {
+                io.write(slot, shards[i], sources[i], symbolSize, HEADER_SIZE + current * symbolSize);
+            }
+            for(unsigned int j = 0; j < parityShards; j++) {
+                io.write(slot, shards[sourceShards + j], parity[j], parityLength, HEADER_SIZE + current * parityLength);
+            }
+            io.submit();
+        }
+    }
+
+    io.waitAll();
+}
+
+static void encodeFileMapped(MappedFile& file, const std::vector<int>& shards, CauchyFEC& fec, const ShardHeader& header) {
+    unsigned int sourceShards = header.sourceShards;
+    unsigned int parityShards = header.parityShards;
+    size_t symbolSize = header.symbolSize;
+    size_t stripeSize = sourceShards * symbolSize;
+    size_t stripes = stripeCount(header);
+    size_t parityLength = fec.parityLength(symbolSize);
+
+    BufferPool parity(parityShards, parityLength);
+    BufferPool tail(1, stripeSize);
+    std::vector<const uint8_t*> sources(sourceShards);
+    std::vector<size_t> lengths(sourceShards, symbolSize);
+    std::vector<unsigned int> parityRows(parityShards);
+    for(unsigned int j = 0; j < parityShards; j++) {
+        parityRows[j] = sourceShards + j;
+    }
+
+    for(size_t stripe = 0; stripe < stripes; stripe++) {
+        size_t offset = stripe * stripeSize;
+        const uint8_t* stripeData = file.data() + offset;
+
+        file.prefetch(offset + stripeSize, stripeSize);
+
+        /* Only the last stripe is copied, to pad it with zeros */
+        if(offset + stripeSize > file.size()) {
+            memset(tail[0], 0, stripeSize);
+            memcpy(tail[0], stripeData, file.size() - offset);
+            stripeData = tail[0];
+        }
+
+        for(unsigned int i = 0; i < sourceShards; i++) {
+            sources[i] = stripeData + i * symbolSize;
+        }
+
+        fec.encodeBlock(sourceShards, sources.data(), lengths.data(), parityShards, parityRows.data(), parity.data(), parityLength);
+
+        for(unsigned int i = 0; i < sourceShards; i++) {
+            writeAll(shards[i], sources[i], symbolSize);
+        }
+        for(unsigned int j = 0; j < parityShards; j++) {
+            writeAll(shards[sourceShards + j], parity[j], parityLength);
+        }
+
+        file.release(offset, stripeSize);
+    }
+}
+
+static void encodeFile(const std::string& input, const std::string& prefix, unsigned int sourceShards,
+                       unsigned int parityShards, size_t symbolSize, bool useMmap) {
+    if(!sourceShards || sourceShards + parityShards > 65536) {
+        throw std::runtime_error("Invalid number of shards");
+    }
+
+    ShardHeader header;
+    header.field = (sourceShards + parityShards > 256)? CauchyFEC::FIELD_GF65536 : CauchyFEC::FIELD_GF256;
+    header.sourceShards = sourceShards;
+    header.parityShards = parityShards;
+    header.symbolSize = symbolSize;
+
+    CauchyFEC fec;
+    setupCodec(fec, header.field, sourceShards);
+
+    if(!useMmap) {
+        int fd = openFile(input, O_RDONLY);
+
+        struct stat st;
+        if(fstat(fd, &st) < 0) {
+            throw std::runtime_error(input + ": " + strerror(errno));
+        }
+        header.fileSize = st.st_size;
+
+        BufferPool pool(ASYNC_SLOTS, sourceShards * symbolSize + parityShards * fec.parityLength(symbolSize));
+        std::vector<AsyncIO::Buffer> slots;
+        for(unsigned int i = 0; i < ASYNC_SLOTS; i++) {
+            slots.push_back(AsyncIO::Buffer{pool[i], sourceShards * symbolSize + parityShards * fec.parityLength(symbolSize)});
+        }
+
+        AsyncIO io(ASYNC_QUEUE_DEPTH, slots);
+        if(io.valid()) {
+            std::vector<int> shards = createShards(prefix, header);
+            encodeFileAsync(io, slots, fd, shards, fec, header);
+            for(auto shard: shards) {
+                closeFile(shard);
+            }
+            closeFile(fd);
+            return;
+        }
+
+        closeFile(fd);
+    }
+
+    MappedFile file(input);
+    header.fileSize = file.size();
+
+    std::vector<int> shards = createShards(prefix, header);
+    encodeFileMapped(file, shards, fec, header);
+    for(auto shard: shards) {
+        closeFile(shard);
+    }
+}
+
+/* Finds the shards of a set, any shard describes the whole set. Truncated shards count as lost. */
+static std::vector<std::unique_ptr<MappedFile>> findShards(const std::string& prefix, ShardHeader& header) {
+    std::vector<std::unique_ptr<MappedFile>> shards;
+    bool found = false;
+    header = ShardHeader();
+
+    for(unsigned int i = 0; i < 65536 && (!found || i < header.sourceShards + header.parityShards); i++) {
+        std::unique_ptr<MappedFile> shard(new MappedFile(shardName(prefix, i), false));
+        ShardHeader shardHeader;
+
+        if(shard->valid() && shard->size() >= HEADER_SIZE && readHeader(shard->data(), shardHeader) && shardHeader.index == i) {
+            if(!found) {
+                header = shardHeader;
+                found = true;
+                shards.resize(header.sourceShards + header.parityShards);
+            }
+
+            if(shardHeader.sourceShards == header.sourceShards && shardHeader.parityShards == header.parityShards &&
+               shardHeader.symbolSize == header.symbolSize && shardHeader.fileSize == header.fileSize &&
+               shardHeader.field == header.field) {
+                shards[i] = std::move(shard);
+            }
+        }
+    }
+
+    if(!found) {
+        throw std::runtime_error("No shards found");
+    }
+
+    CauchyFEC fec;
+    setupCodec(fec, header.field, header.sourceShards);
+
+    size_t stripes = stripeCount(header);
+    size_t parityLength = fec.parityLength(header.symbolSize);
+
+    unsigned int available = 0;
+    for(unsigned int i = 0; i < shards.size(); i++) {
+        size_t length = (i < header.sourceShards)? header.symbolSize : parityLength;
+        if(shards[i] && shards[i]->size() != HEADER_SIZE + stripes * length) {
+            shards[i].reset();
+        }
+        available += !!shards[i];
+    }
+
+    if(available < header.sourceShards) {
+        throw std::runtime_error("Not enough shards to rebuild the file");
+    }
+
+    return shards;
+}
+
+/* Every symbol of a slot has room for a recovered packet, the parity that is used follows */
+static void decodeFileAsync(AsyncIO& io, std::vector<AsyncIO::Buffer>& slots, const std::vector<int>& shards, int output,
+                            CauchyFEC& fec, const ShardHeader& header) {
+    unsigned int sourceShards = header.sourceShards;
+    size_t symbolSize = header.symbolSize;
+    size_t parityLength = fec.parityLength(symbolSize);
+    size_t stripes = stripeCount(header);
+
+    std::vector<const uint8_t*> sources(sourceShards);
+    std::vector<uint8_t*> recovered(sourceShards);
+    std::vector<size_t> lengths(sourceShards, symbolSize);
+    std::vector<const uint8_t*> parity;
+    std::vector<unsigned int> parityRows;
+
+    unsigned int missing = 0;
+    for(unsigned int i = 0; i < sourceShards; i++) {
+        missing += shards[i] < 0;
+    }
+    for(unsigned int i = sourceShards; i < shards.size() && parityRows.size() < missing; i++) {
+        if(shards[i] >= 0) {
+            parityRows.push_back(i);
+        }
+    }
+    parity.resize(parityRows.size());
+
+    for(size_t stripe = 0; stripe <= stripes; stripe++) {
+        if(stripe < stripes) {
+            unsigned int slot = stripe % slots.size();
+            io.wait(slot);
+
+            uint8_t* data = slots[slot].data;
+            for(unsigned int i = 0; i < sourceShards; i++) {
+                if(shards[i] >= 0) {
+                    io.read(slot, shards[i], data + i * parityLength, symbolSize, HEADER_SIZE + stripe * symbolSize);
+                }
+            }
+            for(unsigned int j = 0; j < parityRows.size(); j++) {
+                io.read(slot, shards[parityRows[j]], data + (sourceShards + j) * parityLength, parityLength,
+                        HEADER_SIZE + stripe * parityLength);
+            }
+            io.submit();
+        }
+
+        if(stripe > 0) {
+            size_t current = stripe - 1;
+            unsigned int slot = current % slots.size();
+            io.wait(slot);
+
+            uint8_t* data = slots[slot].data;
+            for(unsigned int i = 0; i < sourceShards; i++) {
+                recovered[i] = data + i * parityLength;
+                sources[i] = (shards[i] >= 0)? recovered[i] : nullptr;
+            }
+            for(unsigned int j = 0; j < parityRows.size(); j++) {
+                parity[j] = data + (sourceShards + j) * parityLength;
+            }
+
+            if(missing && !fec.decodeBlock(sourceShards, sources.data(), lengths.data(), parity.size(), parityRows.data(),
+                                           parity.data(), parityLength, recovered.data())) {
+                throw std::runtime_error("Shards are inconsistent");
+            }
+
+            uint64_t offset = current * sourceShards * symbolSize;
+            for(unsigned int i = 0; i < sourceShards && offset < header.fileSize; i++) {
+                size_t length = std::min<uint64_t>(header.fileSize - offset, symbolSize);
+                io.write(slot, output, recovered[i], length, offset);
+                offset += length;
+            }
+            io.submit();
+        }
+    }
+
+    io.waitAll();
+}
+
+static void decodeFileMapped(std::vector<std::unique_ptr<MappedFile>>& shards, int fd, CauchyFEC& fec, const ShardHeader& header) {
+    size_t symbolSize = header.symbolSize;
+    size_t stripes = stripeCount(header);
+    size_t parityLength = fec.parityLength(symbolSize);
+
+    std::vector<const uint8_t*> sources(header.sourceShards);
+    std::vector<size_t> lengths(header.sourceShards);
+    std::vector<const uint8_t*> parity;
+    std::vector<unsigned int> parityRows;
+    BufferPool recoveredSymbols(std::min(header.sourceShards, header.parityShards), parityLength);
+    std::vector<uint8_t*> recoveredBuffers(header.sourceShards, nullptr);
+
+    unsigned int missing = 0;
+    for(unsigned int i = 0; i < header.sourceShards; i++) {
+        if(!shards[i]) {
+            recoveredBuffers[i] = recoveredSymbols[missing++];
+        }
+    }
+
+    uint64_t remaining = header.fileSize;
+
+    for(size_t stripe = 0; stripe < stripes; stripe++) {
+        parity.clear();
+        parityRows.clear();
+
+        for(unsigned int i = 0; i < shards.size(); i++) {
+            if(!shards[i]) {
+                if(i < header.sourceShards) {
+                    sources[i] = nullptr;
+                }
+                continue;
+            }
+
+            size_t length = (i < header.sourceShards)? symbolSize : parityLength;
+            size_t offset = HEADER_SIZE + stripe * length;
+            shards[i]->prefetch(offset + length, length);
+
+            if(i < header.sourceShards) {
+                sources[i] = shards[i]->data() + offset;
+                lengths[i] = symbolSize;
+            } else if(parity.size() < missing) {
+                parity.push_back(shards[i]->data() + offset);
+                parityRows.push_back(i);
+            }
+        }
+
+        if(missing && !fec.decodeBlock(header.sourceShards, sources.data(), lengths.data(), parity.size(), parityRows.data(),
+                                       parity.data(), parityLength, recoveredBuffers.data())) {
+            throw std::runtime_error("Shards are inconsistent");
+        }
+
+        for(unsigned int i = 0; i < header.sourceShards && remaining; i++) {
+            size_t length = std::min<uint64_t>(remaining, symbolSize);
+            writeAll(fd, sources[i]? sources[i] : recoveredBuffers[i], length);
+            remaining -= length;
+        }
+
+        for(unsigned int i = 0; i < shards.size(); i++) {
+            if(shards[i]) {
+                size_t length = (i < header.sourceShards)? symbolSize : parityLength;
+                shards[i]->release(HEADER_SIZE + stripe * length, length);
+            }
+        }
+    }
+}
+
+static void decodeFile(const std::string& prefix, const std::string& output, bool useMmap) {
+    ShardHeader header;
+    std::vector<std::unique_ptr<MappedFile>> shards = findShards(prefix, header);
+
+    CauchyFEC fec;
+    setupCodec(fec, header.field, header.sourceShards);
+
+    int fd = openFile(output, O_WRONLY | O_CREAT | O_TRUNC);
+
+    if(!useMmap) {
+        size_t slotSize = shards.size() * fec.parityLength(header.symbolSize);
+        BufferPool pool(ASYNC_SLOTS, slotSize);
+        std::vector<AsyncIO::Buffer> slots;
+        for(unsigned int i = 0; i < ASYNC_SLOTS; i++) {
+            slots.push_back(AsyncIO::Buffer{pool[i], slotSize});
+        }
+
+        AsyncIO io(ASYNC_QUEUE_DEPTH, slots);
+        if(io.valid()) {
+            std::vector<int> shardFds(shards.size(), -1);
+            for(unsigned int i = 0; i < shards.size(); i++) {
+                if(shards[i]) {
+                    shardFds[i] = openFile(shardName(prefix, i), O_RDONLY);
+                }
+            }
+            shards.clear();
+
+            decodeFileAsync(io, slots, shardFds, fd, fec, header);
+
+            for(auto shard: shardFds) {
+                if(shard >= 0) {
+                    closeFile(shard);
+                }
+            }
+            closeFile(fd);
+            return;
+        }
+    }
+
+    decodeFileMapped(shards, fd, fec, header);
+    closeFile(fd);
+}
+
+static void usage(const char* name) {
+    std::cerr<<"Usage: "<<name<<" [--mmap] encode <input> <shard prefix> <source shards> <parity shards> [symbol size]\n";
+    std::cerr<<"       "<<name<<" [--mmap] decode <shard prefix> <output>\n";
+    std::cerr<<"I/O runs through io_uring when the kernel allows it, --mmap forces memory mapped files\n";
+}
+
+int main(int argc, char** argv) {
+    CauchyFEC::init();
+
+    try {
+        bool useMmap = argc > 1 && std::string(argv[1]) == "--mmap";
+        if(useMmap) {
+            argc--;
+            argv++;
+        }
+
+        std::string mode = (argc > 1)? argv[1] : "";
+
+        if(mode == "encode" && (argc == 6 || argc == 7)) {
+            size_t symbolSize = (argc == 7)? std::stoul(argv[6]) : HUGE_PAGE_SIZE;
+            if(!symbolSize || symbolSize > 0xFFFFFFFF) {
+                throw std::runtime_error("Invalid symbol size");
+            }
+            encodeFile(argv[2], argv[3], std::stoul(argv[4]), std::stoul(argv[5]), symbolSize, useMmap);
+        } else if(mode == "decode" && argc == 4) {
+            decodeFile(argv[2], argv[3], useMmap);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    } catch(const std::exception& e) {
+        std::cerr<<e.what()<<"\n";
+        return 1;
+    }
+
+    return 0;
+}
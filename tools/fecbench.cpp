@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Throughput benchmark for CauchyFEC. Sweeps the number of source packets, parity packets,
+ * packet size, length skew and number of lost packets over four paths:
+ *
+ *  encode       source packets in, all packets out
+ *  passthrough  decoder with every source packet received (systematic part only)
+ *  decode       decoder with 'loss' source packets replaced by parity
+ *  invert       decoder with losses, only the parity selection and inverse (packetLength()),
+ *               the packets are loaded into a batch of decoders outside the timed region
+ *
+ * Every case runs for at least --time seconds on one pinned core. Results are printed as
+ * CSV or JSON lines, with cycles per byte when perf_event is available.
+ */
+
+#include "CauchyFEC.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+using Clock = std::chrono::steady_clock;
+
+void makeRandomVector(std::vector<uint8_t>& output, unsigned int length) {
+    output.resize(length);
+    for(unsigned int i=0; i<length; i++) {
+        output[i]=rand();
+    }
+}
+
+/* Cycle counter of this thread, if the kernel lets us */
+class CycleCounter {
+public:
+    CycleCounter() {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~CycleCounter() {
+        if(fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    bool valid() const {
+        return fd_ >= 0;
+    }
+
+    void start() {
+        if(fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    uint64_t stop() {
+        uint64_t cycles = 0;
+        if(fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if(read(fd_, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+                cycles = 0;
+            }
+        }
+        return cycles;
+    }
+
+private:
+    int fd_;
+};
+
+struct Case {
+    unsigned int sourcePackets;
+    unsigned int parityPackets;
+    unsigned int packetSize;
+    double skew;
+    unsigned int loss;
+};
+
+struct Result {
+    std::string path;
+    uint64_t blocks;
+    uint64_t bytes;
+    double seconds;
+    uint64_t cycles;
+};
+
+class Benchmark {
+public:
+    Benchmark(const Case& c):
+        case_(c) {
+        /* Lengths are uniform in [size * (1 - skew), size] */
+        sources_.resize(c.sourcePackets);
+        bytes_ = 0;
+        for(auto& source: sources_) {
+            unsigned int shortest = std::max(1.0, c.packetSize * (1 - c.skew));
+            makeRandomVector(source, shortest + rand() % (c.packetSize - shortest + 1));
+            bytes_ += source.size();
+        }
+
+        CauchyFEC fec;
+        fec.reset(true, c.sourcePackets);
+        fec << sources_;
+        fec.requestPackets(encoded_, c.sourcePackets + c.parityPackets);
+
+        /* The first 'loss' source packets are lost, the first parity packets replace them */
+        for(unsigned int i = 0; i < c.sourcePackets; i++) {
+            all_.push_back(&encoded_[i]);
+            if(i >= c.loss) {
+                lossy_.push_back(&encoded_[i]);
+            }
+        }
+        for(unsigned int i = 0; i < c.loss; i++) {
+            lossy_.push_back(&encoded_[c.sourcePackets + i]);
+        }
+    }
+
+    Result run(const std::string& path, double minSeconds, CycleCounter& counter) {
+        Result result = {path, 0, 0, 0, 0};
+        std::vector<CauchyFEC> batch((path == "invert")? ROUND_BLOCKS : 1);
+
+        /* One untimed round to warm up caches and allocations */
+        prepare(path, batch[0]);
+        runOnce(path, batch[0]);
+
+        do {
+            for(auto& fec: batch) {
+                prepare(path, fec);
+            }
+
+            Clock::time_point start = Clock::now();
+            counter.start();
+            for(unsigned int i = 0; i < ROUND_BLOCKS; i++) {
+                runOnce(path, batch[i % batch.size()]);
+                result.blocks++;
+            }
+            result.cycles += counter.stop();
+            result.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        } while(result.seconds < minSeconds);
+        result.bytes = result.blocks * bytes_;
+
+        return result;
+    }
+
+private:
+    static const unsigned int ROUND_BLOCKS = 8;
+
+    /* Untimed: the invert path starts from a decoder that holds every received packet */
+    void prepare(const std::string& path, CauchyFEC& fec) {
+        if(path == "invert") {
+            load(fec, lossy_);
+        }
+    }
+
+    void load(CauchyFEC& fec, const std::vector<const std::vector<uint8_t>*>& packets) {
+        fec.reset(false);
+        for(auto packet: packets) {
+            fec << *packet;
+        }
+    }
+
+    void runOnce(const std::string& path, CauchyFEC& fec) {
+        std::vector<std::vector<uint8_t>> output;
+
+        if(path == "encode") {
+            fec.reset(true, case_.sourcePackets);
+            fec << sources_;
+            fec.requestPackets(output, case_.sourcePackets + case_.parityPackets);
+            return;
+        }
+
+        if(path == "invert") {
+            size_t length;
+            if(case_.loss && !fec.packetLength(0, length)) {
+                throw std::runtime_error("Decoding failed");
+            }
+            return;
+        }
+
+        load(fec, (path == "passthrough")? all_ : lossy_);
+
+        if(fec.requestPackets(output, case_.sourcePackets) != case_.sourcePackets) {
+            throw std::runtime_error("Decoding failed");
+        }
+    }
+
+    Case case_;
+    size_t bytes_;
+    std::vector<std::vector<uint8_t>> sources_;
+    std::vector<std::vector<uint8_t>> encoded_;
+    std::vector<const std::vector<uint8_t>*> all_;
+    std::vector<const std::vector<uint8_t>*> lossy_;
+};
+
+static std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream stream(text);
+    std::string item;
+    while(std::getline(stream, item, ',')) {
+        values.push_back(std::stod(item));
+    }
+    return values;
+}
+
+static void printResult(const Case& c, const Result& r, bool json, bool haveCycles) {
+    double megabytesPerSecond = r.bytes / r.seconds / 1e6;
+    double packetsPerSecond = r.blocks * c.sourcePackets / r.seconds;
+    double nsPerBlock = r.seconds * 1e9 / r.blocks;
+    std::string cyclesPerByte = haveCycles? std::to_string((double)r.cycles / r.bytes) : (json? "null" : "");
+
+    if(json) {
+        std::cout<<"{\"path\":\""<<r.path<<"\",\"k\":"<<c.sourcePackets<<",\"m\":"<<c.parityPackets
+                 <<",\"size\":"<<c.packetSize<<",\"skew\":"<<c.skew<<",\"loss\":"<<c.loss
+                 <<",\"blocks\":"<<r.blocks<<",\"mb_per_s\":"<<megabytesPerSecond<<",\"packets_per_s\":"<<packetsPerSecond
+                 <<",\"ns_per_block\":"<<nsPerBlock<<",\"cycles_per_byte\":"<<cyclesPerByte<<"}\n";
+    } else {
+        std::cout<<r.path<<","<<c.sourcePackets<<","<<c.parityPackets<<","<<c.packetSize<<","<<c.skew<<","<<c.loss<<","
+                 <<r.blocks<<","<<megabytesPerSecond<<","<<packetsPerSecond<<","<<nsPerBlock<<","<<cyclesPerByte<<"\n";
+    }
+    std::cout.flush();
+}
+
+static void usage(const char* name) {
+    std::cerr<<"Usage: "<<name<<" [options]\n";
+    std::cerr<<"  --k LIST      source packets (default 4,16,64,200)\n";
+    std::cerr<<"  --m LIST      parity packets (default 2,8,32)\n";
+    std::cerr<<"  --size LIST   longest packet in bytes (default 1400,8192)\n";
+    std::cerr<<"  --skew LIST   length spread, 0 means equal lengths (default 0,0.5)\n";
+    std::cerr<<"  --loss LIST   lost source packets, capped at m (default m)\n";
+    std::cerr<<"  --path LIST   encode,passthrough,decode,invert (default all)\n";
+    std::cerr<<"  --time S      minimum time per case (default 0.2)\n";
+    std::cerr<<"  --cpu N       core to pin to (default 0)\n";
+    std::cerr<<"  --json        JSON lines instead of CSV\n";
+}
+
+int main(int argc, char** argv) {
+    CauchyFEC::init();
+    srand(1);
+
+    std::vector<double> ks = {4, 16, 64, 200};
+    std::vector<double> ms = {2, 8, 32};
+    std::vector<double> sizes = {1400, 8192};
+    std::vector<double> skews = {0, 0.5};
+    std::vector<double> losses;
+    std::vector<std::string> paths = {"encode", "passthrough", "decode", "invert"};
+    double minSeconds = 0.2;
+    int cpu = 0;
+    bool json = false;
+
+    try {
+        for(int i = 1; i < argc; i++) {
+            std::string option = argv[i];
+            if(option == "--json") {
+                json = true;
+                continue;
+            }
+
+            if(i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+
+            if(option == "--k") {
+                ks = parseList(value);
+            } else if(option == "--m") {
+                ms = parseList(value);
+            } else if(option == "--size") {
+                sizes = parseList(value);
+            } else if(option == "--skew") {
+                skews = parseList(value);
+            } else if(option == "--loss") {
+                losses = parseList(value);
+            } else if(option == "--path") {
+                paths.clear();
+                std::stringstream stream(value);
+                std::string item;
+                while(std::getline(stream, item, ',')) {
+                    paths.push_back(item);
+                }
+            } else if(option == "--time") {
+                minSeconds = std::stod(value);
+            } else if(option == "--cpu") {
+                cpu = std::stoi(value);
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        if(sched_setaffinity(0, sizeof(cpuSet), &cpuSet) < 0) {
+            std::cerr<<"Could not pin to core "<<cpu<<"\n";
+        }
+
+        CycleCounter counter;
+        if(!json) {
+            std::cout<<"path,k,m,size,skew,loss,blocks,mb_per_s,packets_per_s,ns_per_block,cycles_per_byte\n";
+        }
+
+        for(double k: ks) {
+            for(double m: ms) {
+                if(k < 1 || k + m > 256) {
+                    continue;
+                }
+
+                std::vector<double> caseLosses = losses.empty()? std::vector<double>{m} : losses;
+                for(double size: sizes) {
+                    for(double skew: skews) {
+                        for(double loss: caseLosses) {
+                            Case c = {(unsigned int)k, (unsigned int)m, (unsigned int)size, skew,
+                                      (unsigned int)std::min(std::min(loss, m), k)};
+                            Benchmark benchmark(c);
+
+                            for(auto& path: paths) {
+                                printResult(c, benchmark.run(path, minSeconds, counter), json, counter.valid());
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    } catch(const std::exception& e) {
+        std::cerr<<e.what()<<"\n";
+        return 1;
+    }
+
+    return 0;
+}
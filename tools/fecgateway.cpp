@@ -0,0 +1,716 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * UDP FEC gateway. The encoder side receives a plain UDP stream, forwards every datagram at
+ * once with a CauchyFEC trailer and adds parity after every k datagrams (or after a timeout
+ * for a partial block). The decoder side forwards source datagrams as they arrive without
+ * the trailer, and uses the parity to recover the ones that were lost.
+ *
+ * Tunnel datagrams carry a 4 byte header: the 16 bit flow id and the 16 bit block number,
+ * followed by the CauchyFEC packet (GF(2^8), trailer [index][k-1]).
+ *
+ * Every worker thread owns a socket bound with SO_REUSEPORT, so the kernel spreads the flows
+ * over the workers and every worker owns its codec instances without locking. Datagrams are
+ * received with recvmmsg and sent with sendmmsg. The parity packets of a block have the same
+ * length, so they go out as one UDP GSO send when the kernel supports it.
+ */
+
+#include "CauchyFEC.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <deque>
+#include <memory>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t HEADER_SIZE = 4;
+static const size_t TRAILER_SIZE = 2;
+static const size_t MAX_DATAGRAM = 65536;
+static const unsigned int BATCH_SIZE = 64;
+static const unsigned int MAX_GSO_SEGMENTS = 64;
+static const size_t MAX_GSO_BYTES = 65000;
+static const auto FLOW_IDLE_TIMEOUT = std::chrono::seconds(30);
+
+static std::atomic<bool> running(true);
+
+struct Options {
+    bool encode;
+    sockaddr_in listen;
+    sockaddr_in forward;
+    unsigned int sourcePackets;
+    unsigned int parityPackets;
+    unsigned int threads;
+    double loss;
+    unsigned int flushMs;
+};
+
+struct Stats {
+    uint64_t received;
+    uint64_t sent;
+    uint64_t dropped;
+    uint64_t recovered;
+};
+
+static sockaddr_in parseAddress(const std::string& text) {
+    size_t colon = text.rfind(':');
+    if(colon == std::string::npos) {
+        throw std::runtime_error("Address must be host:port: " + text);
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(std::stoul(text.substr(colon + 1)));
+
+    if(inet_pton(AF_INET, text.substr(0, colon).c_str(), &address.sin_addr) != 1) {
+        throw std::runtime_error("Invalid IPv4 address: " + text);
+    }
+
+    return address;
+}
+
+/*
+ * Outgoing datagrams of one batch, sent with a single sendmmsg. Payloads are moved in and
+ * sent with the header as a separate iovec, so nothing is copied.
+ */
+class SendBatch {
+public:
+    SendBatch(int fd, const sockaddr_in& destination, double loss, unsigned int seed, bool gso, Stats& stats):
+        fd_(fd), destination_(destination), loss_(loss), random_(seed), gso_(gso), stats_(stats) {
+    }
+
+    void add(uint16_t flow, uint16_t block, std::vector<uint8_t>&& payload) {
+        if(dropped()) {
+            return;
+        }
+
+        Message message;
+        message.firstIov = iovecs_.size();
+        message.iovCount = 0;
+        message.segmentSize = 0;
+        message.segments = 1;
+        addSegment(message, flow, block, std::move(payload));
+        messages_.push_back(message);
+
+        if(messages_.size() >= BATCH_SIZE) {
+            flush();
+        }
+    }
+
+    /* Payload without the tunnel header, as forwarded by the decoder */
+    void addPlain(std::vector<uint8_t>&& payload) {
+        if(dropped()) {
+            return;
+        }
+
+        payloads_.push_back(std::move(payload));
+
+        Message message;
+        message.firstIov = iovecs_.size();
+        message.iovCount = 1;
+        message.segmentSize = 0;
+        message.segments = 1;
+        iovecs_.push_back(iovec{payloads_.back().data(), payloads_.back().size()});
+        messages_.push_back(message);
+
+        if(messages_.size() >= BATCH_SIZE) {
+            flush();
+        }
+    }
+
+    /* Packets of the same length, sent as GSO segments of one send when possible */
+    void addSegmented(uint16_t flow, uint16_t block, std::vector<std::vector<uint8_t>>&& payloads) {
+        if(!gso_ || loss_ > 0) {
+            for(auto& payload: payloads) {
+                add(flow, block, std::move(payload));
+            }
+            return;
+        }
+
+        size_t segmentSize = HEADER_SIZE + payloads[0].size();
+        unsigned int perSend = std::min<size_t>(MAX_GSO_SEGMENTS, MAX_GSO_BYTES / segmentSize);
+
+        for(size_t first = 0; first < payloads.size(); first += std::max(1u, perSend)) {
+            Message message;
+            message.firstIov = iovecs_.size();
+            message.iovCount = 0;
+            message.segmentSize = (perSend > 1)? segmentSize : 0;
+            message.segments = 0;
+
+            for(size_t i = first; i < std::min(payloads.size(), first + std::max(1u, perSend)); i++) {
+                addSegment(message, flow, block, std::move(payloads[i]));
+                message.segments++;
+            }
+            messages_.push_back(message);
+        }
+
+        if(messages_.size() >= BATCH_SIZE) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if(messages_.empty()) {
+            return;
+        }
+
+        std::vector<mmsghdr> headers(messages_.size());
+        std::vector<uint8_t> control(messages_.size() * CMSG_SPACE(sizeof(uint16_t)), 0);
+
+        for(unsigned int i = 0; i < messages_.size(); i++) {
+            Message& message = messages_[i];
+            msghdr& header = headers[i].msg_hdr;
+            memset(&headers[i], 0, sizeof(headers[i]));
+
+            header.msg_name = &destination_;
+            header.msg_namelen = sizeof(destination_);
+            header.msg_iov = &iovecs_[message.firstIov];
+            header.msg_iovlen = message.iovCount;
+
+            if(message.segmentSize) {
+                header.msg_control = &control[i * CMSG_SPACE(sizeof(uint16_t))];
+                header.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+                cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segmentSize = message.segmentSize;
+                memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+            }
+        }
+
+        /* A full socket buffer drops the rest of the batch, like the network would */
+        unsigned int sent = 0;
+        while(sent < headers.size()) {
+            int ret = sendmmsg(fd_, &headers[sent], headers.size() - sent, 0);
+            if(ret < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            sent += ret;
+        }
+
+        for(unsigned int i = 0; i < messages_.size(); i++) {
+            if(i < sent) {
+                stats_.sent += messages_[i].segments;
+            } else {
+                stats_.dropped += messages_[i].segments;
+            }
+        }
+
+        messages_.clear();
+        iovecs_.clear();
+        tunnelHeaders_.clear();
+        payloads_.clear();
+    }
+
+private:
+    struct Message {
+        size_t firstIov;
+        size_t iovCount;
+        size_t segmentSize;
+        unsigned int segments;
+    };
+
+    bool dropped() {
+        if(loss_ > 0 && std::uniform_real_distribution<double>(0, 1)(random_) < loss_) {
+            stats_.dropped++;
+            return true;
+        }
+        return false;
+    }
+
+    void addSegment(Message& message, uint16_t flow, uint16_t block, std::vector<uint8_t>&& payload) {
+        tunnelHeaders_.push_back({(uint8_t)(flow >> 8), (uint8_t)flow, (uint8_t)(block >> 8), (uint8_t)block});
+        payloads_.push_back(std::move(payload));
+
+        iovecs_.push_back(iovec{tunnelHeaders_.back().data(), HEADER_SIZE});
+        iovecs_.push_back(iovec{payloads_.back().data(), payloads_.back().size()});
+        message.iovCount += 2;
+    }
+
+    int fd_;
+    sockaddr_in destination_;
+    double loss_;
+    std::minstd_rand random_;
+    bool gso_;
+    Stats& stats_;
+
+    std::vector<Message> messages_;
+    std::vector<iovec> iovecs_;
+    std::deque<std::array<uint8_t, HEADER_SIZE>> tunnelHeaders_;
+    std::deque<std::vector<uint8_t>> payloads_;
+};
+
+/* Batched receive into fixed buffers */
+class ReceiveBatch {
+public:
+    ReceiveBatch():
+        buffers_(BATCH_SIZE * MAX_DATAGRAM), iovecs_(BATCH_SIZE), addresses_(BATCH_SIZE), headers_(BATCH_SIZE) {
+    }
+
+    int receive(int fd) {
+        for(unsigned int i = 0; i < BATCH_SIZE; i++) {
+            iovecs_[i].iov_base = &buffers_[i * MAX_DATAGRAM];
+            iovecs_[i].iov_len = MAX_DATAGRAM;
+
+            memset(&headers_[i], 0, sizeof(headers_[i]));
+            headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+            headers_[i].msg_hdr.msg_iovlen = 1;
+            headers_[i].msg_hdr.msg_name = &addresses_[i];
+            headers_[i].msg_hdr.msg_namelen = sizeof(addresses_[i]);
+        }
+
+        int ret = recvmmsg(fd, headers_.data(), BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if(ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            throw std::runtime_error(std::string("recvmmsg: ") + strerror(errno));
+        }
+
+        return std::max(ret, 0);
+    }
+
+    const uint8_t* data(unsigned int i) const {
+        return &buffers_[i * MAX_DATAGRAM];
+    }
+
+    size_t length(unsigned int i) const {
+        return headers_[i].msg_len;
+    }
+
+    const sockaddr_in& address(unsigned int i) const {
+        return addresses_[i];
+    }
+
+private:
+    std::vector<uint8_t> buffers_;
+    std::vector<iovec> iovecs_;
+    std::vector<sockaddr_in> addresses_;
+    std::vector<mmsghdr> headers_;
+};
+
+static uint64_t addressKey(const sockaddr_in& address) {
+    return ((uint64_t)ntohl(address.sin_addr.s_addr) << 16) | ntohs(address.sin_port);
+}
+
+static int openSocket(const sockaddr_in* bindAddress) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0) {
+        throw std::runtime_error(std::string("socket: ") + strerror(errno));
+    }
+
+    int size = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    if(bindAddress) {
+        int one = 1;
+        if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0 ||
+           bind(fd, (const sockaddr*)bindAddress, sizeof(*bindAddress)) < 0) {
+            close(fd);
+            throw std::runtime_error(std::string("bind: ") + strerror(errno));
+        }
+    }
+
+    return fd;
+}
+
+static bool gsoSupported(int fd) {
+    int segmentSize = 0;
+    socklen_t length = sizeof(segmentSize);
+    return getsockopt(fd, SOL_UDP, UDP_SEGMENT, &segmentSize, &length) == 0;
+}
+
+class EncoderWorker {
+public:
+    EncoderWorker(const Options& options, unsigned int index, Stats& stats):
+        options_(options), index_(index), stats_(stats), nextFlowId_(index << 12) {
+    }
+
+    void run() {
+        int listenFd = openSocket(&options_.listen);
+
+        /* An unbound socket per worker: its own source port spreads the decoder side over workers */
+        int sendFd = openSocket(nullptr);
+        SendBatch batch(sendFd, options_.forward, options_.loss, index_ + 1, gsoSupported(sendFd), stats_);
+        ReceiveBatch received;
+
+        while(running) {
+            pollfd pfd = {listenFd, POLLIN, 0};
+            poll(&pfd, 1, std::min(100u, std::max(1u, options_.flushMs)));
+
+            int count = received.receive(listenFd);
+            for(int i = 0; i < count; i++) {
+                if(!received.length(i) || received.length(i) > 0xFFFF) {
+                    continue;
+                }
+
+                stats_.received++;
+                Flow& flow = getFlow(received.address(i));
+                flow.lastPacket = Clock::now();
+                if(!flow.loaded) {
+                    flow.blockStart = flow.lastPacket;
+                }
+
+                flow.fec << std::vector<uint8_t>(received.data(i), received.data(i) + received.length(i));
+                flow.loaded++;
+
+                std::vector<std::vector<uint8_t>> packets;
+                flow.fec.requestPackets(packets, 1);
+                batch.add(flow.id, flow.block, std::move(packets[0]));
+
+                if(flow.loaded == options_.sourcePackets) {
+                    finishBlock(flow, batch);
+                }
+            }
+
+            expireFlows(batch);
+            batch.flush();
+        }
+
+        batch.flush();
+        close(listenFd);
+        close(sendFd);
+    }
+
+private:
+    struct Flow {
+        CauchyFEC fec;
+        uint16_t id;
+        uint16_t block;
+        unsigned int loaded;
+        Clock::time_point blockStart;
+        Clock::time_point lastPacket;
+    };
+
+    Flow& getFlow(const sockaddr_in& address) {
+        auto found = flows_.find(addressKey(address));
+        if(found != flows_.end()) {
+            return *found->second;
+        }
+
+        std::unique_ptr<Flow> flow(new Flow());
+        flow->id = nextFlowId_++;
+        flow->block = 0;
+        flow->loaded = 0;
+        flow->fec.reset(true, options_.sourcePackets);
+
+        return *(flows_[addressKey(address)] = std::move(flow));
+    }
+
+    void finishBlock(Flow& flow, SendBatch& batch) {
+        if(flow.loaded < options_.sourcePackets) {
+            flow.fec.flush();
+        }
+
+        if(options_.parityPackets) {
+            std::vector<std::vector<uint8_t>> parity;
+            flow.fec.requestPackets(parity, options_.parityPackets);
+            batch.addSegmented(flow.id, flow.block, std::move(parity));
+        }
+
+        flow.block++;
+        flow.loaded = 0;
+        flow.fec.reset(true, options_.sourcePackets);
+    }
+
+    void expireFlows(SendBatch& batch) {
+        Clock::time_point now = Clock::now();
+
+        for(auto it = flows_.begin(); it != flows_.end();) {
+            Flow& flow = *it->second;
+
+            if(flow.loaded && now - flow.blockStart >= std::chrono::milliseconds(options_.flushMs)) {
+                finishBlock(flow, batch);
+            }
+
+            if(!flow.loaded && now - flow.lastPacket >= FLOW_IDLE_TIMEOUT) {
+                it = flows_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    const Options& options_;
+    unsigned int index_;
+    Stats& stats_;
+    uint16_t nextFlowId_;
+    std::map<uint64_t, std::unique_ptr<Flow>> flows_;
+};
+
+class DecoderWorker {
+public:
+    DecoderWorker(const Options& options, unsigned int index, Stats& stats):
+        options_(options), index_(index), stats_(stats) {
+    }
+
+    void run() {
+        int listenFd = openSocket(&options_.listen);
+        SendBatch batch(listenFd, options_.forward, options_.loss, index_ + 1, false, stats_);
+        ReceiveBatch received;
+
+        while(running) {
+            pollfd pfd = {listenFd, POLLIN, 0};
+            poll(&pfd, 1, 100);
+
+            int count = received.receive(listenFd);
+            for(int i = 0; i < count; i++) {
+                size_t length = received.length(i);
+                if(length <= HEADER_SIZE + TRAILER_SIZE) {
+                    continue;
+                }
+
+                stats_.received++;
+                const uint8_t* data = received.data(i);
+                uint16_t flowId = (data[0] << 8) | data[1];
+                uint16_t block = (data[2] << 8) | data[3];
+
+                Flow& flow = getFlow(received.address(i), flowId);
+                flow.lastPacket = Clock::now();
+
+                /* A newer block abandons the current one, packets of older blocks are late */
+                if(!flow.active || (int16_t)(block - flow.block) > 0) {
+                    flow.active = true;
+                    flow.block = block;
+                    flow.delivered = 0;
+                    flow.forwarded.assign(256, false);
+                    flow.fec.reset(false);
+                } else if(block != flow.block) {
+                    continue;
+                }
+
+                std::vector<uint8_t> packet(data + HEADER_SIZE, data + length);
+                unsigned int packetIndex = packet[packet.size() - 2];
+                unsigned int sourcePackets = packet[packet.size() - 1] + 1;
+
+                /* Source packets are forwarded at once, the decoder only fills the gaps */
+                if(packetIndex < sourcePackets && !flow.forwarded[packetIndex]) {
+                    flow.forwarded[packetIndex] = true;
+                    batch.addPlain(std::vector<uint8_t>(packet.begin(), packet.end() - TRAILER_SIZE));
+                }
+
+                flow.fec << std::move(packet);
+
+                std::vector<std::vector<uint8_t>> decoded;
+                flow.fec.requestPackets(decoded, 256);
+                for(auto& payload: decoded) {
+                    unsigned int decodedIndex = flow.delivered++;
+                    if(!flow.forwarded[decodedIndex]) {
+                        flow.forwarded[decodedIndex] = true;
+                        stats_.recovered++;
+                        batch.addPlain(std::move(payload));
+                    }
+                }
+            }
+
+            expireFlows();
+            batch.flush();
+        }
+
+        batch.flush();
+        close(listenFd);
+    }
+
+private:
+    struct Flow {
+        CauchyFEC fec;
+        bool active;
+        uint16_t block;
+        unsigned int delivered;
+        std::vector<bool> forwarded;
+        Clock::time_point lastPacket;
+    };
+
+    Flow& getFlow(const sockaddr_in& address, uint16_t flowId) {
+        uint64_t key = (addressKey(address) << 16) | flowId;
+
+        auto found = flows_.find(key);
+        if(found != flows_.end()) {
+            return *found->second;
+        }
+
+        std::unique_ptr<Flow> flow(new Flow());
+        flow->active = false;
+        flow->block = 0;
+        flow->delivered = 0;
+
+        return *(flows_[key] = std::move(flow));
+    }
+
+    void expireFlows() {
+        Clock::time_point now = Clock::now();
+
+        for(auto it = flows_.begin(); it != flows_.end();) {
+            if(now - it->second->lastPacket >= FLOW_IDLE_TIMEOUT) {
+                it = flows_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    const Options& options_;
+    unsigned int index_;
+    Stats& stats_;
+    std::map<uint64_t, std::unique_ptr<Flow>> flows_;
+};
+
+static void usage(const char* name) {
+    std::cerr<<"Usage: "<<name<<" encode <listen ip:port> <forward ip:port> <k> <m> [options]\n";
+    std::cerr<<"       "<<name<<" decode <listen ip:port> <forward ip:port> [options]\n";
+    std::cerr<<"Options: --threads N   worker threads, one per core by default\n";
+    std::cerr<<"         --loss P      drop outgoing datagrams with probability P, for testing\n";
+    std::cerr<<"         --flush MS    send the parity of a partial block after MS milliseconds (default 20)\n";
+}
+
+static void stop(int) {
+    running = false;
+}
+
+int main(int argc, char** argv) {
+    CauchyFEC::init();
+
+    try {
+        Options options;
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+        options.loss = 0;
+        options.flushMs = 20;
+        options.sourcePackets = 0;
+        options.parityPackets = 0;
+
+        std::string mode = (argc > 1)? argv[1] : "";
+        int positional = (mode == "encode")? 6 : 4;
+        if((mode != "encode" && mode != "decode") || argc < positional) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        options.encode = mode == "encode";
+        options.listen = parseAddress(argv[2]);
+        options.forward = parseAddress(argv[3]);
+        if(options.encode) {
+            options.sourcePackets = std::stoul(argv[4]);
+            options.parityPackets = std::stoul(argv[5]);
+            if(!options.sourcePackets || options.sourcePackets + options.parityPackets > 256) {
+                throw std::runtime_error("k + m must be at most 256");
+            }
+        }
+
+        for(int i = positional; i < argc; i++) {
+            std::string option = argv[i];
+            if(i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+
+            if(option == "--threads") {
+                options.threads = std::max(1ul, std::stoul(argv[++i]));
+            } else if(option == "--loss") {
+                options.loss = std::stod(argv[++i]);
+            } else if(option == "--flush") {
+                options.flushMs = std::stoul(argv[++i]);
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+
+        signal(SIGINT, stop);
+        signal(SIGTERM, stop);
+
+        std::vector<Stats> stats(options.threads, Stats{0, 0, 0, 0});
+        std::vector<std::thread> workers;
+        unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+
+        for(unsigned int i = 0; i < options.threads; i++) {
+            workers.emplace_back([&options, &stats, i]() {
+                try {
+                    if(options.encode) {
+                        EncoderWorker(options, i, stats[i]).run();
+                    } else {
+                        DecoderWorker(options, i, stats[i]).run();
+                    }
+                } catch(const std::exception& e) {
+                    std::cerr<<e.what()<<"\n";
+                    running = false;
+                }
+            });
+
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET(i % cpus, &cpuSet);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpuSet), &cpuSet);
+        }
+
+        for(auto& worker: workers) {
+            worker.join();
+        }
+
+        Stats total = {0, 0, 0, 0};
+        for(auto& s: stats) {
+            total.received += s.received;
+            total.sent += s.sent;
+            total.dropped += s.dropped;
+            total.recovered += s.recovered;
+        }
+
+        std::cerr<<"received "<<total.received<<" sent "<<total.sent<<" dropped "<<total.dropped;
+        if(!options.encode) {
+            std::cerr<<" recovered "<<total.recovered;
+        }
+        std::cerr<<"\n";
+    } catch(const std::exception& e) {
+        std::cerr<<e.what()<<"\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,559 @@
+/*
+ * Copyright (c) 2018, Bertold Van den Bergh (vandenbergh@bertold.org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR DISTRIBUTOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Loss channel simulator. An encoder and a decoder are driven through a simulated channel
+ * with the regular reset()/operator<</operator>> flow: the sender emits one packet every
+ * --interval, source packets are forwarded as soon as they are loaded and the parity follows
+ * the last source packet of the block. The channel drops packets with a Bernoulli or
+ * Gilbert-Elliott model, adds a fixed delay, and can reorder and duplicate packets.
+ *
+ * Time is simulated, so the latencies do not depend on the speed of this machine. The CPU
+ * time of the codec is measured separately, per delivered byte. The latency of a source
+ * packet runs from the moment it was sent to the moment the decoder returned it, so the
+ * wait for parity after a loss and the in-order delivery both show up in the tail.
+ * A block that is not complete --deadline after its last packet was sent is given up, its
+ * missing packets count as residual loss.
+ */
+
+#include "CauchyFEC.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+static const uint64_t NS_PER_US = 1000;
+
+void makeRandomVector(std::vector<uint8_t>& output, unsigned int length) {
+    output.resize(length);
+    for(unsigned int i=0; i<length; i++) {
+        output[i]=rand();
+    }
+}
+
+static uint64_t cpuTimeNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * Log-linear histogram in the style of HdrHistogram: values below 2^SUB_BUCKET_BITS are
+ * exact, larger values are kept with SUB_BUCKET_BITS - 1 bits of precision (< 1% error).
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram():
+        counts_((64 - SUB_BUCKET_BITS + 2) * HALF_BUCKET, 0),
+        total_(0),
+        max_(0) {
+    }
+
+    void record(uint64_t value) {
+        counts_[bucketIndex(value)]++;
+        total_++;
+        max_ = std::max(max_, value);
+    }
+
+    uint64_t count() const {
+        return total_;
+    }
+
+    uint64_t max() const {
+        return max_;
+    }
+
+    /* Highest value equivalent to the bucket that holds the given quantile */
+    uint64_t percentile(double quantile) const {
+        uint64_t target = std::max<uint64_t>(1, std::ceil(quantile * total_));
+        uint64_t seen = 0;
+
+        for(unsigned int i = 0; i < counts_.size(); i++) {
+            seen += counts_[i];
+            if(seen >= target) {
+                return std::min(max_, bucketHighest(i));
+            }
+        }
+        return max_;
+    }
+
+    /* Non-empty buckets as (lowest value, highest value, count) */
+    template<typename F> void forEachBucket(F f) const {
+        for(unsigned int i = 0; i < counts_.size(); i++) {
+            if(counts_[i]) {
+                f(bucketLowest(i), bucketHighest(i), counts_[i]);
+            }
+        }
+    }
+
+private:
+    static const unsigned int SUB_BUCKET_BITS = 8;
+    static const unsigned int SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static const unsigned int HALF_BUCKET = SUB_BUCKETS / 2;
+
+    static unsigned int bucketIndex(uint64_t value) {
+        if(value < SUB_BUCKETS) {
+            return value;
+        }
+        unsigned int shift = 63 - __builtin_clzll(value) - (SUB_BUCKET_BITS - 1);
+        return shift * HALF_BUCKET + (value >> shift);
+    }
+
+    static uint64_t bucketLowest(unsigned int index) {
+        if(index < SUB_BUCKETS) {
+            return index;
+        }
+        unsigned int shift = index / HALF_BUCKET - 1;
+        return (uint64_t)(index - shift * HALF_BUCKET) << shift;
+    }
+
+    static uint64_t bucketHighest(unsigned int index) {
+        if(index < SUB_BUCKETS) {
+            return index;
+        }
+        unsigned int shift = index / HALF_BUCKET - 1;
+        return bucketLowest(index) + ((uint64_t)1 << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t max_;
+};
+
+/* Bernoulli loss is the Gilbert-Elliott model with a single state */
+struct LossModel {
+    double goodToBad = 0;
+    double badToGood = 1;
+    double lossGood = 0;
+    double lossBad = 1;
+    double reorder = 0;
+    uint64_t reorderNs = 0;
+    double duplicate = 0;
+    uint64_t delayNs = 5000 * NS_PER_US;
+    std::string name = "none";
+};
+
+struct Options {
+    unsigned int sourcePackets = 16;
+    unsigned int parityPackets = 4;
+    unsigned int packetSize = 1200;
+    unsigned int blocks = 10000;
+    uint64_t intervalNs = 100 * NS_PER_US;
+    uint64_t deadlineNs = 200000 * NS_PER_US;
+    unsigned int seed = 1;
+    bool json = false;
+    bool histogram = false;
+    LossModel model;
+};
+
+struct Arrival {
+    uint64_t time;
+    uint64_t sequence;
+    unsigned int block;
+    std::vector<uint8_t> packet;
+
+    bool operator>(const Arrival& other) const {
+        return time != other.time? time > other.time : sequence > other.sequence;
+    }
+};
+
+class Channel {
+public:
+    Channel(const LossModel& model, unsigned int seed):
+        model_(model),
+        random_(seed),
+        bad_(false),
+        sequence_(0) {
+    }
+
+    void send(uint64_t now, unsigned int block, const std::vector<uint8_t>& packet) {
+        bad_ = bad_? !chance(model_.badToGood) : chance(model_.goodToBad);
+        if(chance(bad_? model_.lossBad : model_.lossGood)) {
+            return;
+        }
+
+        push(now, block, packet);
+        if(chance(model_.duplicate)) {
+            push(now, block, packet);
+        }
+    }
+
+    bool pending() const {
+        return !queue_.empty();
+    }
+
+    uint64_t nextTime() const {
+        return queue_.top().time;
+    }
+
+    Arrival pop() {
+        Arrival arrival = std::move(const_cast<Arrival&>(queue_.top()));
+        queue_.pop();
+        return arrival;
+    }
+
+private:
+    bool chance(double probability) {
+        return probability > 0 && std::uniform_real_distribution<double>(0, 1)(random_) < probability;
+    }
+
+    void push(uint64_t now, unsigned int block, const std::vector<uint8_t>& packet) {
+        uint64_t time = now + model_.delayNs;
+        if(chance(model_.reorder)) {
+            time += std::uniform_int_distribution<uint64_t>(0, model_.reorderNs)(random_);
+        }
+        queue_.push(Arrival{time, sequence_++, block, packet});
+    }
+
+    LossModel model_;
+    std::mt19937_64 random_;
+    bool bad_;
+    uint64_t sequence_;
+    std::priority_queue<Arrival, std::vector<Arrival>, std::greater<Arrival>> queue_;
+};
+
+class Simulation {
+public:
+    Simulation(const Options& options):
+        options_(options),
+        channel_(options.model, options.seed),
+        sendTimes_((size_t)options.blocks * options.sourcePackets),
+        delivered_(0),
+        deliveredBytes_(0),
+        residualLoss_(0),
+        corrupt_(0),
+        encoderCpuNs_(0),
+        decoderCpuNs_(0) {
+        /* Source packets are taken from a pool, so long runs do not need much memory */
+        pool_.resize(std::max(64u, options.sourcePackets * 4));
+        for(auto& packet: pool_) {
+            makeRandomVector(packet, options.packetSize);
+        }
+    }
+
+    void run() {
+        CauchyFEC encoder;
+        uint64_t now = 0;
+
+        for(unsigned int block = 0; block < options_.blocks; block++) {
+            uint64_t start = cpuTimeNs();
+            encoder.reset(true, options_.sourcePackets);
+            encoderCpuNs_ += cpuTimeNs() - start;
+
+            /* The block exists before its first packet can arrive, its deadline follows the last one */
+            blocks_[block];
+
+            for(unsigned int i = 0; i < options_.sourcePackets + options_.parityPackets; i++) {
+                receive(now);
+
+                std::vector<uint8_t> packet;
+                start = cpuTimeNs();
+                if(i < options_.sourcePackets) {
+                    encoder << source(block, i);
+                    sendTimes_[(size_t)block * options_.sourcePackets + i] = now;
+                }
+                encoder >> packet;
+                encoderCpuNs_ += cpuTimeNs() - start;
+
+                channel_.send(now, block, packet);
+                now += options_.intervalNs;
+            }
+
+            auto it = blocks_.find(block);
+            if(it != blocks_.end()) {
+                it->second.deadline = now + options_.deadlineNs;
+            }
+        }
+
+        receive(UINT64_MAX);
+        while(!blocks_.empty()) {
+            giveUp(blocks_.begin());
+        }
+    }
+
+    void report(std::ostream& out) const {
+        uint64_t sent = (uint64_t)options_.blocks * options_.sourcePackets;
+        double residual = (double)residualLoss_ / sent;
+        auto us = [](uint64_t ns) { return ns / (double)NS_PER_US; };
+        double encoderNsPerByte = deliveredBytes_? (double)encoderCpuNs_ / deliveredBytes_ : 0;
+        double decoderNsPerByte = deliveredBytes_? (double)decoderCpuNs_ / deliveredBytes_ : 0;
+
+        if(options_.json) {
+            out<<"{\"k\":"<<options_.sourcePackets<<",\"m\":"<<options_.parityPackets<<",\"size\":"<<options_.packetSize
+               <<",\"model\":\""<<options_.model.name<<"\",\"source_packets\":"<<sent<<",\"delivered\":"<<delivered_
+               <<",\"residual_loss\":"<<residual<<",\"corrupt\":"<<corrupt_
+               <<",\"latency_us\":{\"p50\":"<<us(latency_.percentile(0.5))<<",\"p90\":"<<us(latency_.percentile(0.9))
+               <<",\"p99\":"<<us(latency_.percentile(0.99))<<",\"p999\":"<<us(latency_.percentile(0.999))
+               <<",\"max\":"<<us(latency_.max())<<"}"
+               <<",\"encoder_cpu_ns_per_byte\":"<<encoderNsPerByte<<",\"decoder_cpu_ns_per_byte\":"<<decoderNsPerByte;
+            if(options_.histogram) {
+                out<<",\"histogram_us\":[";
+                bool first = true;
+                latency_.forEachBucket([&](uint64_t lowest, uint64_t highest, uint64_t count) {
+                    out<<(first? "" : ",")<<"["<<us(lowest)<<","<<us(highest)<<","<<count<<"]";
+                    first = false;
+                });
+                out<<"]";
+            }
+            out<<"}\n";
+            return;
+        }
+
+        out<<"k="<<options_.sourcePackets<<" m="<<options_.parityPackets<<" size="<<options_.packetSize
+           <<" model="<<options_.model.name<<"\n";
+        out<<"source packets: "<<sent<<" delivered: "<<delivered_<<" residual loss: "<<residual
+           <<" corrupt: "<<corrupt_<<"\n";
+        out<<"latency us: p50 "<<us(latency_.percentile(0.5))<<" p90 "<<us(latency_.percentile(0.9))
+           <<" p99 "<<us(latency_.percentile(0.99))<<" p99.9 "<<us(latency_.percentile(0.999))
+           <<" max "<<us(latency_.max())<<"\n";
+        out<<"cpu ns per delivered byte: encoder "<<encoderNsPerByte<<" decoder "<<decoderNsPerByte<<"\n";
+        if(options_.histogram) {
+            out<<"lowest_us,highest_us,count\n";
+            latency_.forEachBucket([&](uint64_t lowest, uint64_t highest, uint64_t count) {
+                out<<us(lowest)<<","<<us(highest)<<","<<count<<"\n";
+            });
+        }
+    }
+
+    bool failed() const {
+        return corrupt_ > 0;
+    }
+
+private:
+    struct Block {
+        CauchyFEC decoder;
+        unsigned int delivered = 0;
+        uint64_t deadline = UINT64_MAX;
+        bool started = false;
+    };
+
+    const std::vector<uint8_t>& source(unsigned int block, unsigned int index) const {
+        return pool_[((size_t)block * options_.sourcePackets + index) % pool_.size()];
+    }
+
+    /* Deliver everything that arrives up to 'now', give up the blocks past their deadline */
+    void receive(uint64_t now) {
+        while(channel_.pending() && channel_.nextTime() <= now) {
+            Arrival arrival = channel_.pop();
+            expire(arrival.time);
+            deliver(arrival);
+        }
+        expire(now);
+    }
+
+    void expire(uint64_t now) {
+        while(!blocks_.empty() && blocks_.begin()->second.deadline < now) {
+            giveUp(blocks_.begin());
+        }
+    }
+
+    void giveUp(std::map<unsigned int, Block>::iterator it) {
+        residualLoss_ += options_.sourcePackets - it->second.delivered;
+        blocks_.erase(it);
+    }
+
+    void deliver(Arrival& arrival) {
+        /* Late packets of a block that was completed or given up */
+        auto it = blocks_.find(arrival.block);
+        if(it == blocks_.end()) {
+            return;
+        }
+
+        Block& block = it->second;
+        uint64_t start = cpuTimeNs();
+        if(!block.started) {
+            block.decoder.reset(false);
+            block.started = true;
+        }
+
+        block.decoder << std::move(arrival.packet);
+
+        std::vector<uint8_t> packet;
+        while(block.delivered < options_.sourcePackets && block.decoder >> packet) {
+            decoderCpuNs_ += cpuTimeNs() - start;
+
+            size_t index = (size_t)arrival.block * options_.sourcePackets + block.delivered;
+            latency_.record(arrival.time - sendTimes_[index]);
+            if(packet != source(arrival.block, block.delivered)) {
+                corrupt_++;
+            }
+
+            block.delivered++;
+            delivered_++;
+            deliveredBytes_ += packet.size();
+            packet.clear();
+            start = cpuTimeNs();
+        }
+        decoderCpuNs_ += cpuTimeNs() - start;
+
+        if(block.delivered == options_.sourcePackets) {
+            blocks_.erase(it);
+        }
+    }
+
+    Options options_;
+    Channel channel_;
+    std::vector<std::vector<uint8_t>> pool_;
+    std::vector<uint64_t> sendTimes_;
+    std::map<unsigned int, Block> blocks_;
+    LatencyHistogram latency_;
+    uint64_t delivered_;
+    uint64_t deliveredBytes_;
+    uint64_t residualLoss_;
+    uint64_t corrupt_;
+    uint64_t encoderCpuNs_;
+    uint64_t decoderCpuNs_;
+};
+
+static std::vector<double> parseParameters(const std::string& text, std::string& name) {
+    std::vector<double> values;
+    size_t colon = text.find(':');
+    name = text.substr(0, colon);
+
+    while(colon != std::string::npos) {
+        size_t next = text.find(':', colon + 1);
+        values.push_back(std::stod(text.substr(colon + 1, next - colon - 1)));
+        colon = next;
+    }
+    return values;
+}
+
+static void parseLossModel(const std::string& text, LossModel& model) {
+    std::string name;
+    std::vector<double> values = parseParameters(text, name);
+
+    if(name == "bernoulli" && values.size() == 1) {
+        model.goodToBad = 0;
+        model.lossGood = values[0];
+    } else if(name == "ge" && values.size() >= 2 && values.size() <= 4) {
+        model.goodToBad = values[0];
+        model.badToGood = values[1];
+        model.lossGood = values.size() > 2? values[2] : 0;
+        model.lossBad = values.size() > 3? values[3] : 1;
+    } else if(name != "none" || values.size()) {
+        throw std::runtime_error("Invalid loss model " + text);
+    }
+    model.name = text;
+}
+
+static void usage(const char* name) {
+    std::cerr<<"Usage: "<<name<<" [options]\n";
+    std::cerr<<"  --k N             source packets per block (default 16)\n";
+    std::cerr<<"  --m N             parity packets per block (default 4)\n";
+    std::cerr<<"  --size N          packet size in bytes (default 1200)\n";
+    std::cerr<<"  --blocks N        blocks to send (default 10000)\n";
+    std::cerr<<"  --interval US     time between packets (default 100)\n";
+    std::cerr<<"  --delay US        one way channel delay (default 5000)\n";
+    std::cerr<<"  --deadline MS     give up a block this long after its last packet (default 200)\n";
+    std::cerr<<"  --loss MODEL      none, bernoulli:P or ge:P_GOOD_BAD:P_BAD_GOOD[:LOSS_GOOD[:LOSS_BAD]]\n";
+    std::cerr<<"  --reorder P:US    delay a packet by up to US with probability P\n";
+    std::cerr<<"  --duplicate P     duplicate a packet with probability P\n";
+    std::cerr<<"  --seed N          random seed of the channel (default 1)\n";
+    std::cerr<<"  --histogram       print the latency histogram\n";
+    std::cerr<<"  --json            print one JSON line\n";
+}
+
+int main(int argc, char** argv) {
+    CauchyFEC::init();
+    srand(1);
+
+    Options options;
+
+    try {
+        for(int i = 1; i < argc; i++) {
+            std::string option = argv[i];
+            if(option == "--json") {
+                options.json = true;
+                continue;
+            }
+            if(option == "--histogram") {
+                options.histogram = true;
+                continue;
+            }
+
+            if(i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+
+            if(option == "--k") {
+                options.sourcePackets = std::stoul(value);
+            } else if(option == "--m") {
+                options.parityPackets = std::stoul(value);
+            } else if(option == "--size") {
+                options.packetSize = std::stoul(value);
+            } else if(option == "--blocks") {
+                options.blocks = std::stoul(value);
+            } else if(option == "--interval") {
+                options.intervalNs = std::stod(value) * NS_PER_US;
+            } else if(option == "--delay") {
+                options.model.delayNs = std::stod(value) * NS_PER_US;
+            } else if(option == "--deadline") {
+                options.deadlineNs = std::stod(value) * 1000 * NS_PER_US;
+            } else if(option == "--loss") {
+                parseLossModel(value, options.model);
+            } else if(option == "--reorder") {
+                std::string name;
+                std::vector<double> values = parseParameters(":" + value, name);
+                if(values.size() != 2) {
+                    throw std::runtime_error("Invalid reordering " + value);
+                }
+                options.model.reorder = values[0];
+                options.model.reorderNs = values[1] * NS_PER_US;
+            } else if(option == "--duplicate") {
+                options.model.duplicate = std::stod(value);
+            } else if(option == "--seed") {
+                options.seed = std::stoul(value);
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+
+        if(!options.sourcePackets || options.sourcePackets + options.parityPackets > 256 || !options.packetSize) {
+            throw std::runtime_error("Need 1 <= k, k + m <= 256 and a packet size above 0");
+        }
+
+        Simulation simulation(options);
+        simulation.run();
+        simulation.report(std::cout);
+
+        return simulation.failed()? 1 : 0;
+    } catch(const std::exception& e) {
+        std::cerr<<e.what()<<"\n";
+        return 1;
+    }
+}